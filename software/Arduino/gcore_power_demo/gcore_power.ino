@@ -153,6 +153,14 @@ struct gcore_vars_type
 };
 
 
+//
+// Optional per-evaluation sample callback (e.g. gcore_telemetry.ino)
+//   Called from the monitoring task with the evaluation's battery voltage, charge state,
+//   button down state and short/long press detection
+//
+typedef void (*gcore_sample_hook_t)(float batt_v, int charge_state, bool button_down, bool short_press, bool long_press);
+
+
 
 // ================================================================================
 // Variables
@@ -173,6 +181,8 @@ int gcore_batt_avg_index;
 
 gcore_btn_t gcore_btn_state;
 
+gcore_sample_hook_t gcore_sample_hook = NULL;
+
 
 //
 // Variables shared between the task and API
@@ -200,6 +210,13 @@ void gcore_set_stat_pin(int pin_num)
 }
 
 
+// Set to NULL to disable (hook is a gcore_sample_hook_t, spelled out so the Arduino generated prototype compiles)
+void gcore_set_sample_hook(void (*hook)(float batt_v, int charge_state, bool button_down, bool short_press, bool long_press))
+{
+  gcore_sample_hook = hook;
+}
+
+
 // Call immediately from begin() to set PWR_HOLD
 bool gcore_begin()
 {
@@ -579,6 +596,17 @@ void _gcore_mon_task(void* parameter)
     }
     xSemaphoreGive(gcore_mutex);
 
+    //
+    // Report this evaluation
+    //
+    if (gcore_sample_hook != NULL) {
+      gcore_sample_hook(cur_batt_v,
+                        gcore_enable_stat ? (int) cur_charge_state : (int) CHARGE_IDLE,
+                        gcore_enable_btn ? cur_button_down : false,
+                        gcore_enable_btn ? button_short_press_detected : false,
+                        gcore_enable_btn ? button_long_press_detected : false);
+    }
+
     // Sleep
     vTaskDelay(GCORE_EVAL_MSEC / portTICK_RATE_MS);
   }
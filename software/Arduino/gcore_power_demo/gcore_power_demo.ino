@@ -4,6 +4,9 @@
  * Reports battery voltage, switch and charge state every second via the USB serial port.  After 60 seconds enables
  * long-press to disable power.  Powers down at 120 seconds.
  * 
+ * Also records power telemetry to SPIFFS using gcore_telemetry.ino.  Type 'd' in the serial monitor to dump
+ * the telemetry log (decode with tools/gcore_tlm_decode.py) or 'e' to erase it.
+ * 
  * Compile for ESP WROVER Module
  *    Flash Mode: "DIO"
  *    Flash Frequency: "40 MHz"
@@ -20,6 +23,9 @@ void setup() {
   Serial.printf("gcore_power_demo\n");
   gcore_begin();
   gcore_set_button_shutdown_enable(false);
+  if (!gcore_tlm_begin()) {
+    Serial.printf("Telemetry SPIFFS mount failed - logging to RAM only\n");
+  }
 
   Serial.printf("Battery cut-off = %1.2fv\n", gcore_get_low_voltage_threshold());
   Serial.printf("Battery cut-off duration = %d sec\n", gcore_get_low_voltage_duration());
@@ -59,11 +65,24 @@ void loop() {
         Serial.printf("UNKNOWN\n");
     }
     
+    while (Serial.available()) {
+      switch (Serial.read()) {
+        case 'd':
+          gcore_tlm_export(Serial);
+          break;
+        case 'e':
+          gcore_tlm_erase();
+          Serial.printf("Telemetry erased\n");
+          break;
+      }
+    }
+    
     delay(1000);
     ++sec_count;
     if (sec_count == 60) {
       gcore_set_button_shutdown_enable(true);
     } else if (sec_count == 120) {
+      gcore_tlm_flush();
       gcore_power_down();
     }
   }
@@ -0,0 +1,553 @@
+/*
+ * gCore Power Telemetry Functions
+ *
+ * Provides a history of the power system to help diagnose battery issues in the field.
+ *
+ *  1. Fixed-size binary record ring in RAM
+ *      - Battery voltage, charge state, button activity and CPU load
+ *      - Sampled by the gcore_power monitoring task
+ *  2. Persistence to SPIFFS
+ *      - Full pages of records are written to a rotating set of slot files so flash
+ *        writes are spread evenly and the total log size is bounded
+ *      - Writes are done by a low priority task so the monitoring task never waits on flash
+ *  3. Streaming export over a serial port
+ *      - Text framed hex records decoded by software/Arduino/tools/gcore_tlm_decode.py
+ *
+ * Requires gcore_power.ino.  Call gcore_tlm_begin() after gcore_begin().
+ *
+ * Copyright (c) 2020 Dan Julio (dan@danjuliodesigns.com)
+ *
+ * gCore power management library is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * gCore power management library is distributed in the hope that it will
+ * be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.
+ *
+ * See <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "FS.h"
+#include "SPIFFS.h"
+#include "esp_freertos_hooks.h"
+#include "xtensa/hal.h"
+
+
+// ================================================================================
+// Constants
+// ================================================================================
+
+//
+// Default sample interval (sec)
+//
+#define GCORE_TLM_SAMPLE_SEC    10
+
+//
+// Record storage
+//   - A page is the unit written to flash
+//   - The RAM ring holds two pages so a full page can be written while the next fills
+//   - GCORE_TLM_NUM_SLOTS pages are kept in flash (64 x 64 x 10 sec ~ 11 hours)
+//
+#define GCORE_TLM_PAGE_RECS     64
+#define GCORE_TLM_RING_RECS     (2 * GCORE_TLM_PAGE_RECS)
+#define GCORE_TLM_NUM_SLOTS     64
+
+//
+// Slot file header identification
+//
+#define GCORE_TLM_MAGIC         0x4D4C5467  // "gTLM"
+#define GCORE_TLM_VERSION       1
+
+//
+// Record flags
+//
+#define GCORE_TLM_FLAG_CHG_MASK 0x03  // gcore_charge_t
+#define GCORE_TLM_FLAG_BTN_DOWN 0x04  // Button down at any point in the interval
+#define GCORE_TLM_FLAG_SHORT    0x08  // Short press detected in the interval
+#define GCORE_TLM_FLAG_LONG     0x10  // Long press detected in the interval
+#define GCORE_TLM_FLAG_BOOT     0x80  // First record after gcore_tlm_begin()
+
+//
+// Flash writer task
+//
+#define GCORE_TLM_TASK_STACK    4096
+#define GCORE_TLM_TASK_PRIO     (tskIDLE_PRIORITY + 1)
+
+
+
+// ================================================================================
+// Data structures
+// ================================================================================
+
+//
+// A single telemetry record (8 bytes, little endian)
+//
+struct __attribute__((packed)) gcore_tlm_rec_type
+{
+  uint32_t t_sec;                    // Seconds since boot
+  uint16_t batt_mv;                  // Battery voltage (mV)
+  uint8_t flags;                     // GCORE_TLM_FLAG_xxx
+  uint8_t cpu_load;                  // Average CPU load over the interval (%)
+};
+
+
+//
+// Slot file header
+//
+struct __attribute__((packed)) gcore_tlm_hdr_type
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;                    // Number of records following the header
+  uint32_t seq;                      // Monotonic page sequence number
+};
+
+
+
+// ================================================================================
+// Variables
+// ================================================================================
+
+//
+// Task-related variables (only accessed in the monitoring task)
+//
+int gcore_tlm_sample_ticks;          // Monitoring task evaluations per sample
+int gcore_tlm_tick_count;
+uint32_t gcore_tlm_batt_sum;         // mV accumulated over the sample interval
+uint8_t gcore_tlm_acc_flags;
+bool gcore_tlm_first_rec;
+
+//
+// CPU load measurement - on each core the idle hook notes the cycle count (CCOUNT) when the
+// idle task runs and the tick hook adds the cycles the idle task has been running since then
+// (or since the previous tick), in 1/256 of tick units.  Each core's counters are only written
+// by that core's hooks.
+//
+uint32_t gcore_tlm_idle_start[2];    // CCOUNT when the idle task last ran its loop
+uint32_t gcore_tlm_last_tick[2];     // CCOUNT at the previous tick
+volatile uint32_t gcore_tlm_idle_units[2];
+volatile uint32_t gcore_tlm_total_units[2];
+uint32_t gcore_tlm_prev_idle[2];
+uint32_t gcore_tlm_prev_total[2];
+
+// Hooks run from the tick interrupt so they are in IRAM (declared here, the Arduino generated
+// prototypes don't handle IRAM_ATTR)
+bool IRAM_ATTR _gcore_tlm_idle_hook();
+void IRAM_ATTR _gcore_tlm_tick_hook();
+
+//
+// Variables shared between the task and API
+//
+SemaphoreHandle_t gcore_tlm_mutex = NULL;
+struct gcore_tlm_rec_type gcore_tlm_ring[GCORE_TLM_RING_RECS];
+int gcore_tlm_push_index;            // Next record to write
+int gcore_tlm_flush_index;           // First record not yet written to flash
+
+//
+// SPIFFS access (flash writer task and API), in this order when both mutexes are needed
+//
+SemaphoreHandle_t gcore_tlm_fs_mutex = NULL;
+TaskHandle_t gcore_tlm_task_handle = NULL;
+struct gcore_tlm_rec_type gcore_tlm_page_buf[GCORE_TLM_RING_RECS];  // Records copied out of the ring
+uint32_t gcore_tlm_seq;              // Next page sequence number
+bool gcore_tlm_fs_ok = false;
+
+
+
+// ================================================================================
+// API routines
+// ================================================================================
+
+// Call after gcore_begin().  Further calls just return the SPIFFS state.
+bool gcore_tlm_begin()
+{
+  int i;
+  struct gcore_tlm_hdr_type hdr;
+
+  if (gcore_tlm_mutex != NULL) {
+    return gcore_tlm_fs_ok;
+  }
+
+  gcore_tlm_sample_ticks = GCORE_EVAL_PER_SEC * GCORE_TLM_SAMPLE_SEC;
+  gcore_tlm_tick_count = 0;
+  gcore_tlm_batt_sum = 0;
+  gcore_tlm_acc_flags = 0;
+  gcore_tlm_first_rec = true;
+  gcore_tlm_push_index = 0;
+  gcore_tlm_flush_index = 0;
+  gcore_tlm_seq = 0;
+
+  // Find the next page sequence number from any existing slots
+  gcore_tlm_fs_ok = SPIFFS.begin(true);
+  if (gcore_tlm_fs_ok) {
+    for (i=0; i<GCORE_TLM_NUM_SLOTS; i++) {
+      if (_gcore_tlm_read_hdr(i, &hdr)) {
+        if (hdr.seq >= gcore_tlm_seq) {
+          gcore_tlm_seq = hdr.seq + 1;
+        }
+      }
+    }
+  }
+
+  // Start CPU load measurement
+  for (i=0; i<portNUM_PROCESSORS; i++) {
+    gcore_tlm_idle_start[i] = 0;
+    gcore_tlm_last_tick[i] = 0;
+    gcore_tlm_idle_units[i] = 0;
+    gcore_tlm_total_units[i] = 0;
+    gcore_tlm_prev_idle[i] = 0;
+    gcore_tlm_prev_total[i] = 0;
+  }
+  esp_register_freertos_idle_hook_for_cpu(_gcore_tlm_idle_hook, 0);
+  esp_register_freertos_tick_hook_for_cpu(_gcore_tlm_tick_hook, 0);
+#if portNUM_PROCESSORS > 1
+  esp_register_freertos_idle_hook_for_cpu(_gcore_tlm_idle_hook, 1);
+  esp_register_freertos_tick_hook_for_cpu(_gcore_tlm_tick_hook, 1);
+#endif
+
+  // Attach to the monitoring task
+  gcore_tlm_fs_mutex = xSemaphoreCreateBinary();
+  xSemaphoreGive(gcore_tlm_fs_mutex);
+  gcore_tlm_mutex = xSemaphoreCreateBinary();
+  xSemaphoreGive(gcore_tlm_mutex);
+  xTaskCreate(_gcore_tlm_task, "gCore Telemetry", GCORE_TLM_TASK_STACK, NULL, GCORE_TLM_TASK_PRIO, &gcore_tlm_task_handle);
+  gcore_set_sample_hook(_gcore_tlm_sample);
+
+  return gcore_tlm_fs_ok;
+}
+
+
+void gcore_tlm_set_sample_interval(int sec)
+{
+  if (sec < 1) sec = 1;
+
+  xSemaphoreTake(gcore_tlm_mutex, portMAX_DELAY);
+  gcore_tlm_sample_ticks = GCORE_EVAL_PER_SEC * sec;
+  xSemaphoreGive(gcore_tlm_mutex);
+}
+
+
+int gcore_tlm_get_sample_interval()
+{
+  int i;
+
+  xSemaphoreTake(gcore_tlm_mutex, portMAX_DELAY);
+  i = gcore_tlm_sample_ticks / GCORE_EVAL_PER_SEC;
+  xSemaphoreGive(gcore_tlm_mutex);
+
+  return i;
+}
+
+
+// Write any records not yet in flash (e.g. before an application initiated power down)
+void gcore_tlm_flush()
+{
+  xSemaphoreTake(gcore_tlm_fs_mutex, portMAX_DELAY);
+  while (_gcore_tlm_write_page(false)) {}
+  xSemaphoreGive(gcore_tlm_fs_mutex);
+}
+
+
+// Delete all stored history
+void gcore_tlm_erase()
+{
+  int i;
+  char name[16];
+
+  xSemaphoreTake(gcore_tlm_fs_mutex, portMAX_DELAY);
+  if (gcore_tlm_fs_ok) {
+    for (i=0; i<GCORE_TLM_NUM_SLOTS; i++) {
+      _gcore_tlm_slot_name(i, name);
+      if (SPIFFS.exists(name)) {
+        SPIFFS.remove(name);
+      }
+    }
+  }
+  gcore_tlm_seq = 0;
+  xSemaphoreTake(gcore_tlm_mutex, portMAX_DELAY);
+  gcore_tlm_flush_index = gcore_tlm_push_index;
+  xSemaphoreGive(gcore_tlm_mutex);
+  xSemaphoreGive(gcore_tlm_fs_mutex);
+}
+
+
+// Stream all stored records, oldest first, followed by records still in RAM.  Format:
+//   TLM,<version>,<sample interval sec>
+//   <16 hex characters per record>
+//   ...
+//   END,<record count>
+void gcore_tlm_export(Stream &s)
+{
+  int i, n;
+  int slot;
+  int count = 0;
+  uint32_t first_seq;
+  uint32_t last_seq;
+  struct gcore_tlm_hdr_type hdr;
+  struct gcore_tlm_rec_type rec;
+  File f;
+  char name[16];
+
+  // The monitoring task only waits for the ring to be copied, not for flash reads or the stream
+  xSemaphoreTake(gcore_tlm_fs_mutex, portMAX_DELAY);
+
+  s.printf("TLM,%d,%d\n", GCORE_TLM_VERSION, gcore_tlm_get_sample_interval());
+
+  if (gcore_tlm_fs_ok && (gcore_tlm_seq != 0)) {
+    // Slots are written in sequence order so the oldest possible page is one full rotation back
+    last_seq = gcore_tlm_seq - 1;
+    first_seq = (gcore_tlm_seq > GCORE_TLM_NUM_SLOTS) ? (gcore_tlm_seq - GCORE_TLM_NUM_SLOTS) : 0;
+    for (i=first_seq; i<=last_seq; i++) {
+      slot = i % GCORE_TLM_NUM_SLOTS;
+      if (!_gcore_tlm_read_hdr(slot, &hdr) || (hdr.seq != i)) continue;
+      _gcore_tlm_slot_name(slot, name);
+      f = SPIFFS.open(name, FILE_READ);
+      if (!f) continue;
+      f.seek(sizeof(hdr));
+      for (n=0; n<hdr.count; n++) {
+        if (f.read((uint8_t*) &rec, sizeof(rec)) != sizeof(rec)) break;
+        _gcore_tlm_print_rec(s, &rec);
+        count++;
+      }
+      f.close();
+    }
+  }
+
+  n = _gcore_tlm_copy_pending(GCORE_TLM_RING_RECS, &slot);
+  for (i=0; i<n; i++) {
+    _gcore_tlm_print_rec(s, &gcore_tlm_page_buf[i]);
+    count++;
+  }
+
+  s.printf("END,%d\n", count);
+
+  xSemaphoreGive(gcore_tlm_fs_mutex);
+}
+
+
+
+// ================================================================================
+// Internal routines
+// ================================================================================
+
+// Called by the monitoring task each evaluation
+void _gcore_tlm_sample(float batt_v, int charge_state, bool button_down, bool short_press, bool long_press)
+{
+  struct gcore_tlm_rec_type* rec;
+
+  gcore_tlm_batt_sum += (uint32_t) round(batt_v * 1000.0);
+  if (button_down) gcore_tlm_acc_flags |= GCORE_TLM_FLAG_BTN_DOWN;
+  if (short_press) gcore_tlm_acc_flags |= GCORE_TLM_FLAG_SHORT;
+  if (long_press) gcore_tlm_acc_flags |= GCORE_TLM_FLAG_LONG;
+
+  xSemaphoreTake(gcore_tlm_mutex, portMAX_DELAY);
+  if (++gcore_tlm_tick_count >= gcore_tlm_sample_ticks) {
+    rec = &gcore_tlm_ring[gcore_tlm_push_index];
+    rec->t_sec = millis() / 1000;
+    rec->batt_mv = (uint16_t) (gcore_tlm_batt_sum / gcore_tlm_tick_count);
+    rec->flags = gcore_tlm_acc_flags | (charge_state & GCORE_TLM_FLAG_CHG_MASK);
+    if (gcore_tlm_first_rec) {
+      rec->flags |= GCORE_TLM_FLAG_BOOT;
+      gcore_tlm_first_rec = false;
+    }
+    rec->cpu_load = _gcore_tlm_cpu_load();
+
+    if (++gcore_tlm_push_index >= GCORE_TLM_RING_RECS) gcore_tlm_push_index = 0;
+    if (gcore_tlm_push_index == gcore_tlm_flush_index) {
+      // Flash writes failing or disabled - drop the oldest record
+      if (++gcore_tlm_flush_index >= GCORE_TLM_RING_RECS) gcore_tlm_flush_index = 0;
+    }
+    if ((_gcore_tlm_pending() >= GCORE_TLM_PAGE_RECS) && (gcore_tlm_task_handle != NULL)) {
+      xTaskNotifyGive(gcore_tlm_task_handle);
+    }
+
+    gcore_tlm_tick_count = 0;
+    gcore_tlm_batt_sum = 0;
+    gcore_tlm_acc_flags = 0;
+  }
+  xSemaphoreGive(gcore_tlm_mutex);
+}
+
+
+// Flash writer task - writes the full pages signalled by _gcore_tlm_sample()
+void _gcore_tlm_task(void* args)
+{
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    xSemaphoreTake(gcore_tlm_fs_mutex, portMAX_DELAY);
+    while (_gcore_tlm_write_page(true)) {}
+    xSemaphoreGive(gcore_tlm_fs_mutex);
+  }
+}
+
+
+// Number of records in the ring not yet written to flash (call with gcore_tlm_mutex held)
+int _gcore_tlm_pending()
+{
+  int n = gcore_tlm_push_index - gcore_tlm_flush_index;
+
+  return (n < 0) ? (n + GCORE_TLM_RING_RECS) : n;
+}
+
+
+// Copy up to max pending records into gcore_tlm_page_buf (call with gcore_tlm_fs_mutex held).
+// Returns the number of records and the ring index of the first one.
+int _gcore_tlm_copy_pending(int max, int* start)
+{
+  int i, n;
+
+  xSemaphoreTake(gcore_tlm_mutex, portMAX_DELAY);
+  n = _gcore_tlm_pending();
+  if (n > max) n = max;
+  *start = gcore_tlm_flush_index;
+  for (i=0; i<n; i++) {
+    gcore_tlm_page_buf[i] = gcore_tlm_ring[(*start + i) % GCORE_TLM_RING_RECS];
+  }
+  xSemaphoreGive(gcore_tlm_mutex);
+
+  return n;
+}
+
+
+// Write up to one page of pending records to the next slot (call with gcore_tlm_fs_mutex held).
+// Records are copied out of the ring so the monitoring task is not blocked during the flash write.
+// With full == true only a complete page is written.  A partial page (full == false) is written
+// to the next slot without advancing past it so subsequent records are rewritten into the same
+// slot once the page fills.  Returns true when a complete page was written.
+bool _gcore_tlm_write_page(bool full)
+{
+  int i, n;
+  int start;
+  struct gcore_tlm_hdr_type hdr;
+  File f;
+  char name[16];
+
+  if (!gcore_tlm_fs_ok) return false;
+  n = _gcore_tlm_copy_pending(GCORE_TLM_PAGE_RECS, &start);
+  if ((n == 0) || (full && (n < GCORE_TLM_PAGE_RECS))) return false;
+
+  _gcore_tlm_slot_name(gcore_tlm_seq % GCORE_TLM_NUM_SLOTS, name);
+  f = SPIFFS.open(name, FILE_WRITE);
+  if (!f) return false;
+
+  hdr.magic = GCORE_TLM_MAGIC;
+  hdr.version = GCORE_TLM_VERSION;
+  hdr.count = n;
+  hdr.seq = gcore_tlm_seq;
+  f.write((const uint8_t*) &hdr, sizeof(hdr));
+  f.write((const uint8_t*) gcore_tlm_page_buf, n * sizeof(struct gcore_tlm_rec_type));
+  f.close();
+
+  if (n < GCORE_TLM_PAGE_RECS) return false;
+
+  xSemaphoreTake(gcore_tlm_mutex, portMAX_DELAY);
+  // The ring may have overflowed during the write, dropping some of these records
+  i = gcore_tlm_flush_index - start;
+  if (i < 0) i += GCORE_TLM_RING_RECS;
+  if (i < n) {
+    gcore_tlm_flush_index = (start + n) % GCORE_TLM_RING_RECS;
+  }
+  xSemaphoreGive(gcore_tlm_mutex);
+  gcore_tlm_seq++;
+
+  return true;
+}
+
+
+bool _gcore_tlm_read_hdr(int slot, struct gcore_tlm_hdr_type* hdr)
+{
+  File f;
+  char name[16];
+  bool valid = false;
+
+  _gcore_tlm_slot_name(slot, name);
+  if (!SPIFFS.exists(name)) return false;
+
+  f = SPIFFS.open(name, FILE_READ);
+  if (f) {
+    if (f.read((uint8_t*) hdr, sizeof(struct gcore_tlm_hdr_type)) == sizeof(struct gcore_tlm_hdr_type)) {
+      valid = (hdr->magic == GCORE_TLM_MAGIC) &&
+              (hdr->version == GCORE_TLM_VERSION) &&
+              (hdr->count <= GCORE_TLM_PAGE_RECS);
+    }
+    f.close();
+  }
+
+  return valid;
+}
+
+
+void _gcore_tlm_slot_name(int slot, char* name)
+{
+  sprintf(name, "/tlm%02d.bin", slot);
+}
+
+
+void _gcore_tlm_print_rec(Stream &s, struct gcore_tlm_rec_type* rec)
+{
+  const uint8_t* p = (const uint8_t*) rec;
+  int i;
+
+  for (i=0; i<sizeof(struct gcore_tlm_rec_type); i++) {
+    s.printf("%02X", p[i]);
+  }
+  s.printf("\n");
+}
+
+
+// Returns the load of the busiest core since the last call (percent)
+uint8_t _gcore_tlm_cpu_load()
+{
+  int i;
+  uint32_t idle, total;
+  uint32_t cur_idle, cur_total;
+  uint8_t load;
+  uint8_t max_load = 0;
+
+  for (i=0; i<portNUM_PROCESSORS; i++) {
+    cur_total = gcore_tlm_total_units[i];
+    cur_idle = gcore_tlm_idle_units[i];
+    idle = cur_idle - gcore_tlm_prev_idle[i];
+    total = cur_total - gcore_tlm_prev_total[i];
+    gcore_tlm_prev_idle[i] = cur_idle;
+    gcore_tlm_prev_total[i] = cur_total;
+    if (total == 0) continue;
+    // The tick hook may have run on the other core between the two reads
+    if (idle > total) idle = total;
+    load = (uint8_t) (100 - ((100 * (uint64_t) idle) / total));
+    if (load > max_load) max_load = load;
+  }
+
+  return max_load;
+}
+
+
+// Idle task loop (both cores) - returning true lets the idle task wait for an interrupt
+bool IRAM_ATTR _gcore_tlm_idle_hook()
+{
+  gcore_tlm_idle_start[xPortGetCoreID()] = xthal_get_ccount();
+  return true;
+}
+
+
+// Tick interrupt (both cores) - account the cycles of the last tick spent in the idle task
+void IRAM_ATTR _gcore_tlm_tick_hook()
+{
+  int core = xPortGetCoreID();
+  uint32_t now = xthal_get_ccount();
+  uint32_t tick = now - gcore_tlm_last_tick[core];
+  uint32_t idle = 0;
+
+  if ((xTaskGetCurrentTaskHandle() == xTaskGetIdleTaskHandleForCPU(core)) && (tick != 0)) {
+    // Idle since its last loop or the whole tick if it has not been preempted since then
+    idle = now - gcore_tlm_idle_start[core];
+    if (idle > tick) idle = tick;
+    idle = (uint32_t) (((uint64_t) idle << 8) / tick);
+  }
+  gcore_tlm_last_tick[core] = now;
+  gcore_tlm_idle_units[core] += idle;
+  gcore_tlm_total_units[core] += 256;
+}
@@ -0,0 +1,502 @@
+/*
+ * Fixed-width unsigned integer arithmetic for the calculator
+ *
+ * Multiplication is schoolbook (at most 16 x 16 limbs so Karatsuba doesn't pay for
+ * itself) with products truncated to the width.  Division uses Knuth's Algorithm D
+ * with a fast path for single limb divisors, which is also used for decimal
+ * conversion and digit entry.
+ */
+#include "calc_num.h"
+#include <string.h>
+
+
+// ================================================
+// Internal routines
+// ================================================
+static inline int calc_num_limbs(int bits)
+{
+  return (bits + 31) / 32;
+}
+
+
+// Number of limbs actually used (index of the most significant non-zero limb + 1)
+static int calc_num_used_limbs(const uint32_t* a, int nl)
+{
+  while ((nl > 0) && (a[nl-1] == 0)) nl--;
+  return nl;
+}
+
+
+static int calc_num_nlz(uint32_t x)
+{
+  int n = 0;
+
+  if (x == 0) return 32;
+  while ((x & 0x80000000) == 0) {
+    x <<= 1;
+    n++;
+  }
+  return n;
+}
+
+
+// Shift count from a number operand, saturated to bits (shifting by >= bits clears)
+static int calc_num_shift_count(const calc_num_t* n, int bits)
+{
+  int i;
+  int nl = calc_num_limbs(bits);
+
+  for (i=1; i<nl; i++) {
+    if (n->v[i] != 0) return bits;
+  }
+  return (n->v[0] > (uint32_t) bits) ? bits : (int) n->v[0];
+}
+
+
+// Knuth Algorithm D (after Hacker's Delight divmnu).  u has m limbs, v has n limbs with
+// v[n-1] != 0, m >= n >= 2.  q gets m-n+1 limbs and r gets n limbs.
+static void calc_num_divmnu(uint32_t* q, uint32_t* r, const uint32_t* u, const uint32_t* v, int m, int n)
+{
+  const uint64_t b = 0x100000000ULL;
+  uint32_t un[CALC_NUM_LIMBS + 1];
+  uint32_t vn[CALC_NUM_LIMBS];
+  uint64_t qhat, rhat, p;
+  int64_t t, k;
+  int i, j, s;
+
+  // Normalize so the divisor's top bit is set
+  s = calc_num_nlz(v[n-1]);
+  for (i=n-1; i>0; i--) {
+    vn[i] = (v[i] << s) | (s ? (v[i-1] >> (32-s)) : 0);
+  }
+  vn[0] = v[0] << s;
+
+  un[m] = s ? (u[m-1] >> (32-s)) : 0;
+  for (i=m-1; i>0; i--) {
+    un[i] = (u[i] << s) | (s ? (u[i-1] >> (32-s)) : 0);
+  }
+  un[0] = u[0] << s;
+
+  for (j=m-n; j>=0; j--) {
+    // Estimate the quotient digit
+    p = ((uint64_t) un[j+n] << 32) | un[j+n-1];
+    qhat = p / vn[n-1];
+    rhat = p - qhat * vn[n-1];
+    while ((qhat >= b) || ((qhat * vn[n-2]) > ((rhat << 32) | un[j+n-2]))) {
+      qhat--;
+      rhat += vn[n-1];
+      if (rhat >= b) break;
+    }
+
+    // Multiply and subtract
+    k = 0;
+    for (i=0; i<n; i++) {
+      p = qhat * vn[i];
+      t = (int64_t) un[i+j] - k - (int64_t) (p & 0xFFFFFFFF);
+      un[i+j] = (uint32_t) t;
+      k = (int64_t) (p >> 32) - (t >> 32);
+    }
+    t = (int64_t) un[j+n] - k;
+    un[j+n] = (uint32_t) t;
+
+    // Add back if we subtracted too much (rare)
+    q[j] = (uint32_t) qhat;
+    if (t < 0) {
+      q[j]--;
+      k = 0;
+      for (i=0; i<n; i++) {
+        t = (int64_t) un[i+j] + vn[i] + k;
+        un[i+j] = (uint32_t) t;
+        k = t >> 32;
+      }
+      un[j+n] = (uint32_t) (un[j+n] + k);
+    }
+  }
+
+  // Denormalize the remainder
+  for (i=0; i<n-1; i++) {
+    r[i] = (un[i] >> s) | (s ? (un[i+1] << (32-s)) : 0);
+  }
+  r[n-1] = un[n-1] >> s;
+}
+
+
+
+// ================================================
+// Initialization and conversion
+// ================================================
+void calc_num_zero(calc_num_t* a)
+{
+  memset(a->v, 0, sizeof(a->v));
+}
+
+
+void calc_num_set_u32(calc_num_t* a, uint32_t u)
+{
+  calc_num_zero(a);
+  a->v[0] = u;
+}
+
+
+bool calc_num_is_zero(const calc_num_t* a, int bits)
+{
+  return (calc_num_used_limbs(a->v, calc_num_limbs(bits)) == 0);
+}
+
+
+int calc_num_cmp(const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  int i;
+
+  for (i=calc_num_limbs(bits)-1; i>=0; i--) {
+    if (a->v[i] != b->v[i]) {
+      return (a->v[i] > b->v[i]) ? 1 : -1;
+    }
+  }
+  return 0;
+}
+
+
+bool calc_num_get_bit(const calc_num_t* a, int n)
+{
+  return ((a->v[n / 32] >> (n % 32)) & 0x1) != 0;
+}
+
+
+// Clear all bits at and above bits
+void calc_num_mask(calc_num_t* a, int bits)
+{
+  int i;
+  int nl = calc_num_limbs(bits);
+
+  if (bits % 32) {
+    a->v[nl-1] &= (1UL << (bits % 32)) - 1;
+  }
+  for (i=nl; i<CALC_NUM_LIMBS; i++) {
+    a->v[i] = 0;
+  }
+}
+
+
+// Print a number without leading zeros into s (at least CALC_NUM_STR_LEN bytes).
+// Returns the string length.
+int calc_num_to_str(const calc_num_t* a, int bits, bool base16, char* s)
+{
+  char rev[CALC_NUM_STR_LEN + 9];       // Room for the last partial group of nine digits
+  calc_num_t t;
+  uint32_t chunk;
+  int i, j, n;
+  int nl = calc_num_limbs(bits);
+
+  n = 0;
+  if (base16) {
+    for (i=0; i<nl; i++) {
+      for (j=0; j<8; j++) {
+        chunk = (a->v[i] >> (4*j)) & 0xF;
+        rev[n++] = (chunk > 9) ? ('A' + chunk - 10) : ('0' + chunk);
+      }
+    }
+  } else {
+    // Nine decimal digits at a time
+    t = *a;
+    while (!calc_num_is_zero(&t, bits)) {
+      chunk = calc_num_div_u32(&t, 1000000000, bits);
+      for (j=0; j<9; j++) {
+        rev[n++] = '0' + (chunk % 10);
+        chunk /= 10;
+      }
+    }
+  }
+
+  // Strip leading zeros (keeping at least one digit) and reverse
+  while ((n > 1) && (rev[n-1] == '0')) n--;
+  if (n == 0) rev[n++] = '0';
+  for (i=0; i<n; i++) {
+    s[i] = rev[n-1-i];
+  }
+  s[n] = 0;
+
+  return n;
+}
+
+
+
+// ================================================
+// Arithmetic
+// ================================================
+void calc_num_add(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  uint64_t t = 0;
+  int i;
+  int nl = calc_num_limbs(bits);
+
+  for (i=0; i<nl; i++) {
+    t += (uint64_t) a->v[i] + b->v[i];
+    r->v[i] = (uint32_t) t;
+    t >>= 32;
+  }
+  calc_num_mask(r, bits);
+}
+
+
+void calc_num_sub(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  int64_t t = 0;
+  int i;
+  int nl = calc_num_limbs(bits);
+
+  for (i=0; i<nl; i++) {
+    t += (int64_t) a->v[i] - b->v[i];
+    r->v[i] = (uint32_t) t;
+    t >>= 32;
+  }
+  calc_num_mask(r, bits);
+}
+
+
+void calc_num_mul(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  calc_num_t p;
+  uint64_t t;
+  int i, j;
+  int nl = calc_num_limbs(bits);
+  int na = calc_num_used_limbs(a->v, nl);
+  int nb = calc_num_used_limbs(b->v, nl);
+
+  // Only the partial products below the width are computed
+  calc_num_zero(&p);
+  for (i=0; i<na; i++) {
+    t = 0;
+    for (j=0; (j<nb) && ((i+j)<nl); j++) {
+      t += (uint64_t) a->v[i] * b->v[j] + p.v[i+j];
+      p.v[i+j] = (uint32_t) t;
+      t >>= 32;
+    }
+    if ((i+j) < nl) {
+      p.v[i+j] = (uint32_t) t;
+    }
+  }
+  calc_num_mask(&p, bits);
+  *r = p;
+}
+
+
+// Quotient and remainder (either may be NULL).  Division by 0 returns 0 for both.
+void calc_num_div(calc_num_t* q, calc_num_t* rem, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  calc_num_t tq, tr;
+  int nl = calc_num_limbs(bits);
+  int m = calc_num_used_limbs(a->v, nl);
+  int n = calc_num_used_limbs(b->v, nl);
+
+  calc_num_zero(&tq);
+  calc_num_zero(&tr);
+
+  if (n == 0) {
+    // Like the Apple calculator we just return 0 for a division by 0
+  } else if (calc_num_cmp(a, b, bits) < 0) {
+    tr = *a;
+  } else if (n == 1) {
+    tq = *a;
+    tr.v[0] = calc_num_div_u32(&tq, b->v[0], bits);
+  } else {
+    calc_num_divmnu(tq.v, tr.v, a->v, b->v, m, n);
+  }
+
+  if (q != NULL) *q = tq;
+  if (rem != NULL) *rem = tr;
+}
+
+
+// a = a * m + add (used for digit entry).  Returns true if the result was truncated.
+bool calc_num_mul_add_u32(calc_num_t* a, uint32_t m, uint32_t add, int bits)
+{
+  uint64_t t = add;
+  int i;
+  int nl = calc_num_limbs(bits);
+  bool overflow;
+
+  for (i=0; i<nl; i++) {
+    t += (uint64_t) a->v[i] * m;
+    a->v[i] = (uint32_t) t;
+    t >>= 32;
+  }
+  overflow = (t != 0) || ((bits % 32) && ((a->v[nl-1] >> (bits % 32)) != 0));
+  calc_num_mask(a, bits);
+
+  return overflow;
+}
+
+
+// a = a / d, returns the remainder.  d must be non-zero.
+uint32_t calc_num_div_u32(calc_num_t* a, uint32_t d, int bits)
+{
+  uint64_t t = 0;
+  int i;
+
+  for (i=calc_num_used_limbs(a->v, calc_num_limbs(bits))-1; i>=0; i--) {
+    t = (t << 32) | a->v[i];
+    a->v[i] = (uint32_t) (t / d);
+    t = t % d;
+  }
+
+  return (uint32_t) t;
+}
+
+
+// Two's complement
+void calc_num_neg(calc_num_t* a, int bits)
+{
+  calc_num_not(a, bits);
+  calc_num_mul_add_u32(a, 1, 1, bits);
+}
+
+
+
+// ================================================
+// Logic, shift and rotate
+// ================================================
+void calc_num_and(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  int i;
+
+  for (i=0; i<calc_num_limbs(bits); i++) {
+    r->v[i] = a->v[i] & b->v[i];
+  }
+  calc_num_mask(r, bits);
+}
+
+
+void calc_num_or(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  int i;
+
+  for (i=0; i<calc_num_limbs(bits); i++) {
+    r->v[i] = a->v[i] | b->v[i];
+  }
+  calc_num_mask(r, bits);
+}
+
+
+void calc_num_xor(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  int i;
+
+  for (i=0; i<calc_num_limbs(bits); i++) {
+    r->v[i] = a->v[i] ^ b->v[i];
+  }
+  calc_num_mask(r, bits);
+}
+
+
+void calc_num_not(calc_num_t* a, int bits)
+{
+  int i;
+
+  for (i=0; i<calc_num_limbs(bits); i++) {
+    a->v[i] = ~a->v[i];
+  }
+  calc_num_mask(a, bits);
+}
+
+
+// Shift by a number operand
+void calc_num_shl(calc_num_t* a, const calc_num_t* n, int bits)
+{
+  calc_num_shl_n(a, calc_num_shift_count(n, bits), bits);
+}
+
+
+void calc_num_shr(calc_num_t* a, const calc_num_t* n, int bits)
+{
+  calc_num_shr_n(a, calc_num_shift_count(n, bits), bits);
+}
+
+
+void calc_num_shl_n(calc_num_t* a, int n, int bits)
+{
+  int i;
+  int nl = calc_num_limbs(bits);
+  int limbs = n / 32;
+  int s = n % 32;
+
+  if (n >= bits) {
+    calc_num_zero(a);
+    return;
+  }
+
+  for (i=nl-1; i>=0; i--) {
+    if (i < limbs) {
+      a->v[i] = 0;
+    } else if ((s == 0) || (i == limbs)) {
+      a->v[i] = a->v[i-limbs] << s;
+    } else {
+      a->v[i] = (a->v[i-limbs] << s) | (a->v[i-limbs-1] >> (32-s));
+    }
+  }
+  calc_num_mask(a, bits);
+}
+
+
+void calc_num_shr_n(calc_num_t* a, int n, int bits)
+{
+  int i;
+  int nl = calc_num_limbs(bits);
+  int limbs = n / 32;
+  int s = n % 32;
+
+  if (n >= bits) {
+    calc_num_zero(a);
+    return;
+  }
+
+  for (i=0; i<nl; i++) {
+    if ((i + limbs) >= nl) {
+      a->v[i] = 0;
+    } else if ((s == 0) || ((i + limbs + 1) >= nl)) {
+      a->v[i] = a->v[i+limbs] >> s;
+    } else {
+      a->v[i] = (a->v[i+limbs] >> s) | (a->v[i+limbs+1] << (32-s));
+    }
+  }
+}
+
+
+void calc_num_rol(calc_num_t* a, int n, int bits)
+{
+  calc_num_t t;
+
+  n = n % bits;
+  if (n == 0) return;
+
+  t = *a;
+  calc_num_shl_n(a, n, bits);
+  calc_num_shr_n(&t, bits - n, bits);
+  calc_num_or(a, a, &t, bits);
+}
+
+
+void calc_num_ror(calc_num_t* a, int n, int bits)
+{
+  n = n % bits;
+  if (n != 0) {
+    calc_num_rol(a, bits - n, bits);
+  }
+}
+
+
+// Reverse the order of the bytes in the width
+void calc_num_swap_endian(calc_num_t* a, int bits)
+{
+  calc_num_t t;
+  int i;
+  int nb = bits / 8;
+  uint8_t byte;
+
+  calc_num_zero(&t);
+  for (i=0; i<nb; i++) {
+    byte = (a->v[i / 4] >> (8 * (i % 4))) & 0xFF;
+    t.v[(nb-1-i) / 4] |= (uint32_t) byte << (8 * ((nb-1-i) % 4));
+  }
+  *a = t;
+}
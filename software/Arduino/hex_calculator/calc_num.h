@@ -0,0 +1,58 @@
+/*
+ * Fixed-width unsigned integer arithmetic for the calculator
+ *
+ * Numbers are stored as CALC_NUM_LIMBS 32-bit limbs, least significant limb first,
+ * supporting widths up to CALC_MAX_BITS.  Routines take the current width in bits
+ * and only touch the limbs that width needs.  Results are truncated (masked) to the
+ * width like the fixed-size registers they model.
+ *
+ * Plain C/C++ with no Arduino dependencies so it can also be built on a host.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define CALC_MAX_BITS    512
+#define CALC_NUM_LIMBS   (CALC_MAX_BITS / 32)
+
+// Characters in the longest (base10) number of CALC_MAX_BITS plus terminator
+#define CALC_NUM_STR_LEN 156
+
+
+typedef struct {
+  uint32_t v[CALC_NUM_LIMBS];
+} calc_num_t;
+
+
+// Initialization and conversion
+void calc_num_zero(calc_num_t* a);
+void calc_num_set_u32(calc_num_t* a, uint32_t u);
+bool calc_num_is_zero(const calc_num_t* a, int bits);
+int calc_num_cmp(const calc_num_t* a, const calc_num_t* b, int bits);
+bool calc_num_get_bit(const calc_num_t* a, int n);
+void calc_num_mask(calc_num_t* a, int bits);
+int calc_num_to_str(const calc_num_t* a, int bits, bool base16, char* s);
+
+// Arithmetic (r may be the same as a or b)
+void calc_num_add(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits);
+void calc_num_sub(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits);
+void calc_num_mul(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits);
+void calc_num_div(calc_num_t* q, calc_num_t* rem, const calc_num_t* a, const calc_num_t* b, int bits);
+bool calc_num_mul_add_u32(calc_num_t* a, uint32_t m, uint32_t add, int bits);
+uint32_t calc_num_div_u32(calc_num_t* a, uint32_t d, int bits);
+void calc_num_neg(calc_num_t* a, int bits);
+
+// Logic, shift and rotate
+void calc_num_and(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits);
+void calc_num_or(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits);
+void calc_num_xor(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits);
+void calc_num_not(calc_num_t* a, int bits);
+void calc_num_shl(calc_num_t* a, const calc_num_t* n, int bits);
+void calc_num_shr(calc_num_t* a, const calc_num_t* n, int bits);
+void calc_num_shl_n(calc_num_t* a, int n, int bits);
+void calc_num_shr_n(calc_num_t* a, int n, int bits);
+void calc_num_rol(calc_num_t* a, int n, int bits);
+void calc_num_ror(calc_num_t* a, int n, int bits);
+void calc_num_swap_endian(calc_num_t* a, int bits);
@@ -37,10 +37,9 @@ int calc_state;
 int calc_num_bits;
 int calc_op_val;
 bool calc_base16;
-uint64_t calc_valid_mask;
-uint64_t calc_op_A;
-uint64_t calc_op_B;
-uint64_t calc_mem;
+calc_num_t calc_op_A;
+calc_num_t calc_op_B;
+calc_num_t calc_mem;
 
 
 
@@ -54,10 +53,9 @@ void calc_init()
   calc_op_val = CALC_OP_NUL;
   calc_base16 = false;
   calc_num_bits = 64;
-  calc_valid_mask = calc_bits_to_mask(calc_num_bits);
-  calc_op_A = 0;
-  calc_op_B = 0;
-  calc_mem = 0;
+  calc_num_zero(&calc_op_A);
+  calc_num_zero(&calc_op_B);
+  calc_num_zero(&calc_mem);
 }
 
 
@@ -65,10 +63,8 @@ void calc_set_bits(int n)
 {
   calc_num_bits = n;
 
-  calc_valid_mask = calc_bits_to_mask(calc_num_bits);
-
-  calc_op_A &= calc_valid_mask;
-  calc_op_B &= calc_valid_mask;
+  calc_num_mask(&calc_op_A, calc_num_bits);
+  calc_num_mask(&calc_op_B, calc_num_bits);
   calc_update_display();  
 }
 
@@ -92,19 +88,9 @@ bool calc_get_base16()
 }
 
 
-uint64_t calc_get_op_val()
-{
-  return ((calc_state == CALC_ST_ENT_A) || (calc_state == CALC_ST_RES)) ? calc_op_A : calc_op_B;
-}
-
-
-void calc_put_op_val(uint64_t v)
+calc_num_t* calc_get_op_val()
 {
-  if ((calc_state == CALC_ST_ENT_A) || (calc_state == CALC_ST_RES)) {
-    calc_op_A = v;
-  } else {
-    calc_op_B = v;
-  }
+  return ((calc_state == CALC_ST_ENT_A) || (calc_state == CALC_ST_RES)) ? &calc_op_A : &calc_op_B;
 }
 
 
@@ -119,21 +105,23 @@ void calc_btn_AC()
   // All clear
   calc_state = CALC_ST_ENT_A;
   calc_op_val = CALC_OP_NUL;
-  calc_op_A = 0;
-  calc_op_B = 0;
-  gui_update_display(0);
+  calc_num_zero(&calc_op_A);
+  calc_num_zero(&calc_op_B);
+  gui_update_display(&calc_op_A);
 }
 
 
 void calc_btn_BKSP()
 {
+  calc_num_t* t = calc_get_op_val();
+  
   // Backspace one digit
-  if ((calc_state == CALC_ST_ENT_A) || (calc_state == CALC_ST_RES)) {
-    calc_op_A /= (calc_base16) ? 16 : 10;
-    gui_update_display(calc_op_A);
+  calc_num_div_u32(t, (calc_base16) ? 16 : 10, calc_num_bits);
+  if (calc_state == CALC_ST_ENT_OP) {
+    // Display currently shows the first operand
+    gui_update_display(t);
   } else {
-    calc_op_B /= (calc_base16) ? 16 : 10;
-    gui_update_display(calc_op_B);
+    gui_update_display_bksp(t);
   }
 }
 
@@ -142,11 +130,11 @@ void calc_btn_CLR()
 {
   // Clear last entry
   if (calc_state == CALC_ST_ENT_A) {
-    calc_op_A = 0;
-    gui_update_display(0);
+    calc_num_zero(&calc_op_A);
+    gui_update_display(&calc_op_A);
   } else if (calc_state == CALC_ST_ENT_B) {
-    calc_op_B = 0;
-    gui_update_display(0);
+    calc_num_zero(&calc_op_B);
+    gui_update_display(&calc_op_B);
   } else if (calc_state == CALC_ST_RES) {
     calc_btn_AC();
   }
@@ -157,13 +145,19 @@ void calc_btn_VAL(uint8_t v, uint16_t alt_v)
 {
   uint16_t add_val;
   uint16_t mult_val;
-  uint64_t t;
+  calc_num_t* t;
+  const char* digits;
+  int num_digits;
+  bool new_entry;
+  bool overflow;
 
   // Handle states
+  new_entry = (calc_state == CALC_ST_RES) || (calc_state == CALC_ST_ENT_OP);
   if (calc_state == CALC_ST_RES) {
     // User starts entering a number while displaying a result
-    t = 0;
     calc_state = CALC_ST_ENT_A;
+    t = calc_get_op_val();
+    calc_num_zero(t);
   } else {
     if (calc_state == CALC_ST_ENT_OP) {
       calc_state = CALC_ST_ENT_B;
@@ -174,26 +168,34 @@ void calc_btn_VAL(uint8_t v, uint16_t alt_v)
   }
 
   // Determine if we are using the normal value or an alternate value (used for '0' and '00' when
-  // the value is currently not 0)
-  if ((t != 0) && (alt_v != 0)) {
+  // the value is currently not 0).  Also determine the digits this appends to the display.
+  if (!calc_num_is_zero(t, calc_num_bits) && (alt_v != 0)) {
     add_val = 0;
     mult_val = alt_v;
+    digits = "00";
+    num_digits = ((alt_v == 10) || (alt_v == 16)) ? 1 : 2;
   } else {
     add_val = v;
     if (v == 0xFF) {
       // Handle the special case of FF
       mult_val = 256;
+      digits = (calc_base16) ? "FF" : NULL;
+      num_digits = 2;
     } else {
       mult_val = (calc_base16) ? 16 : 10;
+      digits = &"0123456789ABCDEF"[v];
+      num_digits = 1;
     }
   }
 
-  // Compute the new value
-  t = ((t * mult_val) + add_val) & calc_valid_mask;
-
-  // Finally copy back the [possibly] updated operand and update the display
-  calc_put_op_val(t);
-  gui_update_display(t);
+  // Compute the new value in place and update the display, only appending the new digits
+  // when the digits already displayed are still valid
+  overflow = calc_num_mul_add_u32(t, mult_val, add_val, calc_num_bits);
+  if (new_entry || overflow || (digits == NULL)) {
+    gui_update_display(t);
+  } else {
+    gui_update_display_append(t, digits, num_digits);
+  }
 }
 
 
@@ -214,81 +216,70 @@ void calc_btn_op(uint8_t op)
 // Operand for immediate calculation
 void calc_btn_imm(uint8_t op)
 {
-  uint64_t t;
+  calc_num_t t;
 
-  t = calc_get_op_val();
+  t = *calc_get_op_val();
   
   switch (op) {
     case CALC_OP_EQ:
       switch (calc_op_val) {
         case CALC_OP_ADD:
-          t = (calc_op_A + calc_op_B) & calc_valid_mask;
+          calc_num_add(&t, &calc_op_A, &calc_op_B, calc_num_bits);
           break;
         case CALC_OP_SUB:
-          t = (calc_op_A - calc_op_B) & calc_valid_mask;
+          calc_num_sub(&t, &calc_op_A, &calc_op_B, calc_num_bits);
           break;
         case CALC_OP_MUL:
-          t = (calc_op_A * calc_op_B) & calc_valid_mask;
+          calc_num_mul(&t, &calc_op_A, &calc_op_B, calc_num_bits);
           break;
         case CALC_OP_DIV:
           // Like the Apple calculator we just return 0 for a division by 0
-          if (calc_op_B == 0) {
-            t = 0;
-          } else {
-            t = (calc_op_A / calc_op_B) & calc_valid_mask;
-          }
-         break;
+          calc_num_div(&t, NULL, &calc_op_A, &calc_op_B, calc_num_bits);
+          break;
         case CALC_OP_AND:
-          t = (calc_op_A & calc_op_B) & calc_valid_mask;
+          calc_num_and(&t, &calc_op_A, &calc_op_B, calc_num_bits);
           break;
         case CALC_OP_OR:
-          t = (calc_op_A | calc_op_B) & calc_valid_mask;
+          calc_num_or(&t, &calc_op_A, &calc_op_B, calc_num_bits);
           break;
         case CALC_OP_NOR:
-          t = ~(calc_op_A | calc_op_B) & calc_valid_mask;
+          calc_num_or(&t, &calc_op_A, &calc_op_B, calc_num_bits);
+          calc_num_not(&t, calc_num_bits);
           break;
         case CALC_OP_XOR:
-          t = (calc_op_A ^ calc_op_B) & calc_valid_mask;
+          calc_num_xor(&t, &calc_op_A, &calc_op_B, calc_num_bits);
           break;
         case CALC_OP_XLY:
-          t = (calc_op_A << calc_op_B) & calc_valid_mask;
+          t = calc_op_A;
+          calc_num_shl(&t, &calc_op_B, calc_num_bits);
           break;
         case CALC_OP_XRY:
-          t = (calc_op_A >> calc_op_B) & calc_valid_mask;
+          t = calc_op_A;
+          calc_num_shr(&t, &calc_op_B, calc_num_bits);
           break;
       }
       calc_state = CALC_ST_RES;
       break;
     case CALC_OP_END:
-      t = calc_swap_endian(t);
+      calc_num_swap_endian(&t, calc_num_bits);
       break;
     case CALC_OP_L1:
-      t = (t << 1) & calc_valid_mask;
+      calc_num_shl_n(&t, 1, calc_num_bits);
       break;
     case CALC_OP_R1:
-      t = (t >> 1) & calc_valid_mask;
+      calc_num_shr_n(&t, 1, calc_num_bits);
       break;
     case CALC_OP_ROL:
-      if (t & ((uint64_t) 1 << (calc_num_bits - 1))) {
-        // Rotate MSbit into LSbit
-        t = ((t << 1) & calc_valid_mask) + 1;
-      } else {
-        t = (t << 1) & calc_valid_mask;
-      }
+      calc_num_rol(&t, 1, calc_num_bits);
       break;
     case CALC_OP_ROR:
-      if (t & 0x1) {
-        // Rotate LSbit into MSbit
-        t = ((t >> 1) & calc_valid_mask) | ((uint64_t) 1 << (calc_num_bits - 1));
-      } else {
-        t = (t >> 1) & calc_valid_mask;
-      }
+      calc_num_ror(&t, 1, calc_num_bits);
       break;
     case CALC_OP_2S:
-      t = (~t + 1) & calc_valid_mask;
+      calc_num_neg(&t, calc_num_bits);
       break;
     case CALC_OP_1S:
-      t = ~t & calc_valid_mask;
+      calc_num_not(&t, calc_num_bits);
       break;
   }
 
@@ -301,133 +292,30 @@ void calc_btn_imm(uint8_t op)
 
   // Prepare this result to be the first operand of a subsequent calculation
   calc_op_A = t;
-  calc_op_B = 0;
+  calc_num_zero(&calc_op_B);
   calc_state = CALC_ST_RES;
-  gui_update_display(t);
+  gui_update_display(&calc_op_A);
 }
 
 
 // Memory functions don't affect calculator state
 void calc_btn_MC()
 {
-  calc_mem = 0;
+  calc_num_zero(&calc_mem);
 }
 
 
 void calc_btn_MADD()
 {
-  calc_mem = (calc_mem + calc_get_op_val()) & calc_valid_mask;
+  calc_num_add(&calc_mem, &calc_mem, calc_get_op_val(), calc_num_bits);
 }
 
 
 void calc_btn_MR()
 {
-  uint64_t t;
+  calc_num_t* t = calc_get_op_val();
 
-  t = calc_mem & calc_valid_mask;
-  calc_put_op_val(t);
+  *t = calc_mem;
+  calc_num_mask(t, calc_num_bits);
   gui_update_display(t);
 }
-
-
-
-// ================================================
-// Calc module private routines
-// ================================================
-uint64_t calc_bits_to_mask(int n)
-{
-  uint64_t m;
-  
-  switch (n) {
-    case 8:
-      m = 0xFF;
-      break;
-    case 16:
-      m = 0xFFFF;
-      break;
-    case 24:
-      m = 0xFFFFFF;
-      break;
-    case 32:
-      m = 0xFFFFFFFF;
-      break;
-    case 40:
-      m = 0xFFFFFFFFFF;
-      break;
-    case 48:
-      m = 0xFFFFFFFFFFFF;
-      break;
-    case 56:
-      m = 0xFFFFFFFFFFFFFF;
-      break;
-    default:
-      m = 0xFFFFFFFFFFFFFFFF;
-  }
-
-  return m;
-}
-
-
-uint64_t calc_swap_endian(uint64_t v)
-{
-  uint64_t t;
-  
-  // Swapping depends on number of bits
-  switch (calc_num_bits) {
-    case 8:
-      // Nothing happens for 8-bits
-      t = v;
-      break;
-    case 16:
-      t = (v >> 8) & 0xFF;
-      t |= (v << 8) & 0xFF00;
-      break;
-    case 24:
-      // Odd byte configurations like this don't really make sense but we try something anyway
-      t = (v >> 16) & 0xFF;
-      t |= (v & 0xFF00);
-      t |= (v << 16) & 0xFF0000;
-      break;
-    case 32:
-      t = (v >> 24) & 0xFF;
-      t |= (v >> 8) & 0xFF00;
-      t |= (v << 8) & 0xFF0000;
-      t |= (v << 24) & 0xFF000000;
-      break;
-    case 40:
-      t = (v >> 32) & 0xFF;
-      t |= (v >> 16) & 0xFF00;
-      t |= (v & 0xFF0000);
-      t |= (v << 16) & 0xFF000000;
-      t |= (v << 32) & 0xFF00000000;
-      break;
-    case 48:
-      t = (v >> 40) & 0xFF;
-      t |= (v >> 24) & 0xFF00;
-      t |= (v >> 8) & 0xFF0000;
-      t |= (v << 8) & 0xFF000000;
-      t |= (v << 24) & 0xFF00000000;
-      t |= (v << 40) & 0xFF0000000000;
-      break;
-    case 56:
-      t = (v >> 48) & 0xFF;
-      t |= (v >> 32) & 0xFF00;
-      t |= (v >> 16) & 0xFF0000;
-      t |= (v & 0xFF000000);
-      t |= (v << 16) & 0xFF00000000;
-      t |= (v << 32) & 0xFF0000000000;
-      t |= (v << 48) & 0xFF000000000000;
-      break;
-    default:
-      t = (v >> 56) & 0xFF;
-      t |= (v >> 40) & 0xFF00;
-      t |= (v >> 24) & 0xFF0000;
-      t |= (v >> 8) & 0xFF000000;
-      t |= (v << 8) & 0xFF00000000;
-      t |= (v << 24) & 0xFF0000000000;
-      t |= (v << 40) & 0xFF000000000000;
-      t |= (v << 56) & 0xFF00000000000000;
-  }
-
-  return t & calc_valid_mask;
-}
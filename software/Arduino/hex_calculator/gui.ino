@@ -62,6 +62,15 @@ static const char* btn_map[] = {"AND", "OR", "D", "E", "F", "AC", "C", "\n",
 const uint16_t hex_digit_indicies[7] = {BTN_A, BTN_B, BTN_C, BTN_D, BTN_E, BTN_F, BTN_FF};
 
 
+// Readout position and size
+#define GUI_RO_X      65
+#define GUI_RO_Y      2
+#define GUI_RO_W      350
+#define GUI_RO_H      48
+
+// Maximum number of digit cells in the readout (3 rows of the small font)
+#define GUI_RO_MAX_CELLS 128
+
 // Background color for switch and drop-down selected item
 #define SELECTED_COLOR LV_COLOR_MAKE(0x30, 0x30, 0x50)
 
@@ -77,7 +86,7 @@ lv_obj_t* scr_main;
 lv_obj_t* dd_num_bits;
 
 // Display
-lv_obj_t* lbl_disp;
+lv_obj_t* obj_readout;
 
 // Hex/Decimal switch
 lv_obj_t* sw_base;
@@ -91,6 +100,22 @@ lv_obj_t* btnm_keypad;
 // ================================================
 bool noted_low_batt = false;
 
+// Formatted value cache - the string currently displayed, most significant digit first
+char gui_disp_str[CALC_NUM_STR_LEN];
+int gui_disp_len = 0;
+
+// Readout layout.  The readout is a grid of fixed-width cells, one glyph per cell, filled
+// from the bottom-right with the least significant digit so only cells whose glyph changes
+// need to be redrawn.
+lv_design_cb_t gui_ro_ancestor_design;
+const lv_font_t* gui_ro_font;
+lv_color_t gui_ro_color = READOUT_COLOR;
+lv_coord_t gui_ro_cell_w;
+lv_coord_t gui_ro_line_h;
+int gui_ro_cols;
+int gui_ro_rows;
+char gui_ro_cells[GUI_RO_MAX_CELLS];     // Glyph in each cell, index 0 is least significant, 0 = blank
+
 
 // ================================================
 // GUI API Routines
@@ -114,18 +139,20 @@ void gui_init()
   lv_obj_set_style_local_bg_color(dd_num_bits, LV_DROPDOWN_PART_SELECTED, LV_STATE_DEFAULT, SELECTED_COLOR);
   lv_obj_set_pos(dd_num_bits, 5, 5);
   lv_obj_set_width(dd_num_bits, 60);
-  lv_dropdown_set_options(dd_num_bits, "8\n16\n24\n32\n40\n48\n56\n64");
+  lv_dropdown_set_options(dd_num_bits, "8\n16\n24\n32\n40\n48\n56\n64\n128\n256");
   lv_dropdown_set_max_height(dd_num_bits, 300);
   lv_obj_set_event_cb(dd_num_bits, gui_cb_num_bits);
 
-  lbl_disp = lv_label_create(scr_main, NULL);
-  lv_label_set_long_mode(lbl_disp, LV_LABEL_LONG_BREAK);
-  lv_label_set_align(lbl_disp, LV_LABEL_ALIGN_RIGHT);
-  lv_obj_set_style_local_text_font(lbl_disp, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, &lv_font_montserrat_28);
-  lv_obj_set_style_local_text_color(lbl_disp, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, READOUT_COLOR);
-  lv_obj_set_pos(lbl_disp, 65, 10);
-  lv_obj_set_width(lbl_disp, 350);
-  lv_label_set_text_static(lbl_disp, "0");
+  obj_readout = lv_obj_create(scr_main, NULL);
+  lv_obj_set_style_local_bg_opa(obj_readout, LV_OBJ_PART_MAIN, LV_STATE_DEFAULT, LV_OPA_TRANSP);
+  lv_obj_set_style_local_border_width(obj_readout, LV_OBJ_PART_MAIN, LV_STATE_DEFAULT, 0);
+  lv_obj_set_pos(obj_readout, GUI_RO_X, GUI_RO_Y);
+  lv_obj_set_size(obj_readout, GUI_RO_W, GUI_RO_H);
+  lv_obj_set_click(obj_readout, false);
+  gui_ro_ancestor_design = lv_obj_get_design_cb(obj_readout);
+  lv_obj_set_design_cb(obj_readout, gui_readout_design);
+  memset(gui_ro_cells, 0, sizeof(gui_ro_cells));
+  gui_readout_set_font(&lv_font_montserrat_28);
 
   sw_base = lv_switch_create(scr_main, NULL);
   lv_obj_add_style(sw_base, LV_SWITCH_PART_BG, &style_page_override);
@@ -169,6 +196,12 @@ void gui_init()
     case 56:
       lv_dropdown_set_selected(dd_num_bits, 6);
       break;
+    case 128:
+      lv_dropdown_set_selected(dd_num_bits, 8);
+      break;
+    case 256:
+      lv_dropdown_set_selected(dd_num_bits, 9);
+      break;
     default:
       lv_dropdown_set_selected(dd_num_bits, 7);
   }
@@ -185,69 +218,182 @@ void gui_init()
 }
 
 
-void gui_update_display(uint64_t v)
+// Reformat the entire value
+void gui_update_display(const calc_num_t* v)
+{
+  gui_disp_len = calc_num_to_str(v, calc_get_bits(), calc_get_base16(), gui_disp_str);
+  gui_readout_update();
+}
+
+
+// Digit entry - v is the displayed value with n digits appended (without truncation)
+void gui_update_display_append(const calc_num_t* v, const char* digits, int n)
+{
+  int i;
+
+  if ((gui_disp_len == 1) && (gui_disp_str[0] == '0')) {
+    // Replace the zero, skipping any new leading zeros
+    gui_disp_len = 0;
+    while ((n > 1) && (*digits == '0')) {
+      digits++;
+      n--;
+    }
+    if ((n == 1) && (*digits == '0')) {
+      // Still zero
+      gui_disp_len = 1;
+      n = 0;
+    }
+  }
+  if ((gui_disp_len + n) >= CALC_NUM_STR_LEN) {
+    gui_update_display(v);
+    return;
+  }
+  
+  for (i=0; i<n; i++) {
+    gui_disp_str[gui_disp_len++] = digits[i];
+  }
+  gui_disp_str[gui_disp_len] = 0;
+  gui_readout_update();
+}
+
+
+// Backspace - v is the displayed value with its least significant digit removed
+void gui_update_display_bksp(const calc_num_t* v)
+{
+  if (gui_disp_len > 1) {
+    gui_disp_str[--gui_disp_len] = 0;
+  } else {
+    gui_disp_str[0] = '0';
+    gui_disp_str[1] = 0;
+    gui_disp_len = 1;
+  }
+  gui_readout_update();
+}
+
+
+
+// ================================================
+// GUI readout
+// ================================================
+
+// Load the formatted value into the readout cells, invalidating only cells that changed
+void gui_readout_update()
 {
-  static char buf[21];                      // Sized to hold the longest (base10) number "18446744073709551615"
-                                            // Static for LVGL
-  int dig[20];                              // Base10 digits in reverse order (lowest first)
+  lv_area_t a;
+  lv_coord_t w;
   int i;
   int n;
-  bool leading_zero;
+  char c;
 
   // Change to low-battery color if necessary
   if (low_batt_flag && !noted_low_batt) {
     noted_low_batt = true;
-    lv_obj_set_style_local_text_color(lbl_disp, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, READOUT_COLOR_LB);
+    gui_ro_color = READOUT_COLOR_LB;
+    lv_obj_invalidate(obj_readout);
   }
 
-  // ESP32 Arduino doesn't print 64-bit numbers so we have to piece together a result
-  if (calc_get_base16()) {
-    // Break the number down into individual hexadecimal digit values
-    for (i=0; i<16; i++) {
-      n = v & 0xF;
-      v = v >> 4;
-      dig[i] = n;
-    }
-    
-    // Then "print" the digits to the character array, blanking leading zeros
-    leading_zero = true;
-    n = 0;
-    for (i=15; i>=0; i--) {
-      if (dig[i] != 0) {
-        leading_zero = false;
-        if (dig[i] > 9) {
-          buf[n++] = 'A' + (dig[i] - 10);
-        } else {
-          buf[n++] = '0' + dig[i];
-        }
-      } else if ((!leading_zero) || (i == 0)) {
-        buf[n++] = '0';
-      }
+  // Use the large font unless the value doesn't fit on one line
+  if (gui_ro_font == &lv_font_montserrat_28) {
+    if (gui_disp_len > gui_ro_cols) {
+      gui_readout_set_font(&lv_font_montserrat_14);
     }
   } else {
-    // Break the number down into individual decimal digit values
-    for (i=0; i<20; i++) {
-      n = v % 10;
-      v = v / 10;
-      dig[i] = n;
+    if (gui_disp_len <= gui_readout_cols(&lv_font_montserrat_28, &w)) {
+      gui_readout_set_font(&lv_font_montserrat_28);
     }
+  }
 
-    // Then "print" the digits to the character array, blanking leading zeros
-    leading_zero = true;
-    n = 0;
-    for (i=19; i>=0; i--) {
-      if (dig[i] != 0) {
-        leading_zero = false;
-        buf[n++] = '0' + dig[i];
-      } else if ((!leading_zero) || (i == 0)) {
-        buf[n++] = '0';
-      }
+  n = gui_ro_cols * gui_ro_rows;
+  if (n > GUI_RO_MAX_CELLS) n = GUI_RO_MAX_CELLS;
+  for (i=0; i<n; i++) {
+    c = (i < gui_disp_len) ? gui_disp_str[gui_disp_len - 1 - i] : 0;
+    if (c != gui_ro_cells[i]) {
+      gui_ro_cells[i] = c;
+      gui_readout_cell_area(i, &a);
+      lv_obj_invalidate_area(obj_readout, &a);
     }
   }
-  buf[n] = 0;  // terminate the string
+}
+
+
+// Change the readout font, recomputing the cell layout and redrawing everything
+void gui_readout_set_font(const lv_font_t* font)
+{
+  gui_ro_font = font;
+  gui_ro_cols = gui_readout_cols(font, &gui_ro_cell_w);
+  gui_ro_line_h = lv_font_get_line_height(font);
+  gui_ro_rows = GUI_RO_H / gui_ro_line_h;
+  if (gui_ro_rows < 1) gui_ro_rows = 1;
+  memset(gui_ro_cells, 0, sizeof(gui_ro_cells));
+  lv_obj_invalidate(obj_readout);
+}
+
+
+// Returns the cell width for a font (the widest digit) in cell_w and the number of cells that fit across the readout
+int gui_readout_cols(const lv_font_t* font, lv_coord_t* cell_w)
+{
+  const char* c = "0123456789ABCDEF";
+  lv_coord_t w = 0;
+  lv_coord_t gw;
 
-  // Update the display
-  lv_label_set_text_static(lbl_disp, buf);
+  while (*c) {
+    gw = lv_font_get_glyph_width(font, *c++, 0);
+    if (gw > w) w = gw;
+  }
+  *cell_w = w;
+  return GUI_RO_W / w;
+}
+
+
+// Screen area of a cell (index 0 is the bottom-right cell)
+void gui_readout_cell_area(int i, lv_area_t* a)
+{
+  int row = gui_ro_rows - 1 - (i / gui_ro_cols);
+  int col = gui_ro_cols - 1 - (i % gui_ro_cols);
+  lv_coord_t x0 = obj_readout->coords.x1 + (GUI_RO_W - gui_ro_cols * gui_ro_cell_w);
+  lv_coord_t y0 = obj_readout->coords.y1 + (GUI_RO_H - gui_ro_rows * gui_ro_line_h) / 2;
+
+  a->x1 = x0 + col * gui_ro_cell_w;
+  a->x2 = a->x1 + gui_ro_cell_w - 1;
+  a->y1 = y0 + row * gui_ro_line_h;
+  a->y2 = a->y1 + gui_ro_line_h - 1;
+}
+
+
+// Draw the glyphs in the cells that intersect the area being redrawn
+lv_design_res_t gui_readout_design(lv_obj_t* obj, const lv_area_t* clip_area, lv_design_mode_t mode)
+{
+  lv_draw_label_dsc_t dsc;
+  lv_area_t a;
+  lv_area_t t;
+  char txt[2];
+  int i;
+  int n;
+
+  if (mode != LV_DESIGN_DRAW_MAIN) {
+    return gui_ro_ancestor_design(obj, clip_area, mode);
+  }
+
+  gui_ro_ancestor_design(obj, clip_area, mode);
+
+  lv_draw_label_dsc_init(&dsc);
+  dsc.font = gui_ro_font;
+  dsc.color = gui_ro_color;
+  dsc.flag = LV_TXT_FLAG_CENTER;
+  txt[1] = 0;
+
+  n = gui_ro_cols * gui_ro_rows;
+  if (n > GUI_RO_MAX_CELLS) n = GUI_RO_MAX_CELLS;
+  for (i=0; i<n; i++) {
+    if (gui_ro_cells[i] == 0) break;   // Cells fill from index 0 so the rest are blank
+    gui_readout_cell_area(i, &a);
+    if (_lv_area_intersect(&t, &a, clip_area)) {
+      txt[0] = gui_ro_cells[i];
+      lv_draw_label(&a, clip_area, &dsc, txt, NULL);
+    }
+  }
+
+  return LV_DESIGN_RES_OK;
 }
 
 
@@ -310,6 +456,12 @@ void gui_cb_num_bits(lv_obj_t* obj, lv_event_t event)
       case 6:
         calc_set_bits(56);
         break;
+      case 8:
+        calc_set_bits(128);
+        break;
+      case 9:
+        calc_set_bits(256);
+        break;
       default:
         calc_set_bits(64);
     }
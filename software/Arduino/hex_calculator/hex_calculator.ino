@@ -5,17 +5,23 @@
  * I want...).
  * 
  * A drop-down menu allows selecting the number of bits to work with (8-64 bits
- * in 8-bit increments).  A switch selects decimal or hexadecimal operation.eSPI ported to gCore
+ * in 8-bit increments, 128 or 256 bits).  A switch selects decimal or hexadecimal 
+ * operation.  The arithmetic in calc_num.cpp supports up to 512 bits but numbers that
+ * wide don't fit in the readout.
  * 
  * This code configures the display to operate in Landscape mode.  The lv_conf.h file
  * in the LVGL library directory must be configured to match
  *   #define LV_HOR_RES_MAX          (480)
  *   #define LV_VER_RES_MAX          (320)
+ * and enable the readout fonts
+ *   #define LV_FONT_MONTSERRAT_14    1
+ *   #define LV_FONT_MONTSERRAT_28    1
  *
  */
-#include "SPI.h"
+#include "driver/spi_master.h"
 #include <Ticker.h>
 #include <lvgl.h>
+#include "calc_num.h"
 
 
 
@@ -32,6 +38,13 @@
 // Low battery warning voltage - must be higher than GCORE_LOW_BATT (which turns us off)
 #define APP_LOW_BATT 3.6
 
+// Set to 1 to send display updates using background DMA with two LVGL draw buffers,
+// 0 to wait for each update to be sent using one draw buffer
+#define TFT_DMA_ENABLE 1
+
+// Set to 1 to print the display refresh rate every second (for comparing display modes)
+#define APP_REPORT_FPS 0
+
 
 
 // ================================================
@@ -50,6 +63,8 @@
 
 #define SD_CS      14
 
+#define GCORE_SPI_HOST VSPI_HOST
+
 
 
 // ------------------------------------------------
@@ -57,7 +72,8 @@
 
 // LVGL
 lv_disp_buf_t disp_buf;
-lv_color_t buf[LV_HOR_RES_MAX * 10];
+lv_color_t buf1[LV_HOR_RES_MAX * 10];
+lv_color_t buf2[LV_HOR_RES_MAX * 10];
 
 const int screenWidth = 480;
 const int screenHeight = 320;
@@ -65,6 +81,7 @@ const int screenHeight = 320;
 // Application evaluation timers
 unsigned long gcore_prev_msec;
 unsigned long lvgl_prev_msec;
+unsigned long fps_prev_msec;
 unsigned long app_inactivity_count;
 
 // Low battery flag - set the first time a low-battery condition is detected
@@ -81,6 +98,27 @@ void note_activity()
 }
 
 
+void configure_shared_spi_bus()
+{
+  spi_bus_config_t buscfg;
+
+  memset(&buscfg, 0, sizeof(buscfg));
+  buscfg.miso_io_num = SPI_MISO;
+  buscfg.mosi_io_num = SPI_MOSI;
+  buscfg.sclk_io_num = SPI_SCK;
+  buscfg.quadwp_io_num = -1;
+  buscfg.quadhd_io_num = -1;
+  buscfg.max_transfer_sz = LV_HOR_RES_MAX * 10 * 2;
+
+  esp_err_t ret = spi_bus_initialize(GCORE_SPI_HOST, &buscfg, 1);
+  assert(ret == ESP_OK);
+
+  // SPI Devices
+  tft_add_device(GCORE_SPI_HOST);
+  ts_add_device(GCORE_SPI_HOST);
+}
+
+
 bool task_timeout(unsigned long* prevT, unsigned long timeout)
 {
   unsigned long curT = millis();
@@ -119,7 +157,7 @@ void setup()
   digitalWrite(SD_CS, HIGH);
 
   // SPI setup here since it's used by both the LCD and Touchpad
-  SPI.begin(SPI_SCK, SPI_MISO, SPI_MOSI);
+  configure_shared_spi_bus();
 
   // Setup LVGL
   lvgl_setup();
@@ -133,6 +171,7 @@ void setup()
   // Finally start the app
   gcore_prev_msec = millis();
   lvgl_prev_msec = gcore_prev_msec;
+  fps_prev_msec = gcore_prev_msec;
   app_inactivity_count = 0;
 }
 
@@ -164,6 +203,12 @@ void loop()
     }
   }
 
+#if APP_REPORT_FPS == 1
+  if (task_timeout(&fps_prev_msec, 1000)) {
+    Serial.printf("FPS: %d\n", tft_get_refresh_count());
+  }
+#endif
+
   if (!low_batt_flag) {
     if (gcore_get_batt_voltage() < APP_LOW_BATT) {
       low_batt_flag = true;
@@ -6,8 +6,13 @@ void lvgl_setup()
 {
   lv_init();
 
-  // LVGL display drawing buffer allocation
-  lv_disp_buf_init(&disp_buf, buf, NULL, LV_HOR_RES_MAX * 10);
+  // LVGL display drawing buffer allocation - LVGL renders into one buffer while the
+  // other is being sent to the display
+#if TFT_DMA_ENABLE == 1
+  lv_disp_buf_init(&disp_buf, buf1, buf2, LV_HOR_RES_MAX * 10);
+#else
+  lv_disp_buf_init(&disp_buf, buf1, NULL, LV_HOR_RES_MAX * 10);
+#endif
 
   // Initialize the TFT driver
   tft_begin();
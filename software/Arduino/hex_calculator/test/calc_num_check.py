@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+#
+# Checks calc_num_test test vectors using Python integers as the reference bignum
+#
+#   ./calc_num_test | python3 calc_num_check.py
+#
+# Each line is "<op> <bits> <operands...> <results...>" with numbers in hex (see
+# calc_num_test.cpp).  Prints the first mismatches and a per operation summary, exits
+# with status 1 on any mismatch.
+#
+import sys
+
+
+def check(op, bits, f):
+    mask = (1 << bits) - 1
+    h = lambda i: int(f[i], 16)
+
+    if op in ("add", "sub", "mul", "and", "or", "xor"):
+        a, b, r = h(0), h(1), h(2)
+        ref = {"add": a + b, "sub": a - b, "mul": a * b, "and": a & b, "or": a | b, "xor": a ^ b}[op]
+        return r == ref & mask
+    if op == "div":
+        a, b, q, r = h(0), h(1), h(2), h(3)
+        if b == 0:
+            return q == 0 and r == 0
+        return q == a // b and r == a % b
+    if op == "cmp":
+        a, b, c = h(0), h(1), int(f[2])
+        return c == (a > b) - (a < b)
+    if op in ("not", "neg", "swap", "rol", "ror"):
+        n, a, r = h(0), h(1), h(2)
+        if op == "not":
+            return r == ~a & mask
+        if op == "neg":
+            return r == -a & mask
+        if op == "swap":
+            return r == int.from_bytes(a.to_bytes(bits // 8, "little"), "big")
+        n %= bits
+        if op == "ror":
+            n = (bits - n) % bits
+        return r == ((a << n) | (a >> (bits - n))) & mask
+    if op in ("shl", "shr"):
+        a, n, r = h(0), h(1), h(2)
+        if n >= bits:
+            return r == 0
+        return r == ((a << n) & mask if op == "shl" else a >> n)
+    if op == "muladd":
+        m, u, a, r, ovf = h(0), h(1), h(2), h(3), int(f[4])
+        t = a * m + u
+        return r == t & mask and ovf == (t >> bits != 0)
+    if op == "divu":
+        d, a, q, r = h(0), h(1), h(2), h(3)
+        return q == a // d and r == a % d
+    if op == "dec":
+        return f[1] == str(h(0))
+    if op == "hex":
+        return f[1] == "%X" % h(0)
+    raise ValueError("unknown operation " + op)
+
+
+def main():
+    total = {}
+    failed = {}
+    for line in sys.stdin:
+        f = line.split()
+        if not f:
+            continue
+        op, bits = f[0], int(f[1])
+        total[op] = total.get(op, 0) + 1
+        try:
+            ok = check(op, bits, f[2:])
+        except OverflowError:
+            ok = False                        # value wider than the width
+        if not ok:
+            failed[op] = failed.get(op, 0) + 1
+            if sum(failed.values()) <= 10:
+                print("FAIL: " + line.strip())
+
+    for op in sorted(total):
+        print("%-7s %7d checked, %d failed" % (op, total[op], failed.get(op, 0)))
+    print("FAILED" if failed else "PASSED")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,328 @@
+/*
+ * Host test and benchmark for calc_num (the calculator fixed-width integer core)
+ *
+ *   calc_num_test [count]  - print test vectors, one operation per line:
+ *                              <op> <bits> <operands...> <results...>
+ *                            numbers in hex, checked by calc_num_check.py with Python
+ *                            integers as the reference bignum
+ *   calc_num_test bench    - time multiply, divide, conversion and rotate at each width
+ *                            against a bit-serial reference (shift/add and restoring division)
+ *
+ * Build (from this directory, the test directory is ignored by the Arduino IDE):
+ *   g++ -O2 -Wall -I.. ../calc_num.cpp calc_num_test.cpp -o calc_num_test
+ *   ./calc_num_test | python3 calc_num_check.py
+ *   ./calc_num_test bench
+ */
+#include "calc_num.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+// ================================================================================
+// Operand generation
+// ================================================================================
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t rng()
+{
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (uint32_t) ((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+
+// Limbs that exercise carries, borrows and the quotient estimate of Algorithm D
+static uint32_t rand_limb()
+{
+  static const uint32_t special[] = { 0, 1, 2, 0x7FFFFFFF, 0x80000000, 0x80000001, 0xFFFFFFFE, 0xFFFFFFFF };
+
+  if ((rng() % 3) == 0) return special[rng() % (sizeof(special) / sizeof(special[0]))];
+  return rng();
+}
+
+
+// Random number of a random length (so divisions see all divisor sizes), masked to the width
+static void rand_num(calc_num_t* a, int bits)
+{
+  int i;
+  int nl = (bits + 31) / 32;
+  int used = 1 + rng() % nl;
+
+  calc_num_zero(a);
+  for (i=0; i<used; i++) {
+    a->v[i] = rand_limb();
+  }
+  if ((rng() % 8) == 0) {
+    // Single bit
+    calc_num_zero(a);
+    a->v[(rng() % bits) / 32] = 1UL << (rng() % 32);
+  }
+  calc_num_mask(a, bits);
+}
+
+
+
+// ================================================================================
+// Test vectors
+// ================================================================================
+
+static void print_num(const calc_num_t* a, int bits)
+{
+  int i;
+
+  printf(" ");
+  for (i=(bits+31)/32-1; i>=0; i--) {
+    printf("%08X", (unsigned) a->v[i]);
+  }
+}
+
+
+static void print_binary(const char* op, int bits, const calc_num_t* a, const calc_num_t* b, const calc_num_t* r)
+{
+  printf("%s %d", op, bits);
+  print_num(a, bits);
+  print_num(b, bits);
+  print_num(r, bits);
+  printf("\n");
+}
+
+
+static void print_unary(const char* op, int bits, int n, const calc_num_t* a, const calc_num_t* r)
+{
+  printf("%s %d %X", op, bits, n);
+  print_num(a, bits);
+  print_num(r, bits);
+  printf("\n");
+}
+
+
+static void vectors(int count)
+{
+  static const int widths[] = { 8, 16, 24, 32, 33, 48, 64, 96, 100, 128, 192, 256, 384, 511, 512 };
+  calc_num_t a, b, r, q, rem;
+  char s[CALC_NUM_STR_LEN];
+  int i, w, bits, n;
+  uint32_t u, m;
+  bool ovf;
+
+  for (w=0; w<(int) (sizeof(widths) / sizeof(widths[0])); w++) {
+    bits = widths[w];
+    for (i=0; i<count; i++) {
+      rand_num(&a, bits);
+      rand_num(&b, bits);
+
+      calc_num_add(&r, &a, &b, bits);
+      print_binary("add", bits, &a, &b, &r);
+      calc_num_sub(&r, &a, &b, bits);
+      print_binary("sub", bits, &a, &b, &r);
+      calc_num_mul(&r, &a, &b, bits);
+      print_binary("mul", bits, &a, &b, &r);
+      r = a;
+      calc_num_mul(&r, &r, &r, bits);          // result aliasing the operands
+      print_binary("mul", bits, &a, &a, &r);
+
+      calc_num_div(&q, &rem, &a, &b, bits);
+      printf("div %d", bits);
+      print_num(&a, bits);
+      print_num(&b, bits);
+      print_num(&q, bits);
+      print_num(&rem, bits);
+      printf("\n");
+
+      calc_num_and(&r, &a, &b, bits);
+      print_binary("and", bits, &a, &b, &r);
+      calc_num_or(&r, &a, &b, bits);
+      print_binary("or", bits, &a, &b, &r);
+      calc_num_xor(&r, &a, &b, bits);
+      print_binary("xor", bits, &a, &b, &r);
+      printf("cmp %d", bits);
+      print_num(&a, bits);
+      print_num(&b, bits);
+      printf(" %d\n", calc_num_cmp(&a, &b, bits));
+
+      r = a;
+      calc_num_not(&r, bits);
+      print_unary("not", bits, 0, &a, &r);
+      r = a;
+      calc_num_neg(&r, bits);
+      print_unary("neg", bits, 0, &a, &r);
+      if ((bits % 8) == 0) {
+        r = a;
+        calc_num_swap_endian(&r, bits);
+        print_unary("swap", bits, 0, &a, &r);
+      }
+
+      // Shift counts around the limb boundaries and past the width
+      n = (rng() % 4) ? (int) (rng() % (bits + 1)) : (int) (rng() % (2 * bits + 40));
+      calc_num_set_u32(&b, n);
+      if ((rng() % 16) == 0) b.v[(bits - 1) / 32] |= 1UL << ((bits - 1) % 32);  // huge count
+      calc_num_mask(&b, bits);
+      r = a;
+      calc_num_shl(&r, &b, bits);
+      print_binary("shl", bits, &a, &b, &r);
+      r = a;
+      calc_num_shr(&r, &b, bits);
+      print_binary("shr", bits, &a, &b, &r);
+      r = a;
+      calc_num_rol(&r, n, bits);
+      print_unary("rol", bits, n, &a, &r);
+      r = a;
+      calc_num_ror(&r, n, bits);
+      print_unary("ror", bits, n, &a, &r);
+
+      // Digit entry and removal
+      m = (rng() % 2) ? 10 : 16;
+      u = rng() % m;
+      r = a;
+      ovf = calc_num_mul_add_u32(&r, m, u, bits);
+      printf("muladd %d %X %X", bits, (unsigned) m, (unsigned) u);
+      print_num(&a, bits);
+      print_num(&r, bits);
+      printf(" %d\n", ovf ? 1 : 0);
+      u = (rng() % 2) ? m : (rng() | 1);
+      r = a;
+      m = calc_num_div_u32(&r, u, bits);
+      printf("divu %d %X", bits, (unsigned) u);
+      print_num(&a, bits);
+      print_num(&r, bits);
+      printf(" %X\n", (unsigned) m);
+
+      calc_num_to_str(&a, bits, false, s);
+      printf("dec %d", bits);
+      print_num(&a, bits);
+      printf(" %s\n", s);
+      calc_num_to_str(&a, bits, true, s);
+      printf("hex %d", bits);
+      print_num(&a, bits);
+      printf(" %s\n", s);
+    }
+  }
+}
+
+
+
+// ================================================================================
+// Benchmark
+// ================================================================================
+
+// Bit-serial reference: a * b by shift and add, truncated to the width
+static void ref_mul(calc_num_t* r, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  calc_num_t p, t;
+  int i;
+
+  calc_num_zero(&p);
+  t = *a;
+  for (i=0; i<bits; i++) {
+    if (calc_num_get_bit(b, i)) calc_num_add(&p, &p, &t, bits);
+    calc_num_shl_n(&t, 1, bits);
+  }
+  *r = p;
+}
+
+
+// Bit-serial reference: restoring division (the bit shifted out of the partial remainder is its carry)
+static void ref_div(calc_num_t* q, calc_num_t* rem, const calc_num_t* a, const calc_num_t* b, int bits)
+{
+  calc_num_t tq, tr;
+  bool carry;
+  int i;
+
+  calc_num_zero(&tq);
+  calc_num_zero(&tr);
+  for (i=bits-1; i>=0; i--) {
+    carry = calc_num_get_bit(&tr, bits - 1);
+    calc_num_shl_n(&tr, 1, bits);
+    tr.v[0] |= calc_num_get_bit(a, i) ? 1 : 0;
+    if (carry || (calc_num_cmp(&tr, b, bits) >= 0)) {
+      calc_num_sub(&tr, &tr, b, bits);
+      tq.v[i / 32] |= 1UL << (i % 32);
+    }
+  }
+  *q = tq;
+  *rem = tr;
+}
+
+
+static double now_ns()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+#define BENCH_OPERANDS 64
+
+// Full width operands, divisors of half the width (the common "big / smaller" case)
+static void bench_operands(calc_num_t* a, calc_num_t* b, int bits)
+{
+  int i, j;
+
+  for (i=0; i<BENCH_OPERANDS; i++) {
+    calc_num_zero(&a[i]);
+    calc_num_zero(&b[i]);
+    for (j=0; j<(bits+31)/32; j++) {
+      a[i].v[j] = rng();
+      if (j < ((bits+31)/32 + 1) / 2) b[i].v[j] = rng();
+    }
+    b[i].v[0] |= 1;
+    calc_num_mask(&a[i], bits);
+    calc_num_mask(&b[i], bits);
+  }
+}
+
+
+static volatile uint32_t bench_sink;
+
+#define BENCH(label, iters, expr) do {                              \
+    double t0 = now_ns();                                           \
+    for (int k_=0; k_<(iters); k_++) {                              \
+      int i_ = k_ % BENCH_OPERANDS;                                 \
+      expr;                                                         \
+      bench_sink += r.v[0];                                         \
+    }                                                               \
+    printf("  %-10s %10.1f ns\n", label, (now_ns() - t0) / (iters)); \
+  } while (0)
+
+
+static void bench()
+{
+  static const int widths[] = { 64, 128, 256, 512 };
+  static calc_num_t a[BENCH_OPERANDS], b[BENCH_OPERANDS];
+  calc_num_t r, rem;
+  char s[CALC_NUM_STR_LEN];
+  int w, bits, iters;
+
+  for (w=0; w<(int) (sizeof(widths) / sizeof(widths[0])); w++) {
+    bits = widths[w];
+    bench_operands(a, b, bits);
+    iters = 2000000 / bits;
+    printf("%d bits:\n", bits);
+    BENCH("mul", iters * 20, calc_num_mul(&r, &a[i_], &b[i_], bits));
+    BENCH("ref mul", iters, ref_mul(&r, &a[i_], &b[i_], bits));
+    BENCH("div", iters * 20, calc_num_div(&r, &rem, &a[i_], &b[i_], bits));
+    BENCH("ref div", iters, ref_div(&r, &rem, &a[i_], &b[i_], bits));
+    BENCH("to dec", iters * 4, (calc_num_to_str(&a[i_], bits, false, s), r.v[0] = s[0]));
+    BENCH("rol", iters * 20, (r = a[i_], calc_num_rol(&r, 37, bits)));
+  }
+}
+
+
+
+int main(int argc, char** argv)
+{
+  if ((argc > 1) && (strcmp(argv[1], "bench") == 0)) {
+    bench();
+  } else {
+    vectors((argc > 1) ? atoi(argv[1]) : 2000);
+  }
+  return 0;
+}
@@ -1,9 +1,16 @@
 /*
- * HX8357 LCD driver for littlevgl using SPI.
+ * HX8357 LCD driver for littlevgl using the ESP32 SPI master driver.
+ * 
+ * Display updates are queued as DMA transactions so LVGL can render into its second
+ * draw buffer while the first is being sent.  lv_disp_flush_ready() is called from the
+ * post-transaction callback when the pixel data has been sent.
  * 
  * Initialization commands based on the Adafruit driver
  * 
  */
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+
 // ==================================================
 // Constants
 //
@@ -25,7 +32,16 @@ const int tft_dc_pin =  33;
 //
 // Display SPI settings
 //
-#define TFT_SPI_SETTINGS SPISettings(26000000, MSBFIRST, SPI_MODE0)
+#define TFT_SPI_FREQ     26000000
+
+// Transaction pool size (also the device queue depth) - large enough for a complete
+// flush (CASET, data, PASET, data, RAMWR, colors)
+#define TFT_MAX_TRANS    6
+
+// Transaction types (stored in the transaction user field)
+#define TFT_TRANS_CMD    0
+#define TFT_TRANS_DATA   1
+#define TFT_TRANS_COLORS 2
 
 
 //
@@ -217,6 +233,32 @@ static const uint8_t
 
 
 
+// ==================================================
+// Variables
+//
+spi_device_handle_t tft_spi;
+
+// Pool of transactions queued to the SPI driver.  Commands and data are queued
+// without waiting so a group of commands is sent back-to-back.  Results are collected
+// (in order) when the pool fills or the caller needs everything sent.
+spi_transaction_t tft_trans[TFT_MAX_TRANS];
+int tft_trans_queued = 0;
+
+// Current display address window (-1 = unknown) so unchanged CASET/PASET commands
+// can be skipped.  LVGL usually flushes full-width stripes so only the rows change.
+int16_t tft_win_x1 = -1;
+int16_t tft_win_x2 = -1;
+int16_t tft_win_y1 = -1;
+int16_t tft_win_y2 = -1;
+
+// Display being flushed, passed to lv_disp_flush_ready() from the post-transaction callback
+lv_disp_drv_t* tft_flush_disp = NULL;
+
+// Refresh counter for performance measurements
+volatile uint32_t tft_refresh_count = 0;
+
+
+
 // ==================================================
 // littlevgl integration
 //
@@ -227,10 +269,22 @@ void disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_ar
 
   w = (int16_t) (area->x2 - area->x1 + 1);
   h = (int16_t) (area->y2 - area->y1 + 1);
+
+  if (lv_disp_flush_is_last(disp)) {
+    tft_refresh_count++;
+  }
+
+#if TFT_DMA_ENABLE == 1
+  // lv_disp_flush_ready() will be called from _tft_spi_post_cb when the colors are sent
+  tft_flush_disp = disp;
+  tft_writeRect((int16_t) area->x1, (int16_t) area->y1, w, h, (const uint16_t*) color_array);
+#else
   tft_writeRect((int16_t) area->x1, (int16_t) area->y1, w, h, (const uint16_t*) color_array);
+  tft_wait_done();
 
   /*Tell the flushing is ready*/
   lv_disp_flush_ready(disp);
+#endif
 }
 
 
@@ -238,15 +292,34 @@ void disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_ar
 // ==================================================
 // API Code
 //
+
+// Call after the SPI bus has been initialized
+void tft_add_device(spi_host_device_t host)
+{
+  spi_device_interface_config_t devcfg;
+
+  memset(&devcfg, 0, sizeof(devcfg));
+  devcfg.clock_speed_hz = TFT_SPI_FREQ;
+  devcfg.mode = 0;
+  devcfg.spics_io_num = tft_cs_pin;
+  devcfg.queue_size = TFT_MAX_TRANS;
+  devcfg.pre_cb = _tft_spi_pre_cb;
+  devcfg.post_cb = _tft_spi_post_cb;
+  devcfg.flags = SPI_DEVICE_HALFDUPLEX;
+
+  esp_err_t ret = spi_bus_add_device(host, &devcfg, &tft_spi);
+  assert(ret == ESP_OK);
+}
+
+
 void tft_begin()
 {
   // Initialize the hardware
-  pinMode(tft_cs_pin, OUTPUT);
-  digitalWrite(tft_cs_pin, HIGH);
   pinMode(tft_dc_pin, OUTPUT);
   digitalWrite(tft_dc_pin, HIGH);  // "Data" is default
 
-  // Send the initialization commands
+  // Send the initialization commands - each group of commands between delays is queued
+  // to the SPI driver back-to-back
   const uint8_t *addr = (DEFAULT_TFT == HX8357B) ? initb : initd;
   uint8_t        cmd, x, numArgs;
   while((cmd = *addr++) > 0) { // '0' command ends list
@@ -262,102 +335,167 @@ void tft_begin()
       }
     }
     if (x & 0x80) {       // If high bit set...
+      tft_wait_done();    // Make sure the command has been sent before starting the delay
       vTaskDelay(numArgs * 5 / portTICK_RATE_MS); // numArgs is actually a delay time (5ms units)
     }
   }
 
   tft_setRotation(1);
+  tft_wait_done();
   //tft_send_cmd(HX8357_INVON);
 }
 
 
+// Returns the number of complete screen refreshes since the last call
+uint32_t tft_get_refresh_count()
+{
+  uint32_t n = tft_refresh_count;
+
+  tft_refresh_count = 0;
+  return n;
+}
+
+
 
 // ==================================================
 // Internal Module Code
 //
 void tft_setRotation(uint8_t m)
 {
+  uint8_t r;
+  
   m = m % 4; // can't be higher than 3
   
-  SPI.beginTransaction(TFT_SPI_SETTINGS);
-  digitalWrite(tft_dc_pin, LOW);
-  digitalWrite(tft_cs_pin, LOW);
-  SPI.transfer(HX8357_MADCTL);
-  digitalWrite(tft_dc_pin, HIGH);
-
   switch (m) {
     case 0:
-      SPI.transfer(MADCTL_MX | MADCTL_BGR);
+      r = MADCTL_MX | MADCTL_BGR;
       break;
     case 1:
-      SPI.transfer(MADCTL_MV | MADCTL_BGR);
+      r = MADCTL_MV | MADCTL_BGR;
       break;
     case 2:
-      SPI.transfer(MADCTL_MY | MADCTL_BGR);
+      r = MADCTL_MY | MADCTL_BGR;
       break;
     default: // case 3:
-      SPI.transfer(MADCTL_MX | MADCTL_MY | MADCTL_MV | MADCTL_BGR);
+      r = MADCTL_MX | MADCTL_MY | MADCTL_MV | MADCTL_BGR;
       break;
   }
-  digitalWrite(tft_cs_pin, HIGH);
-  SPI.endTransaction();
+
+  tft_send_cmd(HX8357_MADCTL);
+  tft_send_data(&r, 1);
+
+  // The address window is interpreted differently after a rotation
+  tft_win_x1 = -1;
+  tft_win_y1 = -1;
 }
 
 
+// Queue the transactions to write a rectangle.  They complete in the background and
+// the last one calls lv_disp_flush_ready() (TFT_DMA_ENABLE) so pcolors must remain
+// valid until then.
 void tft_writeRect(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *pcolors)
 {
-  SPI.beginTransaction(TFT_SPI_SETTINGS);
-  digitalWrite(tft_cs_pin, LOW);
+  uint8_t b[4];
+  int16_t x2 = x + w - 1;
+  int16_t y2 = y + h - 1;
   
+  // Collect the results of the previous flush (already complete since LVGL waited for it)
+  // so the whole flush fits in the transaction pool
+  tft_wait_done();
+
   // Set addr
-  digitalWrite(tft_dc_pin, LOW);
-  SPI.transfer(HX8357_CASET); // Column addr set
-  digitalWrite(tft_dc_pin, HIGH);
-  SPI.transfer16(x);   // XSTART
-  SPI.transfer16(x+w-1);   // XEND
-  
-  digitalWrite(tft_dc_pin, LOW);
-  SPI.transfer(HX8357_PASET); // Row addr set
-  digitalWrite(tft_dc_pin, HIGH);
-  SPI.transfer16(y);   // YSTART
-  SPI.transfer16(y+h-1);   // YEND
+  if ((x != tft_win_x1) || (x2 != tft_win_x2)) {
+    b[0] = x >> 8;    // XSTART
+    b[1] = x & 0xFF;
+    b[2] = x2 >> 8;   // XEND
+    b[3] = x2 & 0xFF;
+    tft_send_cmd(HX8357_CASET); // Column addr set
+    tft_send_data(b, 4);
+    tft_win_x1 = x;
+    tft_win_x2 = x2;
+  }
+
+  if ((y != tft_win_y1) || (y2 != tft_win_y2)) {
+    b[0] = y >> 8;    // YSTART
+    b[1] = y & 0xFF;
+    b[2] = y2 >> 8;   // YEND
+    b[3] = y2 & 0xFF;
+    tft_send_cmd(HX8357_PASET); // Row addr set
+    tft_send_data(b, 4);
+    tft_win_y1 = y;
+    tft_win_y2 = y2;
+  }
 
   // Load RAM
-  digitalWrite(tft_dc_pin, LOW);
-  SPI.transfer(HX8357_RAMWR);
-  digitalWrite(tft_dc_pin, HIGH);
-  /*
-  for(y=h; y>0; y--) {
-    for(x=w; x>0; x--) {
-      SPI.transfer16(*pcolors++);
-    }
+  tft_send_cmd(HX8357_RAMWR);
+  _tft_queue(TFT_TRANS_COLORS, (const uint8_t*) pcolors, w*h*2);
+}
+
+
+// Wait for all queued transactions to complete
+void tft_wait_done()
+{
+  spi_transaction_t* rtrans;
+  
+  while (tft_trans_queued) {
+    spi_device_get_trans_result(tft_spi, &rtrans, portMAX_DELAY);
+    tft_trans_queued--;
   }
-  */
-  SPI.writeBytes((const uint8_t*) pcolors, w*h*2);
-  digitalWrite(tft_cs_pin, HIGH);
-  SPI.endTransaction();
 }
 
 
+// Queue a command byte
 void tft_send_cmd(uint8_t cmd)
 {
-  SPI.beginTransaction(TFT_SPI_SETTINGS);
-  digitalWrite(tft_dc_pin, LOW);
-  digitalWrite(tft_cs_pin, LOW);
-  SPI.transfer(cmd);
-  digitalWrite(tft_cs_pin, HIGH);
-  SPI.endTransaction();  
+  _tft_queue(TFT_TRANS_CMD, &cmd, 1);
 }
 
 
+// Queue data.  Up to 4 bytes are copied, longer data must remain valid until sent.
 void tft_send_data(const uint8_t* data, uint16_t length)
 {
-  SPI.beginTransaction(TFT_SPI_SETTINGS);
-  digitalWrite(tft_dc_pin, HIGH);
-  digitalWrite(tft_cs_pin, LOW);
-  while (length--) {
-    SPI.transfer(*data++);
+  _tft_queue(TFT_TRANS_DATA, data, length);
+}
+
+
+void _tft_queue(int type, const uint8_t* data, uint32_t length)
+{
+  spi_transaction_t* t;
+  
+  if (length == 0) return;
+
+  if (tft_trans_queued == TFT_MAX_TRANS) {
+    tft_wait_done();
+  }
+  t = &tft_trans[tft_trans_queued];
+
+  memset(t, 0, sizeof(spi_transaction_t));
+  t->length = length * 8;
+  t->user = (void*) type;
+  if (length <= 4) {
+    t->flags = SPI_TRANS_USE_TXDATA;
+    memcpy(t->tx_data, data, length);
+  } else {
+    t->tx_buffer = data;
+  }
+
+  spi_device_queue_trans(tft_spi, t, portMAX_DELAY);
+  tft_trans_queued++;
+}
+
+
+// Set DC before each transaction starts
+void IRAM_ATTR _tft_spi_pre_cb(spi_transaction_t *t)
+{
+  gpio_set_level((gpio_num_t) tft_dc_pin, ((int) t->user == TFT_TRANS_CMD) ? 0 : 1);
+}
+
+
+// Tell LVGL the draw buffer is free once the colors have been sent
+void IRAM_ATTR _tft_spi_post_cb(spi_transaction_t *t)
+{
+  if (((int) t->user == TFT_TRANS_COLORS) && (tft_flush_disp != NULL)) {
+    lv_disp_flush_ready(tft_flush_disp);
+    tft_flush_disp = NULL;
   }
-  digitalWrite(tft_cs_pin, HIGH);
-  SPI.endTransaction();
 }
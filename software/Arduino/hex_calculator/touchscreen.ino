@@ -1,5 +1,8 @@
 /*
- * STMPE610 Resistive Touchscreen driver for SPI
+ * STMPE610 Resistive Touchscreen driver for the ESP32 SPI master driver.
+ * 
+ * Shares the SPI bus with the display.  Transactions are queued behind any display
+ * DMA transactions in progress.
  * 
  */
 
@@ -161,7 +164,14 @@ const int ts_cs_pin = 32;
 //
 // Touchscreen SPI parameters
 //
-#define TS_SPI_SETTINGS SPISettings(1000000, MSBFIRST, SPI_MODE1)
+#define TS_SPI_FREQ 1000000
+
+
+
+// ==================================================
+// Variables
+//
+spi_device_handle_t ts_spi;
 
 
 
@@ -230,12 +240,25 @@ bool tp_read(lv_indev_drv_t * indev_driver, lv_indev_data_t *data)
 // ==================================================
 // API Code
 //
-void ts_begin()
+
+// Call after the SPI bus has been initialized
+void ts_add_device(spi_host_device_t host)
 {
-  // Initialize the hardware
-  pinMode(ts_cs_pin, OUTPUT);
-  digitalWrite(ts_cs_pin, HIGH);
+  spi_device_interface_config_t devcfg;
+
+  memset(&devcfg, 0, sizeof(devcfg));
+  devcfg.clock_speed_hz = TS_SPI_FREQ;
+  devcfg.mode = 1;
+  devcfg.spics_io_num = ts_cs_pin;
+  devcfg.queue_size = 1;
+
+  esp_err_t ret = spi_bus_add_device(host, &devcfg, &ts_spi);
+  assert(ret == ESP_OK);
+}
 
+
+void ts_begin()
+{
   stmpe610_init();
 }
 
@@ -301,44 +324,45 @@ void stmpe610_init(void)
 
 void _ts_write_8bit_reg(uint8_t reg, uint8_t val)
 {
-  SPI.beginTransaction(TS_SPI_SETTINGS);
-  digitalWrite(ts_cs_pin, LOW);
-  SPI.transfer(reg);
-  SPI.transfer(val);
-  digitalWrite(ts_cs_pin, HIGH);
-  SPI.endTransaction(); 
+  uint8_t data_send[2] = {reg, val};
+  
+  _ts_xchg(data_send, NULL, 2);
 }
 
 
 uint16_t _ts_read_16bit_reg(uint8_t reg)
 {
-  uint8_t data_recv[2];
+  uint8_t data_send[3] = {(uint8_t) (0x80 | reg), (uint8_t) (0x80 | (reg+1)), 0};
+  uint8_t data_recv[3];
   
-  SPI.beginTransaction(TS_SPI_SETTINGS);
-  digitalWrite(ts_cs_pin, LOW);
-  SPI.transfer(0x80 | reg); // Read
-  data_recv[0] = SPI.transfer(0x80 | (reg+1));
-  data_recv[1] = SPI.transfer(0);
-  digitalWrite(ts_cs_pin, HIGH);
-  SPI.endTransaction(); 
+  _ts_xchg(data_send, data_recv, 3);
   
-  return data_recv[0] << 8 | data_recv[1];
+  return data_recv[1] << 8 | data_recv[2];
 }
 
 
 uint8_t _ts_read_8bit_reg(uint8_t reg)
 { 
-  uint8_t data_recv;
+  uint8_t data_send[3] = {(uint8_t) (0x80 | reg), 0, 0};
+  uint8_t data_recv[3];
+  
+  _ts_xchg(data_send, data_recv, 3);
   
-  SPI.beginTransaction(TS_SPI_SETTINGS);
-  digitalWrite(ts_cs_pin, LOW);
-  SPI.transfer(0x80 | reg); // Read
-  SPI.transfer(0);
-  data_recv = SPI.transfer(0);
-  digitalWrite(ts_cs_pin, HIGH);
-  SPI.endTransaction(); 
+  return data_recv[2];
+}
+
+
+void _ts_xchg(uint8_t* data_send, uint8_t* data_recv, uint8_t byte_count)
+{
+  spi_transaction_t t;
+
+  memset(&t, 0, sizeof(t));
+  t.length = byte_count * 8; // SPI transaction length is in bits
+  t.tx_buffer = data_send;
+  t.rx_buffer = data_recv;
   
-  return data_recv;
+  esp_err_t ret = spi_device_transmit(ts_spi, &t);
+  assert(ret == ESP_OK);
 }
 
 
@@ -235,6 +235,19 @@ void littlevgl_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t
 
 
 
+// ==================================================
+// Variables
+//
+
+// Current display address window (-1 = unknown) so unchanged CASET/PASET commands
+// can be skipped.  LittlevGL usually flushes full-width stripes so only the rows change.
+int16_t tft_win_x1 = -1;
+int16_t tft_win_x2 = -1;
+int16_t tft_win_y1 = -1;
+int16_t tft_win_y2 = -1;
+
+
+
 // ==================================================
 // API Code
 //
@@ -246,18 +259,19 @@ void tft_begin()
   pinMode(tft_dc_pin, OUTPUT);
   digitalWrite(tft_dc_pin, HIGH);  // "Data" is default
 
-  // Send the initialization commands
+  // Send the initialization commands in one transaction
   const uint8_t *addr = (DEFAULT_TFT == HX8357B) ? initb : initd;
   uint8_t        cmd, x, numArgs;
+  _tft_begin_window();
   while((cmd = *addr++) > 0) { // '0' command ends list
     x = *addr++;
     numArgs = x & 0x7F;
     if (cmd != 0xFF) { // '255' is ignored
       if (x & 0x80) {  // If high bit set, numArgs is a delay time
-        tft_send_cmd(cmd);
+        _tft_write_cmd(cmd);
       } else {
-        tft_send_cmd(cmd);
-        tft_send_data(addr, numArgs);
+        _tft_write_cmd(cmd);
+        _tft_write_data(addr, numArgs);
         addr += numArgs;
       }
     }
@@ -265,6 +279,7 @@ void tft_begin()
       vTaskDelay(numArgs * 5 / portTICK_RATE_MS); // numArgs is actually a delay time (5ms units)
     }
   }
+  _tft_end_window();
 
   tft_setRotation(1);
   //tft_send_cmd(HX8357_INVON);
@@ -277,87 +292,118 @@ void tft_begin()
 //
 void tft_setRotation(uint8_t m)
 {
-  m = m % 4; // can't be higher than 3
+  uint8_t r;
   
-  SPI.beginTransaction(TFT_SPI_SETTINGS);
-  digitalWrite(tft_dc_pin, LOW);
-  digitalWrite(tft_cs_pin, LOW);
-  SPI.transfer(HX8357_MADCTL);
-  digitalWrite(tft_dc_pin, HIGH);
+  m = m % 4; // can't be higher than 3
 
   switch (m) {
     case 0:
-      SPI.transfer(MADCTL_MX | MADCTL_BGR);
+      r = MADCTL_MX | MADCTL_BGR;
       break;
     case 1:
-      SPI.transfer(MADCTL_MV | MADCTL_BGR);
+      r = MADCTL_MV | MADCTL_BGR;
       break;
     case 2:
-      SPI.transfer(MADCTL_MY | MADCTL_BGR);
+      r = MADCTL_MY | MADCTL_BGR;
       break;
     default: // case 3:
-      SPI.transfer(MADCTL_MX | MADCTL_MY | MADCTL_MV | MADCTL_BGR);
+      r = MADCTL_MX | MADCTL_MY | MADCTL_MV | MADCTL_BGR;
       break;
   }
-  digitalWrite(tft_cs_pin, HIGH);
-  SPI.endTransaction();
+  
+  _tft_begin_window();
+  _tft_write_cmd(HX8357_MADCTL);
+  _tft_write_data(&r, 1);
+  _tft_end_window();
+
+  // The address window is interpreted differently after a rotation
+  tft_win_x1 = -1;
+  tft_win_y1 = -1;
 }
 
 
 void tft_writeRect(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *pcolors)
 {
-  SPI.beginTransaction(TFT_SPI_SETTINGS);
-  digitalWrite(tft_cs_pin, LOW);
+  uint8_t b[4];
+  int16_t x2 = x + w - 1;
+  int16_t y2 = y + h - 1;
+
+  _tft_begin_window();
   
   // Set addr
-  digitalWrite(tft_dc_pin, LOW);
-  SPI.transfer(HX8357_CASET); // Column addr set
-  digitalWrite(tft_dc_pin, HIGH);
-  SPI.transfer16(x);   // XSTART
-  SPI.transfer16(x+w-1);   // XEND
-  
-  digitalWrite(tft_dc_pin, LOW);
-  SPI.transfer(HX8357_PASET); // Row addr set
-  digitalWrite(tft_dc_pin, HIGH);
-  SPI.transfer16(y);   // YSTART
-  SPI.transfer16(y+h-1);   // YEND
+  if ((x != tft_win_x1) || (x2 != tft_win_x2)) {
+    b[0] = x >> 8;    // XSTART
+    b[1] = x & 0xFF;
+    b[2] = x2 >> 8;   // XEND
+    b[3] = x2 & 0xFF;
+    _tft_write_cmd(HX8357_CASET); // Column addr set
+    _tft_write_data(b, 4);
+    tft_win_x1 = x;
+    tft_win_x2 = x2;
+  }
 
-  // Load RAM
-  digitalWrite(tft_dc_pin, LOW);
-  SPI.transfer(HX8357_RAMWR);
-  digitalWrite(tft_dc_pin, HIGH);
-  /*
-  for(y=h; y>0; y--) {
-    for(x=w; x>0; x--) {
-      SPI.transfer16(*pcolors++);
-    }
+  if ((y != tft_win_y1) || (y2 != tft_win_y2)) {
+    b[0] = y >> 8;    // YSTART
+    b[1] = y & 0xFF;
+    b[2] = y2 >> 8;   // YEND
+    b[3] = y2 & 0xFF;
+    _tft_write_cmd(HX8357_PASET); // Row addr set
+    _tft_write_data(b, 4);
+    tft_win_y1 = y;
+    tft_win_y2 = y2;
   }
-  */
+
+  // Load RAM
+  _tft_write_cmd(HX8357_RAMWR);
   SPI.writePixels(pcolors, w*h*2);
-  digitalWrite(tft_cs_pin, HIGH);
-  SPI.endTransaction();
+  
+  _tft_end_window();
 }
 
 
 void tft_send_cmd(uint8_t cmd)
 {
-  SPI.beginTransaction(TFT_SPI_SETTINGS);
-  digitalWrite(tft_dc_pin, LOW);
-  digitalWrite(tft_cs_pin, LOW);
-  SPI.transfer(cmd);
-  digitalWrite(tft_cs_pin, HIGH);
-  SPI.endTransaction();  
+  _tft_begin_window();
+  _tft_write_cmd(cmd);
+  _tft_end_window();
 }
 
 
 void tft_send_data(const uint8_t* data, uint16_t length)
+{
+  _tft_begin_window();
+  _tft_write_data(data, length);
+  _tft_end_window();
+}
+
+
+// Start a group of commands and data sharing one SPI transaction and CS assertion
+void _tft_begin_window()
 {
   SPI.beginTransaction(TFT_SPI_SETTINGS);
-  digitalWrite(tft_dc_pin, HIGH);
   digitalWrite(tft_cs_pin, LOW);
-  while (length--) {
-    SPI.transfer(*data++);
-  }
+}
+
+
+void _tft_end_window()
+{
   digitalWrite(tft_cs_pin, HIGH);
   SPI.endTransaction();
 }
+
+
+// Command and data writes - must be inside a _tft_begin_window()/_tft_end_window() pair
+void _tft_write_cmd(uint8_t cmd)
+{
+  digitalWrite(tft_dc_pin, LOW);
+  SPI.write(cmd);
+  digitalWrite(tft_dc_pin, HIGH);  // "Data" is default
+}
+
+
+void _tft_write_data(const uint8_t* data, uint16_t length)
+{
+  if (length != 0) {
+    SPI.writeBytes(data, length);
+  }
+}
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+#
+# Decoder for gcore_telemetry.ino serial exports
+#
+# Reads a capture of the gcore_tlm_export() output (for example a serial monitor log
+# saved to a file, or stdin) and prints a per-power-cycle summary.  Optionally writes
+# a CSV file and plots the battery voltage, charge state and CPU load (requires
+# matplotlib).
+#
+#   gcore_tlm_decode.py capture.txt
+#   gcore_tlm_decode.py capture.txt --csv tlm.csv --plot
+#
+# Copyright (c) 2020 Dan Julio (dan@danjuliodesigns.com)
+#
+# This program is free software: you can redistribute it and/or modify it under the
+# terms of the GNU General Public License as published by the Free Software Foundation,
+# either version 3 of the License, or (at your option) any later version.
+#
+# See <http://www.gnu.org/licenses/>.
+#
+import argparse
+import struct
+import sys
+
+# Must match gcore_telemetry.ino
+TLM_VERSION = 1
+REC_FORMAT = "<IHBB"
+REC_LEN = struct.calcsize(REC_FORMAT)
+
+FLAG_CHG_MASK = 0x03
+FLAG_BTN_DOWN = 0x04
+FLAG_SHORT = 0x08
+FLAG_LONG = 0x10
+FLAG_BOOT = 0x80
+
+CHARGE_NAMES = ["IDLE", "COMPLETE", "CHARGING", "FAULT"]
+
+
+class Record:
+    def __init__(self, t_sec, batt_mv, flags, cpu_load):
+        self.t_sec = t_sec
+        self.batt_v = batt_mv / 1000.0
+        self.charge = flags & FLAG_CHG_MASK
+        self.button_down = bool(flags & FLAG_BTN_DOWN)
+        self.short_press = bool(flags & FLAG_SHORT)
+        self.long_press = bool(flags & FLAG_LONG)
+        self.boot = bool(flags & FLAG_BOOT)
+        self.cpu_load = cpu_load
+
+
+def parse(lines):
+    """Returns (sample interval, list of records) from the first complete export found"""
+    interval = None
+    records = []
+    in_export = False
+
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TLM,"):
+            fields = line.split(",")
+            if int(fields[1]) != TLM_VERSION:
+                raise ValueError("Unsupported telemetry version %s" % fields[1])
+            interval = int(fields[2])
+            records = []
+            in_export = True
+        elif not in_export:
+            continue
+        elif line.startswith("END,"):
+            expected = int(line.split(",")[1])
+            if expected != len(records):
+                print("Warning: expected %d records, decoded %d" % (expected, len(records)),
+                      file=sys.stderr)
+            return interval, records
+        elif len(line) == 2 * REC_LEN:
+            records.append(Record(*struct.unpack(REC_FORMAT, bytes.fromhex(line))))
+
+    if in_export:
+        print("Warning: export truncated", file=sys.stderr)
+        return interval, records
+    raise ValueError("No telemetry export found")
+
+
+def split_sessions(records):
+    """Splits records into power cycles using the boot flag"""
+    sessions = []
+    for r in records:
+        if r.boot or not sessions:
+            sessions.append([])
+        sessions[-1].append(r)
+    return sessions
+
+
+def summarize(interval, sessions):
+    print("Sample interval: %d sec, %d power cycle(s)" % (interval, len(sessions)))
+    for n, s in enumerate(sessions):
+        volts = [r.batt_v for r in s]
+        charge_time = [0] * len(CHARGE_NAMES)
+        for r in s:
+            charge_time[r.charge] += interval
+        print("")
+        print("Cycle %d: %d records, %d - %d sec" % (n, len(s), s[0].t_sec, s[-1].t_sec))
+        print("  Battery: start %1.2fv  end %1.2fv  min %1.2fv  max %1.2fv" %
+              (volts[0], volts[-1], min(volts), max(volts)))
+        if s[-1].t_sec > s[0].t_sec:
+            rate = (volts[-1] - volts[0]) / ((s[-1].t_sec - s[0].t_sec) / 3600.0)
+            print("  Average change: %+1.3f v/hour" % rate)
+        print("  Charge state: " + ", ".join("%s %d sec" % (CHARGE_NAMES[i], charge_time[i])
+                                             for i in range(len(CHARGE_NAMES)) if charge_time[i]))
+        print("  Button: %d short press, %d long press" %
+              (sum(r.short_press for r in s), sum(r.long_press for r in s)))
+        print("  CPU load: average %d%%  max %d%%" %
+              (sum(r.cpu_load for r in s) / len(s), max(r.cpu_load for r in s)))
+        if s[-1].long_press:
+            print("  Ended after a long press")
+        elif s[-1].charge == 0 and min(volts[-3:]) < 3.5:
+            print("  Ended on battery at low voltage")
+
+
+def write_csv(filename, sessions):
+    with open(filename, "w") as f:
+        f.write("cycle,t_sec,batt_v,charge,button_down,short_press,long_press,cpu_load\n")
+        for n, s in enumerate(sessions):
+            for r in s:
+                f.write("%d,%d,%1.3f,%s,%d,%d,%d,%d\n" %
+                        (n, r.t_sec, r.batt_v, CHARGE_NAMES[r.charge], r.button_down,
+                         r.short_press, r.long_press, r.cpu_load))
+
+
+def plot(sessions):
+    import matplotlib.pyplot as plt
+
+    fig, axes = plt.subplots(3, 1, sharex=True)
+    for n, s in enumerate(sessions):
+        t = [r.t_sec / 60.0 for r in s]
+        axes[0].plot(t, [r.batt_v for r in s], label="cycle %d" % n)
+        axes[1].step(t, [r.charge for r in s], where="post")
+        axes[2].plot(t, [r.cpu_load for r in s])
+        for r in s:
+            if r.short_press or r.long_press:
+                axes[0].axvline(r.t_sec / 60.0, color="gray", linestyle=":")
+    axes[0].set_ylabel("Battery (v)")
+    axes[0].legend()
+    axes[1].set_ylabel("Charge")
+    axes[1].set_yticks(range(len(CHARGE_NAMES)))
+    axes[1].set_yticklabels(CHARGE_NAMES)
+    axes[2].set_ylabel("CPU load (%)")
+    axes[2].set_xlabel("Minutes since boot")
+    plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode gCore power telemetry exports")
+    parser.add_argument("capture", nargs="?", help="captured export (default stdin)")
+    parser.add_argument("--csv", help="write decoded records to a CSV file")
+    parser.add_argument("--plot", action="store_true", help="plot the decoded records")
+    args = parser.parse_args()
+
+    if args.capture:
+        with open(args.capture, errors="replace") as f:
+            interval, records = parse(f)
+    else:
+        interval, records = parse(sys.stdin)
+
+    if not records:
+        print("No records")
+        return
+    sessions = split_sessions(records)
+    summarize(interval, sessions)
+    if args.csv:
+        write_csv(args.csv, sessions)
+    if args.plot:
+        plot(sessions)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,117 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - www.fabgl.com
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * gCore TFT parallel drawing benchmark
+ *
+ * Draws filled polygons and scrolls horizontally with primitives executed on a single core and on both
+ * cores, and prints the timings on the serial port.
+ *
+ * TFT Display signals:
+ *   SCK  => GPIO 5
+ *   MOSI => GPIO 18
+ *   CS   => GPIO 15
+ *   D/C  => GPIO 33
+ *   RESX => UNUSED
+ */
+
+
+#include "fabgl.h"
+
+
+
+fabgl::HX8357DController DisplayController;
+fabgl::Canvas            canvas(&DisplayController);
+
+
+
+#define TFT_SCK    5
+#define TFT_MOSI   18
+#define TFT_CS     15
+#define TFT_DC     33
+#define TFT_RESET  GPIO_UNUSED
+#define TFT_SPIBUS VSPI_HOST
+
+#define TS_CS      32
+#define SD_CS      14
+#define PWR_HOLD 2
+
+
+#define ITERATIONS 20
+
+
+double bench(bool parallel)
+{
+  DisplayController.enableParallelExecution(parallel);
+
+  const int w = DisplayController.getViewPortWidth();
+  const int h = DisplayController.getViewPortHeight();
+
+  canvas.setBrushColor(Color::Black);
+  canvas.clear();
+  DisplayController.primitivesExecutionWait();
+
+  int64_t t = esp_timer_get_time();
+  for (int i = 0; i < ITERATIONS; ++i) {
+    // large polygons crossing both bands
+    for (int j = 0; j < 8; ++j) {
+      Point points[5] = { { j * w / 8,  0 },
+                          { w - 1,      j * h / 8 },
+                          { w - j * w / 8, h - 1 },
+                          { 0,          h - 1 - j * h / 8 },
+                          { w / 2,      h / 2 } };
+      canvas.setBrushColor((Color)((i + j) % 15 + 1));
+      canvas.fillPath(points, 5);
+    }
+    canvas.scroll(-4, 0);
+  }
+  DisplayController.primitivesExecutionWait();
+  return (double)(esp_timer_get_time() - t) / ITERATIONS;
+}
+
+
+void setup()
+{
+  pinMode(PWR_HOLD, OUTPUT);
+  digitalWrite(PWR_HOLD, HIGH);
+  pinMode(TS_CS, OUTPUT);
+  digitalWrite(TS_CS, HIGH);
+  pinMode(SD_CS, OUTPUT);
+  digitalWrite(SD_CS, HIGH);
+
+  Serial.begin(115200);
+
+  DisplayController.begin(TFT_SCK, TFT_MOSI, TFT_DC, TFT_RESET, TFT_CS, TFT_SPIBUS);
+  DisplayController.setResolution(TFT_320x480);
+  DisplayController.setOrientation(fabgl::TFTOrientation::Rotate270);
+}
+
+
+void loop()
+{
+  double tSingle   = bench(false);
+  double tParallel = bench(true);
+  Serial.printf("single core: %7.0f us/iteration   both cores: %7.0f us/iteration   (x%.2f)\n", tSingle, tParallel, tSingle / tParallel);
+
+  delay(5000);
+}
@@ -102,4 +102,14 @@ void loop()
   test(Color::Yellow,"Rotate180");
   DisplayController.setOrientation(fabgl::TFTOrientation::Rotate270);
   test(Color::Magenta, "Rotate270");
+
+  // canonical viewport: the display rotates what has been drawn, without redrawing it
+  DisplayController.setOrientation(fabgl::TFTOrientation::Rotate0);
+  test(Color::Cyan, "Canonical");
+  DisplayController.enableCanonicalViewPort(true);
+  for (int i = 0; i < 4; ++i) {
+    DisplayController.setOrientation(i & 1 ? fabgl::TFTOrientation::Rotate0 : fabgl::TFTOrientation::Rotate180);
+    delay(1000);
+  }
+  DisplayController.enableCanonicalViewPort(false);
 }
@@ -0,0 +1,132 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - www.fabgl.com
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * gCore TFT transfer benchmark
+ *
+ * Sends the whole screen buffer and some partial rectangles to the display, with and without
+ * pipelined DMA transfers, and prints the throughput on the serial port.
+ *
+ * TFT Display signals:
+ *   SCK  => GPIO 5
+ *   MOSI => GPIO 18
+ *   CS   => GPIO 15
+ *   D/C  => GPIO 33
+ *   RESX => UNUSED
+ */
+
+
+#include "fabgl.h"
+
+
+
+// gives access to the screen buffer sending function
+struct BenchController : public fabgl::HX8357DController {
+  int64_t timeSend(Rect const & rect, int count) {
+    suspendBackgroundPrimitiveExecution();
+    int64_t t = esp_timer_get_time();
+    for (int i = 0; i < count; ++i)
+      sendScreenBuffer(rect);
+    t = esp_timer_get_time() - t;
+    resumeBackgroundPrimitiveExecution();
+    return t;
+  }
+};
+
+
+BenchController DisplayController;
+fabgl::Canvas   canvas(&DisplayController);
+
+
+
+#define TFT_SCK    5
+#define TFT_MOSI   18
+#define TFT_CS     15
+#define TFT_DC     33
+#define TFT_RESET  GPIO_UNUSED
+#define TFT_SPIBUS VSPI_HOST
+
+#define TS_CS      32
+#define SD_CS      14
+#define PWR_HOLD 2
+
+
+#define ITERATIONS 20
+
+
+void bench(char const * name, Rect const & rect)
+{
+  const double bytes = (double)rect.width() * rect.height() * sizeof(uint16_t) * ITERATIONS;
+
+  DisplayController.enableDMAPipeline(false);
+  int64_t tRow = DisplayController.timeSend(rect, ITERATIONS);
+
+  DisplayController.enableDMAPipeline(true);
+  int64_t tPipe = DisplayController.timeSend(rect, ITERATIONS);
+
+  Serial.printf("%-12s %3dx%3d  per row: %5.2f MB/s %6.2f ms   pipelined: %5.2f MB/s %6.2f ms   (x%.2f)\n",
+                name, rect.width(), rect.height(),
+                bytes / tRow, (double)tRow / ITERATIONS / 1000.0,
+                bytes / tPipe, (double)tPipe / ITERATIONS / 1000.0,
+                (double)tRow / tPipe);
+}
+
+
+void setup()
+{
+  pinMode(PWR_HOLD, OUTPUT);
+  digitalWrite(PWR_HOLD, HIGH);
+  pinMode(TS_CS, OUTPUT);
+  digitalWrite(TS_CS, HIGH);
+  pinMode(SD_CS, OUTPUT);
+  digitalWrite(SD_CS, HIGH);
+
+  Serial.begin(115200);
+
+  DisplayController.begin(TFT_SCK, TFT_MOSI, TFT_DC, TFT_RESET, TFT_CS, TFT_SPIBUS);
+  DisplayController.setResolution(TFT_320x480);
+  DisplayController.setOrientation(fabgl::TFTOrientation::Rotate270);
+
+  // something to look at while measuring
+  canvas.setBrushColor(Color::Blue);
+  canvas.clear();
+  canvas.setPenColor(Color::BrightYellow);
+  canvas.selectFont(&fabgl::FONT_8x14);
+  canvas.drawText(8, 8, "SPI throughput benchmark - see serial output");
+  DisplayController.primitivesExecutionWait();
+  delay(100);
+}
+
+
+void loop()
+{
+  const int w = DisplayController.getViewPortWidth();
+  const int h = DisplayController.getViewPortHeight();
+
+  Serial.println();
+  bench("full screen", Rect(0, 0, w - 1, h - 1));
+  bench("half width",  Rect(0, 0, w / 2 - 1, h - 1));
+  bench("16 rows",     Rect(0, 0, w - 1, 15));
+  bench("64x64",       Rect(0, 0, 63, 63));
+
+  delay(5000);
+}
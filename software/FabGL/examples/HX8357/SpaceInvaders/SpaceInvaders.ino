@@ -275,6 +275,8 @@ struct GameScene : public Scene {
 
   ~GameScene()
   {
+    // next scene bitmaps may have the same addresses
+    DisplayController.invalidateBitmapCache();
     delete [] sprites_;
   }
 
@@ -598,6 +600,7 @@ struct GameScene : public Scene {
       int py = iclamp(y + random(-4, 5), 0, shield->getHeight() - 1);
       shieldBitmap->setPixel(px, py, 0);
     }
+    DisplayController.invalidateBitmapCache(shieldBitmap);
   }
 
   void showLives()
@@ -678,6 +681,9 @@ void setup()
   DisplayController.setResolution(TFT_320x480);
   DisplayController.setOrientation(fabgl::TFTOrientation::Rotate270);
 
+  // keep sprite bitmaps converted to native pixels
+  DisplayController.setBitmapCacheSize(16384);
+
   // adjust this to center screen in your monitor
   //DisplayController.moveScreen(20, -2);
 }
@@ -0,0 +1,124 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - www.fabgl.com
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * gCore TFT tile cache benchmark
+ *
+ * Draws text and small shapes with and without the internal RAM tile cache and prints timings
+ * and cache counters on the serial port.
+ *
+ * TFT Display signals:
+ *   SCK  => GPIO 5
+ *   MOSI => GPIO 18
+ *   CS   => GPIO 15
+ *   D/C  => GPIO 33
+ *   RESX => UNUSED
+ */
+
+
+#include "fabgl.h"
+
+
+
+fabgl::HX8357DController DisplayController;
+fabgl::Canvas            canvas(&DisplayController);
+
+
+
+#define TFT_SCK    5
+#define TFT_MOSI   18
+#define TFT_CS     15
+#define TFT_DC     33
+#define TFT_RESET  GPIO_UNUSED
+#define TFT_SPIBUS VSPI_HOST
+
+#define TS_CS      32
+#define SD_CS      14
+#define PWR_HOLD 2
+
+
+#define ITERATIONS 20
+
+
+void bench(int tiles)
+{
+  DisplayController.setTileCacheSize(tiles);
+  DisplayController.resetTileCacheStats();
+
+  const int w = DisplayController.getViewPortWidth();
+  const int h = DisplayController.getViewPortHeight();
+
+  canvas.setBrushColor(Color::Black);
+  canvas.clear();
+  DisplayController.primitivesExecutionWait();
+
+  int64_t t = esp_timer_get_time();
+  for (int i = 0; i < ITERATIONS; ++i) {
+    // a line of text
+    canvas.setPenColor(i & 1 ? Color::BrightYellow : Color::BrightCyan);
+    canvas.drawText(8, 40 + (i % 16) * 16, "The quick brown fox jumps over the lazy dog 0123456789");
+    // some small shapes
+    for (int j = 0; j < 16; ++j) {
+      canvas.setBrushColor((Color)(j & 15));
+      canvas.fillEllipse(16 + j * (w - 32) / 16, h - 24, 20, 20);
+    }
+  }
+  DisplayController.primitivesExecutionWait();
+  t = esp_timer_get_time() - t;
+
+  auto stats = DisplayController.tileCacheStats();
+  Serial.printf("tiles: %2d   %7.0f us/iteration   hits: %8u  misses: %6u  write backs: %6u\n",
+                DisplayController.tileCacheSize(), (double)t / ITERATIONS, stats.hits, stats.misses, stats.writeBacks);
+}
+
+
+void setup()
+{
+  pinMode(PWR_HOLD, OUTPUT);
+  digitalWrite(PWR_HOLD, HIGH);
+  pinMode(TS_CS, OUTPUT);
+  digitalWrite(TS_CS, HIGH);
+  pinMode(SD_CS, OUTPUT);
+  digitalWrite(SD_CS, HIGH);
+
+  Serial.begin(115200);
+
+  DisplayController.begin(TFT_SCK, TFT_MOSI, TFT_DC, TFT_RESET, TFT_CS, TFT_SPIBUS);
+  DisplayController.setResolution(TFT_320x480);
+  DisplayController.setOrientation(fabgl::TFTOrientation::Rotate270);
+
+  canvas.selectFont(&fabgl::FONT_8x14);
+  canvas.setGlyphOptions(GlyphOptions().FillBackground(true));
+}
+
+
+void loop()
+{
+  Serial.println();
+  bench(0);
+  bench(2);
+  bench(4);
+  bench(8);
+
+  delay(5000);
+}
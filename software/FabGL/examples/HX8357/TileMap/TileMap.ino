@@ -0,0 +1,210 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - www.fabgl.com
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * gCore TFT tile map benchmark
+ *
+ * Scrolls a two layers tile map (ground and an overlay with transparent tiles) with a few sprites over it,
+ * drawing all tiles at each frame and drawing just the uncovered tiles, and prints the timings on the serial port.
+ * Last pass scrolls vertically in portrait orientation, where the display hardware scrolling applies.
+ *
+ * TFT Display signals:
+ *   SCK  => GPIO 5
+ *   MOSI => GPIO 18
+ *   CS   => GPIO 15
+ *   D/C  => GPIO 33
+ *   RESX => UNUSED
+ */
+
+
+#include "fabgl.h"
+
+
+
+fabgl::HX8357DController DisplayController;
+fabgl::Canvas            canvas(&DisplayController);
+
+
+
+#define TFT_SCK    5
+#define TFT_MOSI   18
+#define TFT_CS     15
+#define TFT_DC     33
+#define TFT_RESET  GPIO_UNUSED
+#define TFT_SPIBUS VSPI_HOST
+
+#define TS_CS      32
+#define SD_CS      14
+#define PWR_HOLD 2
+
+
+#define FRAMES       200
+
+#define TILE_SIZE    16
+#define TILES        8
+#define MAP_COLUMNS  64
+#define MAP_ROWS     48
+
+#define SPRITES      4
+
+
+// tiles 0..3: ground (opaque), tiles 4..7: overlay (with transparent pixels)
+uint8_t   tilesetData[TILE_SIZE * TILE_SIZE * TILES];
+Bitmap    tileset = Bitmap(TILE_SIZE, TILE_SIZE * TILES, tilesetData, PixelFormat::RGBA2222);
+
+uint8_t   groundLayer[MAP_COLUMNS * MAP_ROWS];
+uint8_t   overlayLayer[MAP_COLUMNS * MAP_ROWS];
+
+TileMap   tileMap;
+
+uint8_t   shipData[16 * 16];
+Bitmap    ship = Bitmap(16, 16, shipData, PixelFormat::RGBA2222);
+Sprite    sprites[SPRITES];
+
+
+// RGBA2222: AABBGGRR
+uint8_t rgba2222(int r, int g, int b, int a = 3)
+{
+  return (a << 6) | (b << 4) | (g << 2) | r;
+}
+
+
+void createTiles()
+{
+  for (int tile = 0; tile < TILES; ++tile) {
+    uint8_t * p = tilesetData + tile * TILE_SIZE * TILE_SIZE;
+    for (int y = 0; y < TILE_SIZE; ++y)
+      for (int x = 0; x < TILE_SIZE; ++x, ++p) {
+        const bool border = x == 0 || y == 0;
+        switch (tile) {
+          case 0: *p = rgba2222(0, 1, 0);                                         break; // grass
+          case 1: *p = border ? rgba2222(1, 1, 1) : rgba2222(2, 2, 2);            break; // stone
+          case 2: *p = (x + y) & 4 ? rgba2222(0, 0, 2) : rgba2222(0, 1, 3);       break; // water
+          case 3: *p = (x ^ y) & 2 ? rgba2222(2, 1, 0) : rgba2222(1, 1, 0);       break; // sand
+          case 4: *p = (x - 8) * (x - 8) + (y - 8) * (y - 8) < 40 ? rgba2222(0, 2, 0) : 0; break; // bush
+          case 5: *p = x > 5 && x < 10 ? rgba2222(2, 1, 0) : 0;                   break; // pole
+          case 6: *p = y > 6 && y < 9 ? rgba2222(3, 3, 3, 2) : 0;                 break; // half transparent bar
+          case 7: *p = (x + y) % 5 == 0 ? rgba2222(3, 3, 0) : 0;                  break; // sparkles
+        }
+      }
+  }
+}
+
+
+void createMap()
+{
+  for (int row = 0; row < MAP_ROWS; ++row)
+    for (int col = 0; col < MAP_COLUMNS; ++col) {
+      groundLayer[row * MAP_COLUMNS + col]  = ((row / 4) ^ (col / 6)) & 3;
+      overlayLayer[row * MAP_COLUMNS + col] = (row * 7 + col * 3) % 11 < 4 ? 4 + (row + col) % 4 : 0;
+    }
+
+  tileMap.tileset    = &tileset;
+  tileMap.tileWidth  = TILE_SIZE;
+  tileMap.tileHeight = TILE_SIZE;
+  tileMap.columns    = MAP_COLUMNS;
+  tileMap.rows       = MAP_ROWS;
+  tileMap.layers[0]  = groundLayer;
+  tileMap.layers[1]  = overlayLayer;
+}
+
+
+void createSprites()
+{
+  for (int y = 0; y < 16; ++y)
+    for (int x = 0; x < 16; ++x)
+      shipData[y * 16 + x] = abs(x - 8) <= y / 2 ? rgba2222(3, y / 6, 0) : 0;
+  for (int i = 0; i < SPRITES; ++i)
+    sprites[i].addBitmap(&ship);
+  DisplayController.setSprites(sprites, SPRITES);
+}
+
+
+// incremental = false: all tiles are drawn at each frame
+void bench(char const * name, bool incremental, int speedX, int speedY)
+{
+  const int w = DisplayController.getViewPortWidth();
+  const int h = DisplayController.getViewPortHeight();
+
+  tileMap.rect = Rect(0, 0, w - 1, h - 1);
+  tileMap.invalidate();
+  canvas.drawTileMap(&tileMap, 0, 0);
+  DisplayController.primitivesExecutionWait();
+
+  int64_t t = esp_timer_get_time();
+  for (int frame = 1; frame <= FRAMES; ++frame) {
+    if (!incremental)
+      tileMap.invalidate();
+    canvas.drawTileMap(&tileMap, frame * speedX, frame * speedY);
+    for (int i = 0; i < SPRITES; ++i)
+      sprites[i].moveTo(w / 2 + (w / 3) * cos(frame * 0.05 + i * 1.57), h / 2 + (h / 3) * sin(frame * 0.05 + i * 1.57));
+    DisplayController.refreshSprites();
+    DisplayController.primitivesExecutionWait();
+  }
+  t = esp_timer_get_time() - t;
+
+  Serial.printf("%-28s %s  %6.0f us/frame\n", name, incremental ? "uncovered tiles" : "all tiles      ", (double)t / FRAMES);
+}
+
+
+void setup()
+{
+  pinMode(PWR_HOLD, OUTPUT);
+  digitalWrite(PWR_HOLD, HIGH);
+  pinMode(TS_CS, OUTPUT);
+  digitalWrite(TS_CS, HIGH);
+  pinMode(SD_CS, OUTPUT);
+  digitalWrite(SD_CS, HIGH);
+
+  Serial.begin(115200);
+
+  DisplayController.begin(TFT_SCK, TFT_MOSI, TFT_DC, TFT_RESET, TFT_CS, TFT_SPIBUS);
+  DisplayController.setResolution(TFT_320x480);
+
+  // RGBA2222 tiles converted once to native format
+  DisplayController.setBitmapCacheSize(16384);
+
+  createTiles();
+  createMap();
+  createSprites();
+}
+
+
+void loop()
+{
+  Serial.println();
+
+  // 480x320, scrolling diagonally
+  DisplayController.setOrientation(fabgl::TFTOrientation::Rotate270);
+  DisplayController.enableHardwareScrolling(false);
+  bench("480x320 diagonal", false, 2, 1);
+  bench("480x320 diagonal", true,  2, 1);
+
+  // 320x480, scrolling vertically: the display moves the rows
+  DisplayController.setOrientation(fabgl::TFTOrientation::Rotate0);
+  DisplayController.enableHardwareScrolling(true);
+  bench("320x480 vertical (hardware)", false, 0, -2);
+  bench("320x480 vertical (hardware)", true,  0, -2);
+
+  delay(5000);
+}
@@ -0,0 +1,132 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - www.fabgl.com
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * gCore TFT viewport layout benchmark
+ *
+ * Times clear, fill and scroll primitives with the default row-allocated viewport and with
+ * the contiguous 32-byte aligned one, and prints the results on the serial port.
+ *
+ * TFT Display signals:
+ *   SCK  => GPIO 5
+ *   MOSI => GPIO 18
+ *   CS   => GPIO 15
+ *   D/C  => GPIO 33
+ *   RESX => UNUSED
+ */
+
+
+#include "fabgl.h"
+
+
+
+fabgl::HX8357DController DisplayController;
+fabgl::Canvas            canvas(&DisplayController);
+
+
+
+#define TFT_SCK    5
+#define TFT_MOSI   18
+#define TFT_CS     15
+#define TFT_DC     33
+#define TFT_RESET  GPIO_UNUSED
+#define TFT_SPIBUS VSPI_HOST
+
+#define TS_CS      32
+#define SD_CS      14
+#define PWR_HOLD 2
+
+
+#define ITERATIONS 20
+
+
+// returns average time in microseconds of "count" executions of "f"
+template <typename F>
+double timeIt(F f, int count = ITERATIONS)
+{
+  DisplayController.primitivesExecutionWait();
+  int64_t t = esp_timer_get_time();
+  for (int i = 0; i < count; ++i)
+    f(i);
+  DisplayController.primitivesExecutionWait();
+  return (double)(esp_timer_get_time() - t) / count;
+}
+
+
+void bench(char const * name, fabgl::TFTViewPortLayout layout)
+{
+  DisplayController.setViewPortLayout(layout);
+
+  const int w = DisplayController.getViewPortWidth();
+  const int h = DisplayController.getViewPortHeight();
+
+  double tClear = timeIt([&](int i) {
+    canvas.setBrushColor(i & 1 ? Color::Blue : Color::Black);
+    canvas.clear();
+  });
+
+  double tFill = timeIt([&](int i) {
+    canvas.setBrushColor(i & 1 ? Color::Red : Color::Green);
+    canvas.fillRectangle(w / 4, h / 4, w * 3 / 4, h * 3 / 4);
+  });
+
+  double tScroll = timeIt([&](int i) {
+    canvas.setScrollingRegion(0, 0, w - 1, h - 1);
+    canvas.scroll(0, -8);
+  });
+
+  double tScrollPart = timeIt([&](int i) {
+    canvas.setScrollingRegion(w / 4, 0, w * 3 / 4, h - 1);
+    canvas.scroll(0, -8);
+  });
+
+  Serial.printf("%-10s clear: %7.0f us   fill: %7.0f us   scroll: %7.0f us   partial scroll: %7.0f us\n",
+                name, tClear, tFill, tScroll, tScrollPart);
+}
+
+
+void setup()
+{
+  pinMode(PWR_HOLD, OUTPUT);
+  digitalWrite(PWR_HOLD, HIGH);
+  pinMode(TS_CS, OUTPUT);
+  digitalWrite(TS_CS, HIGH);
+  pinMode(SD_CS, OUTPUT);
+  digitalWrite(SD_CS, HIGH);
+
+  Serial.begin(115200);
+
+  DisplayController.begin(TFT_SCK, TFT_MOSI, TFT_DC, TFT_RESET, TFT_CS, TFT_SPIBUS);
+  DisplayController.setResolution(TFT_320x480);
+  DisplayController.setOrientation(fabgl::TFTOrientation::Rotate270);
+}
+
+
+void loop()
+{
+  Serial.println();
+  bench("rows", fabgl::TFTViewPortLayout::Rows);
+  bench("contiguous", fabgl::TFTViewPortLayout::Contiguous);
+
+  delay(5000);
+}
@@ -0,0 +1,230 @@
+/*
+  Host side test and benchmark of the RGB565BE alpha blending kernels (fabutils.h), used by TFT displays to draw
+  translucent bitmaps and sprites.
+  Checks blendRGB565BE() against a floating point reference over random pixel pairs and all alpha values, the two pixels
+  and run kernels against the single pixel one, then measures time and cycles (time stamp counter on x86) per pixel.
+
+  Build and run (from this directory):
+    g++ -std=gnu++11 -O2 -Wall -Ihost -I../../src blend_test.cpp -o blend_test && ./blend_test
+  Add -fno-tree-vectorize to get timings closer to a scalar CPU like the ESP32 (the float reference vectorizes well).
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "fabutils.h"
+
+
+using namespace fabgl;
+
+
+static uint32_t s_seed = 12345;
+
+static uint32_t rnd()
+{
+  s_seed ^= s_seed << 13;
+  s_seed ^= s_seed >> 17;
+  s_seed ^= s_seed << 5;
+  return s_seed;
+}
+
+
+static uint16_t rndPixel()
+{
+  return (uint16_t) rnd();
+}
+
+
+// RGB565BE -> 5, 6, 5 bits channels
+static void channels(uint16_t pixel, int * c)
+{
+  uint16_t v = __builtin_bswap16(pixel);
+  c[0] = v >> 11;
+  c[1] = (v >> 5) & 0x3f;
+  c[2] = v & 0x1f;
+}
+
+
+// maximum error (in channel LSB) allowed against the exact blend, due to 5 bit alpha
+static const double MAX_ERROR[3] = { 1.0, 1.5, 1.0 };
+
+
+static bool testAccuracy()
+{
+  const int PAIRS = 20000;
+  double maxError[3] = { 0, 0, 0 };
+  double sumError = 0;
+  long count = 0;
+  bool ok = true;
+  for (int i = 0; i < PAIRS; ++i) {
+    const uint16_t dst = rndPixel(), src = rndPixel();
+    int d[3], s[3];
+    channels(dst, d);
+    channels(src, s);
+    for (int alpha = 0; alpha < 256; ++alpha) {
+      uint16_t result = dst;
+      blendRGB565BEPixel(&result, src, alpha);
+      int r[3];
+      channels(result, r);
+      for (int c = 0; c < 3; ++c) {
+        const double ref = d[c] + (s[c] - d[c]) * alpha / 255.0;
+        const double err = fabs(r[c] - ref);
+        maxError[c] = fmax(maxError[c], err);
+        sumError += err;
+        ++count;
+        if (err > MAX_ERROR[c] && ok) {
+          printf("  dst %04X src %04X alpha %d: channel %d = %d, reference %.2f\n", dst, src, alpha, c, r[c], ref);
+          ok = false;
+        }
+      }
+      // fast paths must be exact
+      if ((alpha == 0 && result != dst) || (alpha == 255 && result != src)) {
+        printf("  dst %04X src %04X alpha %d: result %04X\n", dst, src, alpha, result);
+        ok = false;
+      }
+    }
+  }
+  printf("float reference: max error R %.2f G %.2f B %.2f LSB, mean %.2f LSB -> %s\n",
+         maxError[0], maxError[1], maxError[2], sumError / count, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+
+// two pixels and run kernels must match the single pixel kernel bit by bit
+static bool testKernels()
+{
+  bool ok = true;
+
+  for (int i = 0; i < 100000 && ok; ++i) {
+    const uint32_t dst = rnd(), src = rnd();
+    const int alpha5 = rnd() % 33;
+    const uint32_t r = blendRGB565BE2(dst, src, alpha5);
+    ok = (r & 0xffff) == blendRGB565BE(dst & 0xffff, src & 0xffff, alpha5) && (r >> 16) == blendRGB565BE(dst >> 16, src >> 16, alpha5);
+  }
+  printf("two pixels kernel -> %s\n", ok ? "ok" : "FAILED");
+
+  bool runOk = true;
+  alignas(4) uint16_t dst[40], src[41], ref[40];
+  for (int i = 0; i < 20000 && runOk; ++i) {
+    const int alpha = rnd() % 256;
+    const int dstOfs = rnd() % 2, srcOfs = rnd() % 2;     // all alignments
+    const int count = rnd() % (40 - dstOfs);
+    for (int j = 0; j < 40; ++j)
+      dst[j] = ref[j] = rndPixel();
+    for (int j = 0; j < 41; ++j)
+      src[j] = rndPixel();
+    blendRGB565BERun(dst + dstOfs, src + srcOfs, count, alpha);
+    for (int j = 0; j < count; ++j)
+      blendRGB565BEPixel(ref + dstOfs + j, src[srcOfs + j], alpha);
+    for (int j = 0; j < 40; ++j)
+      runOk = runOk && dst[j] == ref[j];
+  }
+  printf("run kernel -> %s\n", runOk ? "ok" : "FAILED");
+
+  // within 1 of the rounded product, exact for opacity 0 and 255 (alpha 255 keeps the opaque fast path)
+  bool combineOk = true;
+  for (int alpha = 0; alpha < 256; ++alpha) {
+    for (int opacity = 0; opacity < 256; ++opacity)
+      combineOk = combineOk && abs(combineAlpha(alpha, opacity) - (alpha * opacity + 127) / 255) <= 1;
+    combineOk = combineOk && combineAlpha(alpha, 0) == 0 && combineAlpha(alpha, 255) == alpha && combineAlpha(255, alpha) == alpha;
+  }
+  printf("combineAlpha -> %s\n", combineOk ? "ok" : "FAILED");
+
+  return ok && runOk && combineOk;
+}
+
+
+static double nowNS()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+
+static volatile uint32_t s_sink;
+
+
+template <typename Func>
+static void bench(char const * name, int pixelsPerCall, Func func)
+{
+  const int CALLS = 200000;
+  const double t0 = nowNS();
+  const uint64_t c0 = cycles();
+  for (int i = 0; i < CALLS; ++i)
+    func(i);
+  const uint64_t c1 = cycles();
+  const double t1 = nowNS();
+  const double pixels = (double) CALLS * pixelsPerCall;
+  printf("  %-24s %6.2f ns/px  %6.2f cycles/px\n", name, (t1 - t0) / pixels, (c1 - c0) / pixels);
+}
+
+
+// 480 pixels rows, like a row of a 480x320 display
+static void benchmark()
+{
+  const int W = 480;
+  alignas(4) static uint16_t dst[W], src[W];
+  static uint8_t alpha[W];
+  for (int i = 0; i < W; ++i) {
+    dst[i]   = rndPixel();
+    src[i]   = rndPixel();
+    alpha[i] = rnd() % 4 == 0 ? (rnd() % 2) * 255 : rnd() % 256;  // some transparent and opaque pixels
+  }
+
+  printf("benchmark (%d pixels rows):\n", W);
+  bench("run, uniform alpha", W, [&] (int i) {
+    blendRGB565BERun(dst, src, W, 1 + i % 254);
+    s_sink += dst[i % W];
+  });
+  bench("pixels, uniform alpha", W, [&] (int i) {
+    const int a = 1 + i % 254;
+    for (int x = 0; x < W; ++x)
+      blendRGB565BEPixel(dst + x, src[x], a);
+    s_sink += dst[i % W];
+  });
+  bench("pixels, per pixel alpha", W, [&] (int i) {
+    for (int x = 0; x < W; ++x)
+      blendRGB565BEPixel(dst + x, src[x], alpha[x]);
+    s_sink += dst[i % W];
+  });
+  bench("float reference", W, [&] (int i) {
+    for (int x = 0; x < W; ++x) {
+      int d[3], s[3];
+      channels(dst[x], d);
+      channels(src[x], s);
+      const float a = alpha[x] / 255.0f;
+      const int r = (int) (d[0] + (s[0] - d[0]) * a + 0.5f);
+      const int g = (int) (d[1] + (s[1] - d[1]) * a + 0.5f);
+      const int b = (int) (d[2] + (s[2] - d[2]) * a + 0.5f);
+      dst[x] = __builtin_bswap16((uint16_t) (r << 11 | g << 5 | b));
+    }
+    s_sink += dst[i % W];
+  });
+}
+
+
+int main()
+{
+  bool ok = testAccuracy();
+  ok = testKernels() && ok;
+  benchmark();
+  printf(ok ? "PASSED\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+/*
+  Minimal replacement of ESP-IDF definitions needed to build FabGL utilities on a host, for tests only.
+ */
+
+
+
+#pragma once
+
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+#define IRAM_ATTR
+
+#define MALLOC_CAP_INTERNAL 1
+#define MALLOC_CAP_8BIT     2
+#define MALLOC_CAP_DMA      4
+#define MALLOC_CAP_32BIT    8
+
+inline void * heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline void * heap_caps_realloc(void * ptr, size_t size, uint32_t) { return realloc(ptr, size); }
+inline void heap_caps_free(void * ptr) { free(ptr); }
+
+typedef enum { GPIO_NUM_NC = -1, GPIO_NUM_0 = 0, GPIO_NUM_MAX = 40 } gpio_num_t;
@@ -0,0 +1,371 @@
+/*
+  Host side test and benchmark of fabgl::PolygonRasterizer (fabutils.h), used by DisplayController::fillPath() on all
+  display controllers.
+  Checks that the rasterizer produces the same spans of the previous fillPath() code (per scanline crossings sorted
+  by gnome sort), on random polygons with random clipping rectangles and origins, checks that anti-aliased coverage
+  sums to the polygon area, then measures time per polygon of both implementations.
+
+  Build and run (from this directory):
+    g++ -std=gnu++11 -O2 -Wall -Ihost -I../../src polygon_test.cpp -o polygon_test && ./polygon_test
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+#include <vector>
+#include <algorithm>
+
+#include "fabutils.h"
+
+
+using namespace fabgl;
+
+
+static uint32_t s_seed = 12345;
+
+static uint32_t rnd()
+{
+  s_seed ^= s_seed << 13;
+  s_seed ^= s_seed >> 17;
+  s_seed ^= s_seed << 5;
+  return s_seed;
+}
+
+
+// min..max (inclusive)
+static int rndRange(int min, int max)
+{
+  return min + (int) (rnd() % (uint32_t) (max - min + 1));
+}
+
+
+struct Span {
+  int y, x1, x2;
+  bool operator!=(Span const & s) const { return y != s.y || x1 != s.x1 || x2 != s.x2; }
+};
+
+
+// previous DisplayController::fillPath(), rawFillRow() replaced by fillSpan() (which skips empty spans)
+template <typename TFillSpan>
+static void oldFillPath(Point const * points, int count, int origX, int origY, Rect const & clip, TFillSpan fillSpan)
+{
+  const int clipX1 = clip.X1;
+  const int clipY1 = clip.Y1;
+  const int clipX2 = clip.X2;
+  const int clipY2 = clip.Y2;
+
+  int minX = clipX1;
+  int maxX = clipX2 + 1;
+  int minY = INT_MAX;
+  int maxY = 0;
+  for (int i = 0; i < count; ++i) {
+    int py = points[i].Y + origY;
+    if (py < minY)
+      minY = py;
+    if (py > maxY)
+      maxY = py;
+  }
+  minY = tmax(clipY1, minY);
+  maxY = tmin(clipY2, maxY);
+
+  int16_t nodeX[count];
+
+  for (int pixelY = minY; pixelY <= maxY; ++pixelY) {
+
+    int nodes = 0;
+    int j = count - 1;
+    for (int i = 0; i < count; ++i) {
+      int piy = points[i].Y + origY;
+      int pjy = points[j].Y + origY;
+      if ((piy < pixelY && pjy >= pixelY) || (pjy < pixelY && piy >= pixelY)) {
+        int pjx = points[j].X + origX;
+        int pix = points[i].X + origX;
+        int a = (pixelY - piy) * (pjx - pix);
+        int b = (pjy - piy);
+        nodeX[nodes++] = pix + a / b + (((a < 0) ^ (b > 0)) && (a % b));
+      }
+      j = i;
+    }
+
+    int i = 0;
+    while (i < nodes - 1) {
+      if (nodeX[i] > nodeX[i + 1]) {
+        tswap(nodeX[i], nodeX[i + 1]);
+        if (i)
+          --i;
+      } else
+        ++i;
+    }
+
+    for (int i = 0; i < nodes; i += 2) {
+      if (nodeX[i] >= maxX)
+        break;
+      if (nodeX[i + 1] > minX) {
+        if (nodeX[i] < minX)
+          nodeX[i] = minX;
+        if (nodeX[i + 1] > maxX)
+          nodeX[i + 1] = maxX;
+        if (nodeX[i] <= nodeX[i + 1] - 1)
+          fillSpan(pixelY, nodeX[i], nodeX[i + 1] - 1);
+      }
+    }
+  }
+}
+
+
+template <typename TFillSpan>
+static void newFillPath(Point const * points, int count, int origX, int origY, Rect const & clip, TFillSpan fillSpan)
+{
+  PolygonEdge edges[count];
+  PolygonEdge * active[count];
+  PolygonRasterizer rasterizer(edges, active);
+  rasterizer.setup(points, count, origX, origY, clip);
+  rasterizer.rasterize(fillSpan);
+}
+
+
+static bool compare(char const * name, Point const * points, int count, int origX, int origY, Rect const & clip, long * spansCount)
+{
+  std::vector<Span> oldSpans, newSpans;
+  oldFillPath(points, count, origX, origY, clip, [&] (int y, int x1, int x2) { oldSpans.push_back({ y, x1, x2 }); });
+  newFillPath(points, count, origX, origY, clip, [&] (int y, int x1, int x2) { newSpans.push_back({ y, x1, x2 }); });
+  bool ok = oldSpans.size() == newSpans.size();
+  for (size_t i = 0; ok && i < oldSpans.size(); ++i)
+    ok = !(oldSpans[i] != newSpans[i]);
+  if (!ok) {
+    printf("  %s: %d points, origin %d,%d, clip %d,%d-%d,%d: %d spans, previous code %d\n", name, count, origX, origY,
+           clip.X1, clip.Y1, clip.X2, clip.Y2, (int) newSpans.size(), (int) oldSpans.size());
+    for (int i = 0; i < count; ++i)
+      printf("    %d,%d\n", points[i].X, points[i].Y);
+  }
+  *spansCount += oldSpans.size();
+  return ok;
+}
+
+
+static bool testSpans()
+{
+  const Rect screen = Rect(0, 0, 479, 319);
+  const int POLYGONS = 20000;
+  long spansCount = 0;
+  bool ok = true;
+
+  // random (self intersecting) polygons, partially outside the screen
+  for (int i = 0; i < POLYGONS && ok; ++i) {
+    Point points[16];
+    const int count = rndRange(3, 15);
+    for (int j = 0; j < count; ++j)
+      points[j] = Point(rndRange(-110, 589), rndRange(-90, 409));
+    ok = compare("random", points, count, 0, 0, screen, &spansCount);
+  }
+
+  // random clipping rectangles and origins
+  for (int i = 0; i < POLYGONS && ok; ++i) {
+    Point points[16];
+    const int count = rndRange(3, 15);
+    for (int j = 0; j < count; ++j)
+      points[j] = Point(rndRange(-200, 500), rndRange(-200, 400));
+    const int x1 = rndRange(0, 479), y1 = rndRange(0, 319);
+    const Rect clip = Rect(x1, y1, rndRange(x1, 479), rndRange(y1, 319));
+    ok = compare("clipped", points, count, rndRange(-100, 100), rndRange(-100, 100), clip, &spansCount);
+  }
+
+  // degenerate polygons: horizontal and vertical edges, repeated points, single lines
+  for (int i = 0; i < POLYGONS && ok; ++i) {
+    Point points[16];
+    const int count = rndRange(3, 15);
+    for (int j = 0; j < count; ++j)
+      points[j] = Point(rndRange(0, 8) * 30 - 20, rndRange(0, 6) * 30 - 20);
+    ok = compare("degenerate", points, count, 0, 0, screen, &spansCount);
+  }
+
+  printf("spans: %ld spans -> %s\n", spansCount, ok ? "same as previous code" : "FAILED");
+  return ok;
+}
+
+
+// all turns in the same direction (collinear points allowed)
+static bool isConvex(Point const * points, int count)
+{
+  int turns = 0;
+  for (int i = 0; i < count; ++i) {
+    Point const & a = points[i];
+    Point const & b = points[(i + 1) % count];
+    Point const & c = points[(i + 2) % count];
+    const int cross = (b.X - a.X) * (c.Y - b.Y) - (b.Y - a.Y) * (c.X - b.X);
+    if (cross) {
+      if (turns * cross < 0)
+        return false;
+      turns = cross;
+    }
+  }
+  return true;
+}
+
+
+// sum of covered pixels (solid spans plus coverage of partial pixels) must match the polygon area.
+// Scanline Y crosses edges with Y1 < Y <= Y2, so each row is sampled at the bottom of the area it represents: a
+// horizontal edge at the bottom of the polygon adds half its length, at the top removes half its length.
+static bool testCoverage()
+{
+  const Rect screen = Rect(0, 0, 479, 319);
+  bool ok = true;
+  double maxError = 0;
+  int tested = 0;
+
+  for (int i = 0; i < 10000; ++i) {
+    // convex polygon (thin or empty when points are close): points on an ellipse, by increasing angle
+    Point points[16];
+    const int count = rndRange(3, 15);
+    const int cx = rndRange(100, 379), cy = rndRange(80, 239), rx = rndRange(1, 100), ry = rndRange(1, 80);
+    double angles[16];
+    for (int j = 0; j < count; ++j)
+      angles[j] = (rnd() % 3600) * M_PI / 1800.0;
+    std::sort(angles, angles + count);
+    for (int j = 0; j < count; ++j)
+      points[j] = Point(cx + (int) lround(rx * cos(angles[j])), cy + (int) lround(ry * sin(angles[j])));
+
+    // rounding may have made it concave or self intersecting, where the expected area below is not valid
+    if (!isConvex(points, count))
+      continue;
+    ++tested;
+
+    // signed area (its sign tells which side of horizontal edges is inside), then rows sampling correction
+    double area = 0;
+    for (int j = 0, k = count - 1; j < count; k = j++)
+      area += (double) points[k].X * points[j].Y - (double) points[j].X * points[k].Y;
+    const int orientation = area > 0 ? 1 : (area < 0 ? -1 : 0);
+    double expected = fabs(area) / 2;
+    for (int j = 0, k = count - 1; j < count; k = j++)
+      if (points[j].Y == points[k].Y)
+        expected -= orientation * (points[j].X - points[k].X) / 2.0;
+
+    PolygonEdge edges[16];
+    PolygonEdge * active[16];
+    PolygonRasterizer rasterizer(edges, active);
+    rasterizer.setup(points, count, 0, 0, screen);
+    long solid = 0, coverage = 0;
+    int rows = 0, lastY = INT_MIN;
+    rasterizer.rasterize([&] (int y, int x1, int x2) { solid += x2 - x1 + 1; rows += y != lastY; lastY = y; },
+                         [&] (int y, int x, int c)   { coverage += c;         rows += y != lastY; lastY = y; });
+    const double covered = solid + coverage / 255.0;
+
+    // coverage is truncated to 1/255, at both ends of each row
+    const double error = fabs(covered - expected);
+    maxError = fmax(maxError, error);
+    if (error > 0.5 + rows * 2 / 255.0 && ok) {
+      printf("  polygon %d: %d points, expected %.2f, covered %.2f\n", i, count, expected, covered);
+      for (int j = 0; j < count; ++j)
+        printf("    %d,%d\n", points[j].X, points[j].Y);
+      ok = false;
+    }
+  }
+
+  // large triangle with shallow edges (many pixels per row on each edge), 12800 pixels area
+  const Point tri[3] = { Point(10, 10), Point(200, 60), Point(30, 150) };
+  PolygonEdge edges[3];
+  PolygonEdge * active[3];
+  PolygonRasterizer rasterizer(edges, active);
+  rasterizer.setup(tri, 3, 0, 0, screen);
+  long solid = 0, coverage = 0;
+  rasterizer.rasterize([&] (int y, int x1, int x2) { solid += x2 - x1 + 1; },
+                       [&] (int y, int x, int c)   { coverage += c; });
+
+  const double triangle = solid + coverage / 255.0;
+  ok = ok && fabs(triangle - 12800) < 1.0;
+
+  printf("coverage: triangle %.1f (area 12800), %d convex polygons max error %.2f pixels -> %s\n",
+         triangle, tested, maxError, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+
+static double nowNS()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static volatile uint32_t s_sink;
+
+
+struct SpanSink {
+  uint32_t * sum;
+  void operator()(int y, int x1, int x2) const { *sum += y * 7 + x1 + x2; }
+};
+
+
+// microseconds per polygon
+static double bench(Point const * points, int count, bool previousCode)
+{
+  const Rect screen = Rect(0, 0, 479, 319);
+  const int CALLS = 20000;
+  uint32_t sum = 0;
+  SpanSink sink = { &sum };
+  const double t0 = nowNS();
+  for (int i = 0; i < CALLS; ++i) {
+    if (previousCode)
+      oldFillPath(points, count, 0, 0, screen, sink);
+    else
+      newFillPath(points, count, 0, 0, screen, sink);
+  }
+  const double t1 = nowNS();
+  s_sink += sum;
+  return (t1 - t0) / CALLS / 1000.0;
+}
+
+
+// 480x320 clipping rectangle
+static void benchmark()
+{
+  struct {
+    char const * name;
+    int          count;
+    int          size;
+  } cases[] = {
+    { "triangle 40px",      3,  40 },
+    { "thick line quad",    4, 200 },
+    { "hexagon 200px",      6, 200 },
+    { "16-gon 300px",      16, 300 },
+    { "random 12 points",  12, 400 },
+  };
+
+  printf("benchmark (us per polygon):\n");
+  for (auto & c : cases) {
+    Point points[16];
+    if (c.count == 4) {
+      // 200x200 line with pen width 8
+      points[0] = Point(20, 20);
+      points[1] = Point(26, 14);
+      points[2] = Point(226, 214);
+      points[3] = Point(220, 220);
+    } else {
+      for (int i = 0; i < c.count; ++i) {
+        if (c.name[0] == 'r') {
+          points[i] = Point(40 + rnd() % c.size, rnd() % 300);
+        } else {
+          const double a = 2 * M_PI * i / c.count;
+          points[i] = Point(240 + (int) (c.size / 2 * cos(a)), 160 + (int) (c.size / 2 * sin(a) * 0.75));
+        }
+      }
+    }
+    const double previous = bench(points, c.count, true);
+    const double current  = bench(points, c.count, false);
+    printf("  %-20s previous %7.2f  rasterizer %7.2f  x%.1f\n", c.name, previous, current, previous / current);
+  }
+}
+
+
+int main()
+{
+  bool ok = testSpans();
+  ok = testCoverage() && ok;
+  benchmark();
+  printf(ok ? "PASSED\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -21,6 +21,7 @@
 
 
 #include <stdarg.h>
+#include <string.h>
 
 #include "canvas.h"
 #include "fabfonts.h"
@@ -33,17 +34,362 @@ namespace fabgl {
 
 #define INVALIDRECT Rect(-32768, -32768, -32768, -32768)
 
+// bounds of commands never skipped by Canvas::replay()
+#define DISPLAYLIST_NOBOUNDS Rect(-32768, -32768, 32767, 32767)
+
+#define DISPLAYLIST_INITIAL_CAPACITY 16
+
+
+
+/*************************************************************************************/
+/* DisplayList definitions */
+
+
+DisplayList::DisplayList()
+  : m_items(nullptr),
+    m_count(0),
+    m_capacity(0)
+{
+  beginRecording();
+}
+
+
+DisplayList::~DisplayList()
+{
+  clear();
+  free(m_items);
+}
+
+
+void DisplayList::clear()
+{
+  for (int i = 0; i < m_count; ++i) {
+    Primitive & prim = m_items[i].prim;
+    switch (prim.cmd) {
+      case PrimitiveCmd::DrawPath:
+      case PrimitiveCmd::FillPath:
+        free((void*) prim.path.points);
+        break;
+      case PrimitiveCmd::DrawBitmap:
+        delete prim.bitmapDrawingInfo.bitmap;
+        break;
+      default:
+        break;
+    }
+  }
+  m_count = 0;
+}
+
+
+// the paint state at the beginning of a recording is not known
+void DisplayList::beginRecording()
+{
+  m_origin            = Point(0, 0);
+  m_position          = Point(0, 0);
+  m_penWidth          = -1;
+  m_positionValid     = false;
+  m_clippingRectValid = false;
+  m_glyphOptionsValid = false;
+}
+
+
+void DisplayList::add(Primitive const & prim)
+{
+  if (m_count == m_capacity) {
+    m_capacity = m_capacity ? m_capacity * 2 : DISPLAYLIST_INITIAL_CAPACITY;
+    m_items = (Item*) realloc((void*) m_items, sizeof(Item) * m_capacity);
+  }
+  Item & item = m_items[m_count++];
+  item.prim   = prim;
+  item.bounds = bounds(prim);
+
+  // paths and bitmaps are owned by the list
+  switch (prim.cmd) {
+    case PrimitiveCmd::DrawPath:
+    case PrimitiveCmd::FillPath:
+    {
+      int sz = prim.path.pointsCount * sizeof(Point);
+      Point * points = (Point*) malloc(sz);
+      memcpy(points, prim.path.points, sz);
+      item.prim.path.points     = points;
+      item.prim.path.freePoints = false;
+      break;
+    }
+    case PrimitiveCmd::DrawBitmap:
+    {
+      // native pixels size depends on the display, so they are referenced (Bitmap doesn't own them, even when copy is true)
+      Bitmap const * bitmap = prim.bitmapDrawingInfo.bitmap;
+      const bool copy = bitmap->format != PixelFormat::Native && bitmap->format != PixelFormat::Undefined;
+      item.prim.bitmapDrawingInfo.bitmap = new Bitmap(bitmap->width, bitmap->height, bitmap->data, bitmap->format, bitmap->foregroundColor, copy);
+      break;
+    }
+    default:
+      break;
+  }
+
+  // track paint state (see DisplayController::execPrimitive())
+  switch (prim.cmd) {
+    case PrimitiveCmd::Reset:
+      m_origin             = Point(0, 0);
+      m_position           = Point(0, 0);
+      m_penWidth           = 1;
+      m_glyphOptions.value = 0;
+      m_positionValid      = true;
+      m_clippingRectValid  = false;
+      m_glyphOptionsValid  = true;
+      break;
+    case PrimitiveCmd::SetOrigin:
+      m_origin = prim.position;
+      break;
+    case PrimitiveCmd::SetClippingRect:
+      m_clippingRect      = prim.rect;
+      m_clippingRectValid = true;
+      break;
+    case PrimitiveCmd::SetPenWidth:
+      m_penWidth = imax(1, prim.ivalue);
+      break;
+    case PrimitiveCmd::SetGlyphOptions:
+      m_glyphOptions      = prim.glyphOptions;
+      m_glyphOptionsValid = true;
+      break;
+    case PrimitiveCmd::MoveTo:
+    case PrimitiveCmd::LineTo:
+      m_position      = m_origin.add(prim.position);
+      m_positionValid = true;
+      break;
+    default:
+      break;
+  }
+}
+
+
+// expands a rectangle by current pen width
+Rect DisplayList::penBounds(Rect const & rect)
+{
+  return m_penWidth < 0 ? DISPLAYLIST_NOBOUNDS : rect.shrink(-m_penWidth);
+}
+
+
+// returns the area painted by a drawing command, relative to the list origin. Bounds may be larger than the
+// actual painted area (ie using pen width, glyph options, etc), but never smaller.
+Rect DisplayList::bounds(Primitive const & prim)
+{
+  Rect r;
+  switch (prim.cmd) {
+    case PrimitiveCmd::SetPixel:
+      r = Rect(prim.position.X, prim.position.Y, prim.position.X, prim.position.Y).translate(m_origin);
+      break;
+    case PrimitiveCmd::SetPixelAt:
+      r = Rect(prim.pixelDesc.pos.X, prim.pixelDesc.pos.Y, prim.pixelDesc.pos.X, prim.pixelDesc.pos.Y).translate(m_origin);
+      break;
+    case PrimitiveCmd::LineTo:
+    {
+      Point p = m_origin.add(prim.position);
+      r = m_positionValid ? penBounds(Rect(imin(m_position.X, p.X), imin(m_position.Y, p.Y), imax(m_position.X, p.X), imax(m_position.Y, p.Y))) : DISPLAYLIST_NOBOUNDS;
+      break;
+    }
+    case PrimitiveCmd::FillRect:
+    case PrimitiveCmd::DrawRect:
+    case PrimitiveCmd::InvertRect:
+    case PrimitiveCmd::SwapFGBG:
+      r = Rect(imin(prim.rect.X1, prim.rect.X2), imin(prim.rect.Y1, prim.rect.Y2), imax(prim.rect.X1, prim.rect.X2), imax(prim.rect.Y1, prim.rect.Y2)).translate(m_origin);
+      if (prim.cmd == PrimitiveCmd::DrawRect)
+        r = penBounds(r);
+      break;
+    case PrimitiveCmd::FillEllipse:
+    case PrimitiveCmd::DrawEllipse:
+    {
+      int hw = prim.size.width / 2 + 1;
+      int hh = prim.size.height / 2 + 1;
+      r = m_positionValid ? Rect(m_position.X - hw, m_position.Y - hh, m_position.X + hw, m_position.Y + hh) : DISPLAYLIST_NOBOUNDS;
+      if (prim.cmd == PrimitiveCmd::DrawEllipse)
+        r = penBounds(r);
+      break;
+    }
+    case PrimitiveCmd::DrawGlyph:
+    {
+      // unknown options: assume double width, italic and bold
+      int width = prim.glyph.width;
+      if (!m_glyphOptionsValid || m_glyphOptions.doubleWidth)
+        width *= 2;
+      if (!m_glyphOptionsValid || m_glyphOptions.italic || m_glyphOptions.bold)
+        width += prim.glyph.height + 1;
+      r = Rect(prim.glyph.X, prim.glyph.Y, prim.glyph.X + width - 1, prim.glyph.Y + prim.glyph.height - 1).translate(m_origin);
+      break;
+    }
+    case PrimitiveCmd::DrawBitmap:
+    {
+      Bitmap const * bitmap = prim.bitmapDrawingInfo.bitmap;
+      r = Rect(prim.bitmapDrawingInfo.X, prim.bitmapDrawingInfo.Y, prim.bitmapDrawingInfo.X + bitmap->width - 1, prim.bitmapDrawingInfo.Y + bitmap->height - 1).translate(m_origin);
+      break;
+    }
+    case PrimitiveCmd::CopyRect:
+      // destination is current position
+      r = m_positionValid ? Rect(m_position.X, m_position.Y, m_position.X + prim.rect.width() - 1, m_position.Y + prim.rect.height() - 1) : DISPLAYLIST_NOBOUNDS;
+      break;
+    case PrimitiveCmd::DrawPath:
+    case PrimitiveCmd::FillPath:
+    {
+      if (prim.path.pointsCount == 0)
+        return DISPLAYLIST_NOBOUNDS;
+      Point const * points = prim.path.points;
+      r = Rect(points[0].X, points[0].Y, points[0].X, points[0].Y);
+      for (int i = 1; i < prim.path.pointsCount; ++i)
+        r = r.merge(Rect(points[i].X, points[i].Y, points[i].X, points[i].Y));
+      r = r.translate(m_origin);
+      if (prim.cmd == PrimitiveCmd::DrawPath)
+        r = penBounds(r);
+      break;
+    }
+    default:
+      // state changes and commands painting the whole viewport or a scrolling region
+      return DISPLAYLIST_NOBOUNDS;
+  }
+  if (m_clippingRectValid)
+    r = r.intersection(m_clippingRect.translate(m_origin));
+  return r;
+}
+
+
+
+/*************************************************************************************/
+/* Canvas definitions */
+
 
 Canvas::Canvas(DisplayController * displayController)
   : m_displayController(displayController),
     m_fontInfo(nullptr),
     m_textHorizRate(1),
     m_origin(Point(0, 0)),
-    m_clippingRect(INVALIDRECT)
+    m_clippingRect(INVALIDRECT),
+    m_recording(nullptr)
 {
 }
 
 
+void Canvas::addPrimitive(Primitive & p)
+{
+  if (m_recording)
+    m_recording->add(p);
+  else
+    m_displayController->addPrimitive(p);
+}
+
+
+void Canvas::beginRecording(DisplayList * list)
+{
+  list->clear();
+  list->beginRecording();
+  m_savedOrigin        = m_origin;
+  m_savedClippingRect  = m_clippingRect;
+  m_savedTextHorizRate = m_textHorizRate;
+  m_origin             = Point(0, 0);
+  m_clippingRect       = INVALIDRECT;
+  m_recording          = list;
+}
+
+
+void Canvas::endRecording()
+{
+  m_recording     = nullptr;
+  m_origin        = m_savedOrigin;
+  m_clippingRect  = m_savedClippingRect;
+  m_textHorizRate = m_savedTextHorizRate;
+}
+
+
+// sends intersection of "clipRect" (list coordinates) and the clipping rectangle set by the list (relative to "listOrigin")
+void Canvas::sendClippingRect(Rect const & clipRect, Point const & listOrigin, Rect const * listClippingRect)
+{
+  Primitive p;
+  p.cmd  = PrimitiveCmd::SetClippingRect;
+  p.rect = clipRect.translate(listOrigin.neg());
+  if (listClippingRect)
+    p.rect = p.rect.intersection(*listClippingRect);
+  m_displayController->addPrimitive(p);
+}
+
+
+void Canvas::replay(DisplayList const & list, int X, int Y)
+{
+  replay(list, X, Y, getClippingRect());
+}
+
+
+void Canvas::replay(DisplayList const & list, int X, int Y, Rect const & clipRect)
+{
+  if (m_recording) {
+    // replay inside a recording is not supported
+    return;
+  }
+
+  Point base      = m_origin.add(Point(X, Y));
+  Rect  listClip  = clipRect.intersection(getClippingRect()).translate(-X, -Y);   // list coordinates
+  Point listOrigin;
+  Rect  listClippingRect;
+  bool  listClippingRectValid = false;
+
+  Primitive p;
+  p.cmd      = PrimitiveCmd::SetOrigin;
+  p.position = base;
+  m_displayController->addPrimitive(p);
+  sendClippingRect(listClip, listOrigin, nullptr);
+
+  for (int i = 0; i < list.m_count; ++i) {
+    DisplayList::Item const & item = list.m_items[i];
+    p = item.prim;
+    switch (p.cmd) {
+
+      case PrimitiveCmd::Reset:
+        // reset paint state, then restore list origin and clipping
+        m_displayController->addPrimitive(p);
+        listOrigin            = Point(0, 0);
+        listClippingRectValid = false;
+        p.cmd      = PrimitiveCmd::SetOrigin;
+        p.position = base;
+        m_displayController->addPrimitive(p);
+        p.cmd      = PrimitiveCmd::MoveTo;
+        p.position = Point(0, 0);
+        m_displayController->addPrimitive(p);
+        sendClippingRect(listClip, listOrigin, nullptr);
+        break;
+
+      case PrimitiveCmd::SetOrigin:
+        listOrigin = p.position;
+        p.position = base.add(listOrigin);
+        m_displayController->addPrimitive(p);
+        sendClippingRect(listClip, listOrigin, listClippingRectValid ? &listClippingRect : nullptr);
+        break;
+
+      case PrimitiveCmd::SetClippingRect:
+        listClippingRect      = p.rect;
+        listClippingRectValid = true;
+        sendClippingRect(listClip, listOrigin, &listClippingRect);
+        break;
+
+      default:
+        if (!item.bounds.intersects(listClip)) {
+          // skip the command, but keep current position updated
+          if (p.cmd != PrimitiveCmd::LineTo)
+            break;
+          p.cmd = PrimitiveCmd::MoveTo;
+        }
+        m_displayController->addPrimitive(p);
+        break;
+
+    }
+  }
+
+  // restore canvas origin and clipping rectangle
+  p.cmd      = PrimitiveCmd::SetOrigin;
+  p.position = m_origin;
+  m_displayController->addPrimitive(p);
+  p.cmd  = PrimitiveCmd::SetClippingRect;
+  p.rect = getClippingRect();
+  m_displayController->addPrimitive(p);
+}
+
+
 void Canvas::setOrigin(int X, int Y)
 {
   setOrigin(Point(X, Y));
@@ -55,7 +401,7 @@ void Canvas::setOrigin(Point const & origin)
   Primitive p;
   p.cmd      = PrimitiveCmd::SetOrigin;
   p.position = m_origin = origin;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -64,7 +410,7 @@ void Canvas::setClippingRect(Rect const & rect)
   Primitive p;
   p.cmd  = PrimitiveCmd::SetClippingRect;
   p.rect = m_clippingRect = rect;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -106,7 +452,7 @@ void Canvas::clear()
   Primitive p;
   p.cmd = PrimitiveCmd::Clear;
   p.ivalue = 0;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -114,7 +460,7 @@ void Canvas::reset()
 {
   Primitive p;
   p.cmd = PrimitiveCmd::Reset;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -124,12 +470,12 @@ void Canvas::scroll(int offsetX, int offsetY)
   if (offsetY != 0) {
     p.cmd    = PrimitiveCmd::VScroll;
     p.ivalue = offsetY;
-    m_displayController->addPrimitive(p);
+    addPrimitive(p);
   }
   if (offsetX != 0) {
     p.cmd    = PrimitiveCmd::HScroll;
     p.ivalue = offsetX;
-    m_displayController->addPrimitive(p);
+    addPrimitive(p);
   }
 }
 
@@ -139,7 +485,7 @@ void Canvas::setScrollingRegion(int X1, int Y1, int X2, int Y2)
   Primitive p;
   p.cmd  = PrimitiveCmd::SetScrollingRegion;
   p.rect = Rect(X1, Y1, X2, Y2);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -148,7 +494,7 @@ void Canvas::setPixel(int X, int Y)
   Primitive p;
   p.cmd      = PrimitiveCmd::SetPixel;
   p.position = Point(X, Y);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -163,7 +509,7 @@ void Canvas::setPixel(Point const & pos, RGB888 const & color)
   Primitive p;
   p.cmd       = PrimitiveCmd::SetPixelAt;
   p.pixelDesc = { pos, color };
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -172,7 +518,7 @@ void Canvas::moveTo(int X, int Y)
   Primitive p;
   p.cmd      = PrimitiveCmd::MoveTo;
   p.position = Point(X, Y);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -193,7 +539,7 @@ void Canvas::setPenColor(RGB888 const & color)
   Primitive p;
   p.cmd = PrimitiveCmd::SetPenColor;
   p.color = color;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -214,7 +560,7 @@ void Canvas::setPenWidth(int value)
   Primitive p;
   p.cmd = PrimitiveCmd::SetPenWidth;
   p.ivalue = value;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -223,7 +569,7 @@ void Canvas::setLineEnds(LineEnds value)
   Primitive p;
   p.cmd = PrimitiveCmd::SetLineEnds;
   p.lineEnds = value;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -232,7 +578,7 @@ void Canvas::setBrushColor(RGB888 const & color)
   Primitive p;
   p.cmd = PrimitiveCmd::SetBrushColor;
   p.color = color;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -241,7 +587,7 @@ void Canvas::lineTo(int X, int Y)
   Primitive p;
   p.cmd      = PrimitiveCmd::LineTo;
   p.position = Point(X, Y);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -257,7 +603,7 @@ void Canvas::drawRectangle(int X1, int Y1, int X2, int Y2)
   Primitive p;
   p.cmd  = PrimitiveCmd::DrawRect;
   p.rect = Rect(X1, Y1, X2, Y2);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -272,7 +618,7 @@ void Canvas::fillRectangle(int X1, int Y1, int X2, int Y2)
   Primitive p;
   p.cmd  = PrimitiveCmd::FillRect;
   p.rect = Rect(X1, Y1, X2, Y2);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -281,7 +627,7 @@ void Canvas::fillRectangle(Rect const & rect)
   Primitive p;
   p.cmd  = PrimitiveCmd::FillRect;
   p.rect = rect;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -296,7 +642,7 @@ void Canvas::invertRectangle(Rect const & rect)
   Primitive p;
   p.cmd  = PrimitiveCmd::InvertRect;
   p.rect = rect;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -305,7 +651,7 @@ void Canvas::swapRectangle(int X1, int Y1, int X2, int Y2)
   Primitive p;
   p.cmd  = PrimitiveCmd::SwapFGBG;
   p.rect = Rect(X1, Y1, X2, Y2);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -315,7 +661,7 @@ void Canvas::fillEllipse(int X, int Y, int width, int height)
   Primitive p;
   p.cmd  = PrimitiveCmd::FillEllipse;
   p.size = Size(width, height);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -325,7 +671,7 @@ void Canvas::drawEllipse(int X, int Y, int width, int height)
   Primitive p;
   p.cmd  = PrimitiveCmd::DrawEllipse;
   p.size = Size(width, height);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -334,7 +680,7 @@ void Canvas::drawGlyph(int X, int Y, int width, int height, uint8_t const * data
   Primitive p;
   p.cmd   = PrimitiveCmd::DrawGlyph;
   p.glyph = Glyph(X, Y, width, height, data + index * height * ((width + 7) / 8));
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -343,7 +689,7 @@ void Canvas::renderGlyphsBuffer(int itemX, int itemY, GlyphsBuffer const * glyph
   Primitive p;
   p.cmd                    = PrimitiveCmd::RenderGlyphsBuffer;
   p.glyphsBufferRenderInfo = GlyphsBufferRenderInfo(itemX, itemY, glyphsBuffer);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -352,7 +698,7 @@ void Canvas::setGlyphOptions(GlyphOptions options)
   Primitive p;
   p.cmd = PrimitiveCmd::SetGlyphOptions;
   p.glyphOptions = options;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
   m_textHorizRate = options.doubleWidth > 0 ? 2 : 1;
 }
 
@@ -368,7 +714,7 @@ void Canvas::setPaintOptions(PaintOptions options)
   Primitive p;
   p.cmd = PrimitiveCmd::SetPaintOptions;
   p.paintOptions = options;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -485,7 +831,7 @@ void Canvas::copyRect(int sourceX, int sourceY, int destX, int destY, int width,
   Primitive p;
   p.cmd  = PrimitiveCmd::CopyRect;
   p.rect = Rect(sourceX, sourceY, sourceX2, sourceY2);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -494,7 +840,16 @@ void Canvas::drawBitmap(int X, int Y, Bitmap const * bitmap)
   Primitive p;
   p.cmd               = PrimitiveCmd::DrawBitmap;
   p.bitmapDrawingInfo = BitmapDrawingInfo(X, Y, bitmap);
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
+}
+
+
+void Canvas::drawTileMap(TileMap * tileMap, int scrollX, int scrollY)
+{
+  Primitive p;
+  p.cmd                = PrimitiveCmd::DrawTileMap;
+  p.tileMapDrawingInfo = TileMapDrawingInfo(scrollX, scrollY, tileMap);
+  addPrimitive(p);
 }
 
 
@@ -515,7 +870,7 @@ void Canvas::drawPath(Point const * points, int pointsCount)
   p.path.points = points;
   p.path.pointsCount = pointsCount;
   p.path.freePoints = false;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -526,7 +881,7 @@ void Canvas::fillPath(Point const * points, int pointsCount)
   p.path.points = points;
   p.path.pointsCount = pointsCount;
   p.path.freePoints = false;
-  m_displayController->addPrimitive(p);
+  addPrimitive(p);
 }
 
 
@@ -41,6 +41,82 @@ namespace fabgl {
 
 
 
+/**
+* @brief A recorded sequence of drawing commands.
+*
+* A display list is filled by Canvas.beginRecording() and Canvas.endRecording(), then painted with Canvas.replay(), any number of times
+* and at any position. Paths and bitmaps are copied inside the list, while glyphs data, glyphs buffers and pixels of PixelFormat::Native
+* bitmaps are only referenced, so they must live as long as the list.<br>
+* Each drawing command keeps its bounding box, so a replay skips commands that are fully outside of the clipping rectangle.
+*
+* Example:
+*
+*     fabgl::DisplayList scoreBar;
+*     Canvas.beginRecording(&scoreBar);
+*     Canvas.setBrushColor(Color::Blue);
+*     Canvas.fillRectangle(0, 0, 319, 15);
+*     Canvas.drawText(4, 4, "SCORE");
+*     Canvas.endRecording();
+*
+*     // every frame
+*     Canvas.replay(scoreBar, 0, 0);
+*/
+class DisplayList {
+
+public:
+
+  DisplayList();
+
+  ~DisplayList();
+
+  DisplayList(DisplayList const&) = delete;
+  void operator=(DisplayList const&) = delete;
+
+  /**
+   * @brief Removes all commands and releases copied paths and bitmaps.
+   *
+   * Commands already sent by Canvas.replay() may still reference the list, so call Canvas.waitCompletion() before clearing it.
+   */
+  void clear();
+
+  /**
+   * @brief Determines number of recorded commands.
+   *
+   * @return Number of recorded commands.
+   */
+  int count() const { return m_count; }
+
+private:
+
+  friend class Canvas;
+
+  struct Item {
+    Primitive prim;
+    Rect      bounds;   // painted area, relative to the list origin
+  };
+
+  void beginRecording();
+  void add(Primitive const & prim);
+  Rect bounds(Primitive const & prim);
+  Rect penBounds(Rect const & rect);
+
+  Item *       m_items;
+  int          m_count;
+  int          m_capacity;
+
+  // paint state tracked while recording, to calculate bounds
+  Point        m_origin;
+  Point        m_position;
+  Rect         m_clippingRect;
+  int16_t      m_penWidth;         // -1 = unknown
+  bool         m_positionValid;
+  bool         m_clippingRectValid;
+  bool         m_glyphOptionsValid;
+  GlyphOptions m_glyphOptions;
+};
+
+
+
 /**
 * @brief A class with a set of drawing methods.
 *
@@ -712,6 +788,25 @@ public:
    */
   void drawBitmap(int X, int Y, Bitmap const * bitmap);
 
+  /**
+   * @brief Draws a tile map inside its rectangle.
+   *
+   * The map pixel at scrollX, scrollY is shown at the top-left corner of the tile map rectangle, the map wraps around.
+   * When the tile map has been already drawn, and just the scroll position has changed, the pixels on the screen are
+   * moved and only the uncovered tiles are drawn. Full width vertical scrolling is performed by the display, when
+   * supported (see TFTController.enableHardwareScrolling()).
+   *
+   * @param tileMap Pointer to the tile map, which must remain valid until drawn.
+   * @param scrollX Horizontal map position, in pixels.
+   * @param scrollY Vertical map position, in pixels.
+   *
+   * Example:
+   *
+   *     // scroll the map one pixel to the right at each frame
+   *     Canvas.drawTileMap(&tileMap, frame, 0);
+   */
+  void drawTileMap(TileMap * tileMap, int scrollX, int scrollY);
+
   /**
    * @brief Draws a sequence of lines.
    *
@@ -730,7 +825,7 @@ public:
    * @brief Fills the polygon enclosed in a sequence of lines.
    *
    * @param points A pointer to an array of Point objects. Points array is copied to a temporary buffer.
-   * @param pointsCount Number of points in the array.
+   * @param pointsCount Number of points in the array. On VGA at most FABGLIB_POLYGON_EDGES points are filled in background.
    *
    * Example:
    *
@@ -740,6 +835,66 @@ public:
    */
   void fillPath(Point const * points, int pointsCount);
 
+  /**
+   * @brief Starts recording drawing commands into a display list.
+   *
+   * Until endRecording() is called drawing methods are not executed, they are appended to the specified list instead. Coordinates
+   * are relative to the list origin, which is moved where specified by replay(). The list is cleared before recording.<br>
+   * swapBuffers(), reading and waiting methods are never recorded.
+   *
+   * @param list The display list to fill.
+   *
+   * Example:
+   *
+   *     fabgl::DisplayList frame;
+   *     Canvas.beginRecording(&frame);
+   *     Canvas.setPenColor(Color::BrightWhite);
+   *     Canvas.drawRectangle(0, 0, 99, 49);
+   *     Canvas.endRecording();
+   */
+  void beginRecording(DisplayList * list);
+
+  /**
+   * @brief Stops recording started with beginRecording().
+   *
+   * Canvas origin, clipping rectangle and text width are restored as before recording.
+   */
+  void endRecording();
+
+  /**
+   * @brief Determines whether drawing commands are being recorded.
+   *
+   * @return True if inside beginRecording() and endRecording().
+   */
+  bool isRecording() { return m_recording != nullptr; }
+
+  /**
+   * @brief Paints a display list.
+   *
+   * Commands of the list are executed with origin moved to the specified position. They are clipped to the current clipping
+   * rectangle and commands painting outside of it are skipped.<br>
+   * Pen, brush and other paint options set inside the list remain in effect after the replay, while origin and clipping
+   * rectangle are restored. Scrolling region is not translated.
+   *
+   * @param list The display list to paint.
+   * @param X Horizontal position of the list origin, relative to the canvas origin.
+   * @param Y Vertical position of the list origin, relative to the canvas origin.
+   */
+  void replay(DisplayList const & list, int X = 0, int Y = 0);
+
+  /**
+   * @brief Paints the part of a display list inside a rectangle.
+   *
+   * Like replay(DisplayList const &, int, int), but commands are clipped to the specified rectangle and only commands
+   * intersecting it are executed. Use it to repaint just the invalidated area of a static screen decoration.
+   *
+   * @param list The display list to paint.
+   * @param X Horizontal position of the list origin, relative to the canvas origin.
+   * @param Y Vertical position of the list origin, relative to the canvas origin.
+   * @param clipRect Clipping rectangle, relative to the canvas origin.
+   */
+  void replay(DisplayList const & list, int X, int Y, Rect const & clipRect);
+
   /**
    * @brief Reads the pixel at specified position.
    *
@@ -755,6 +910,9 @@ public:
 
 private:
 
+  void addPrimitive(Primitive & p);
+  void sendClippingRect(Rect const & clipRect, Point const & listOrigin, Rect const * listClippingRect);
+
   DisplayController * m_displayController;
 
   FontInfo const *    m_fontInfo;
@@ -762,6 +920,12 @@ private:
 
   Point               m_origin;
   Rect                m_clippingRect;
+
+  // recording (see beginRecording())
+  DisplayList *       m_recording;
+  Point               m_savedOrigin;
+  Rect                m_savedClippingRect;
+  uint8_t             m_savedTextHorizRate;
 };
 
 
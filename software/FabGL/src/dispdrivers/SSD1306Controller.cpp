@@ -373,13 +373,22 @@ void SSD1306Controller::updateTaskFunc(void * pvParameters)
 
     ctrl->waitForPrimitives();
 
-    // primitive processing blocked?
-    if (ctrl->m_updateTaskFuncSuspended > 0)
-      ulTaskNotifyTake(true, portMAX_DELAY); // yes, wait for a notify
-
+    // set before checking m_updateTaskFuncSuspended: suspendBackgroundPrimitiveExecution() does the opposite,
+    // so either this task sees the suspension or the suspending task waits for this one to complete
     ctrl->m_updateTaskRunning = true;
+    __sync_synchronize();
+
+    // primitive processing blocked?
+    if (ctrl->m_updateTaskFuncSuspended > 0) {
+      ctrl->m_updateTaskRunning = false;
+      // loop because also new primitives notify this task
+      while (ctrl->m_updateTaskFuncSuspended > 0)
+        ulTaskNotifyTake(true, portMAX_DELAY); // yes, wait for a notify
+      // primitives may have been executed by processPrimitives() meanwhile
+      continue;
+    }
 
-    Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+    DirtyRegion dirtyRegion;
 
     int64_t startTime = ctrl->backgroundPrimitiveTimeoutEnabled() ? esp_timer_get_time() : 0;
     do {
@@ -388,19 +397,21 @@ void SSD1306Controller::updateTaskFunc(void * pvParameters)
       if (ctrl->getPrimitive(&prim) == false)
         break;
 
-      ctrl->execPrimitive(prim, updateRect, false);
+      ctrl->execPrimitive(prim, dirtyRegion, false);
 
       if (ctrl->m_updateTaskFuncSuspended > 0)
         break;
 
     } while (!ctrl->backgroundPrimitiveTimeoutEnabled() || (startTime + SSD1306_BACKGROUND_PRIMITIVE_TIMEOUT > esp_timer_get_time()));
 
-    ctrl->showSprites(updateRect);
+    ctrl->showSprites(dirtyRegion);
 
     ctrl->m_updateTaskRunning = false;
 
-    if (!ctrl->isDoubleBuffered())
-      ctrl->SSD1306_sendScreenBuffer(updateRect);
+    if (!ctrl->isDoubleBuffered()) {
+      for (int i = 0; i < dirtyRegion.count(); ++i)
+        ctrl->SSD1306_sendScreenBuffer(dirtyRegion[i]);
+    }
   }
 }
 
@@ -409,6 +420,7 @@ void SSD1306Controller::updateTaskFunc(void * pvParameters)
 void SSD1306Controller::suspendBackgroundPrimitiveExecution()
 {
   ++m_updateTaskFuncSuspended;
+  __sync_synchronize();
   while (m_updateTaskRunning)
     taskYIELD();
 }
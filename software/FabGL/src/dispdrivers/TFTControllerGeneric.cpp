@@ -42,6 +42,15 @@
 #define TFT_SPI_MODE                     SPI_MODE3
 #define TFT_DMACHANNEL                   2
 
+// maximum size (in bytes) of each DMA buffer. Each buffer contains as many full rows as possible.
+#define TFT_DMA_BUFFER_SIZE              8192
+
+// maximum size (in bytes) of a transaction when the SPI bus has been initialized by another driver with default max_transfer_sz
+#define TFT_SPI_DEFAULT_TRANSFER_SIZE    4092
+
+// size (in pixels) of the square tiles compared by swapBuffers() on double buffering
+#define TFT_TILE_SIZE                    16
+
 
 
 
@@ -99,6 +108,12 @@ TFTController::TFTController()
   : m_spi(nullptr),
     m_SPIDevHandle(nullptr),
     m_viewPort(nullptr),
+    m_viewPortVisible(nullptr),
+    m_viewPortLayout(TFTViewPortLayout::Rows),
+    m_viewPortStride(0),
+    m_dmaBuffer(),
+    m_dmaRows(0),
+    m_maxTransferSize(TFT_DMA_BUFFER_SIZE),
     m_controllerWidth(240),
     m_controllerHeight(320),
     m_rotOffsetX(0),
@@ -106,7 +121,46 @@ TFTController::TFTController()
     m_updateTaskHandle(nullptr),
     m_updateTaskRunning(false),
     m_orientation(TFTOrientation::Rotate0),
-    m_reverseHorizontal(false)
+    m_reverseHorizontal(false),
+    m_canonicalViewPort(false),
+    m_DMAPipeline(true),
+    m_hwScroll(false),
+    m_hwScrollY1(0),
+    m_hwScrollY2(-1),
+    m_hwScrollOffset(0),
+    m_tileHash(nullptr),
+    m_tileRowHash(nullptr),
+    m_tileDirty(nullptr),
+    m_tileHashValid(false),
+    m_framePending(false),
+    m_tileCacheSize(0),
+    m_tileCacheActive(false),
+    m_tileCacheMem(nullptr),
+    m_tileCacheSlot(nullptr),
+    m_tileCacheClock(0),
+    m_tileCacheStats(),
+    m_parallel(false),
+    m_bandTaskHandle(),
+    m_bandsDone(nullptr),
+    m_batchCount(0),
+    m_bitmapCacheBudget(0),
+    m_bitmapCacheUsed(0),
+    m_bitmapCacheCount(0),
+    m_bitmapCacheClock(0),
+    m_bitmapCacheStats(),
+    m_glyphTable(),
+    m_composeItems(nullptr),
+    m_composeCapacity(0),
+    m_composeCount(0),
+    m_composePixels(0),
+    m_composeTime(0),
+    m_composeStats(),
+    m_glyphCacheBudget(0),
+    m_glyphCacheUsed(0),
+    m_glyphCache(),
+    m_glyphCacheNewest(nullptr),
+    m_glyphCacheOldest(nullptr),
+    m_glyphCacheStats()
 {
 }
 
@@ -184,6 +238,26 @@ void TFTController::end()
     vTaskDelete(m_updateTaskHandle);
   m_updateTaskHandle = nullptr;
 
+  m_parallel = false;
+  m_batchCount = 0;
+  for (int i = 0; i < portNUM_PROCESSORS; ++i) {
+    if (m_bandTaskHandle[i])
+      vTaskDelete(m_bandTaskHandle[i]);
+    m_bandTaskHandle[i] = nullptr;
+  }
+  if (m_bandsDone)
+    vSemaphoreDelete(m_bandsDone);
+  m_bandsDone = nullptr;
+
+  while (m_bitmapCacheCount > 0)
+    bitmapCacheRemove(m_bitmapCacheCount - 1);
+  clearGlyphCache();
+
+  free(m_composeItems);
+  m_composeItems    = nullptr;
+  m_composeCapacity = 0;
+  m_composeCount    = 0;
+
   freeViewPort();
 
   SPIEnd();
@@ -270,13 +344,31 @@ void TFTController::setupOrientation()
   freeViewPort();
   m_viewPortWidth  = m_rot0ViewPortWidth;
   m_viewPortHeight = m_rot0ViewPortHeight;
+  if (m_orientation == TFTOrientation::Rotate90 || m_orientation == TFTOrientation::Rotate270)
+    tswap(m_viewPortWidth, m_viewPortHeight);
+
+  writeOrientation();
+  
+  // alloc viewport
+  allocViewPort();
+  
+  // resets scrolling region, clipping rect, etc...
+  Primitive p;
+  p.cmd = PrimitiveCmd::Reset;
+  addPrimitive(p);
+}
+
+
+// Sends Memory Access Control and sets the address window offsets for current orientation and viewport size
+// SPIBeginWrite() must be called before
+void TFTController::writeOrientation()
+{
   m_rotOffsetX = 0;
   m_rotOffsetY = 0;
   uint8_t MX = m_reverseHorizontal ? 0x40 : 0;
   uint8_t madclt = 0x08 | MX;    // BGR
   switch (m_orientation) {
     case TFTOrientation::Rotate90:
-      tswap(m_viewPortWidth, m_viewPortHeight);
       madclt |= 0x20;            // MV = 1
       madclt ^= 0x40;            // inv MX
       break;
@@ -287,7 +379,6 @@ void TFTController::setupOrientation()
       m_rotOffsetX = m_controllerWidth - m_viewPortWidth;
       break;
     case TFTOrientation::Rotate270:
-      tswap(m_viewPortWidth, m_viewPortHeight);
       madclt |= 0x20 | 0x80;     // MV = 1, MY = 1
       //m_rotOffsetX = m_controllerHeight - m_viewPortWidth;
       m_rotOffsetX = m_controllerHeight - m_viewPortHeight;
@@ -295,18 +386,21 @@ void TFTController::setupOrientation()
     default:
       break;
   }
-  
+
   // Memory Access Control
   writeCommand(TFT_MADCTL);
   writeByte(madclt);
-  
-  // alloc viewport
-  allocViewPort();
-  
-  // resets scrolling region, clipping rect, etc...
-  Primitive p;
-  p.cmd = PrimitiveCmd::Reset;
-  addPrimitive(p);
+
+  resetHardwareScroll();
+}
+
+
+// true when current viewport fits the screen rotated by "value"
+bool TFTController::viewPortFitsOrientation(TFTOrientation value)
+{
+  const bool swapped = value == TFTOrientation::Rotate90 || value == TFTOrientation::Rotate270;
+  return m_viewPortWidth  <= (swapped ? m_screenHeight : m_screenWidth) &&
+         m_viewPortHeight <= (swapped ? m_screenWidth : m_screenHeight);
 }
 
 
@@ -314,12 +408,40 @@ void TFTController::setOrientation(TFTOrientation value, bool force)
 {
   if (m_orientation != value || force) {
     suspendBackgroundPrimitiveExecution();
+    // canonical viewport: the display rotates the content, viewport and paint state are kept
+    const bool keep = m_canonicalViewPort && m_viewPort && viewPortFitsOrientation(value);
     m_orientation = value;
     SPIBeginWrite();
-    setupOrientation();
+    if (keep) {
+      writeOrientation();
+      // refresh doesn't send the front buffer, send it now
+      if (isDoubleBuffered())
+        writeScreenRect(Rect(0, 0, m_viewPortWidth - 1, m_viewPortHeight - 1), m_viewPortVisible);
+    } else
+      setupOrientation();
     SPIEndWrite();
     resumeBackgroundPrimitiveExecution();
-    sendRefresh();
+    if (!keep || !isDoubleBuffered())
+      sendRefresh();
+  }
+}
+
+
+void TFTController::setViewPortLayout(TFTViewPortLayout value)
+{
+  if (value != m_viewPortLayout) {
+    if (m_viewPort) {
+      // viewport must be freed using the old layout
+      suspendBackgroundPrimitiveExecution();
+      freeViewPort();
+      m_viewPortLayout = value;
+      SPIBeginWrite();
+      setupOrientation();  // reallocates viewport
+      SPIEndWrite();
+      resumeBackgroundPrimitiveExecution();
+      sendRefresh();
+    } else
+      m_viewPortLayout = value;
   }
 }
 
@@ -344,15 +466,18 @@ void TFTController::SPIBegin()
   busconf.quadwp_io_num   = -1;
   busconf.quadhd_io_num   = -1;
   busconf.flags           = SPICOMMON_BUSFLAG_MASTER;
+  busconf.max_transfer_sz = TFT_DMA_BUFFER_SIZE;
   auto r = spi_bus_initialize(m_SPIHost, &busconf, TFT_DMACHANNEL);
   if (r == ESP_OK || r == ESP_ERR_INVALID_STATE) {  // ESP_ERR_INVALID_STATE, maybe spi_bus_initialize already called
+    // a bus initialized by another driver keeps its max_transfer_sz, assume the default one
+    m_maxTransferSize = r == ESP_OK ? TFT_DMA_BUFFER_SIZE : TFT_SPI_DEFAULT_TRANSFER_SIZE;
     spi_device_interface_config_t devconf;
     memset(&devconf, 0, sizeof(devconf));
     devconf.mode           = TFT_SPI_MODE;
     devconf.clock_speed_hz = TFT_SPI_WRITE_FREQUENCY;
     devconf.spics_io_num   = -1;
     devconf.flags          = SPI_DEVICE_HALFDUPLEX;
-    devconf.queue_size     = 1;
+    devconf.queue_size     = TFT_DMA_BUFFERS;
     spi_bus_add_device(m_SPIHost, &devconf, &m_SPIDevHandle);
   }
 
@@ -505,50 +630,372 @@ void TFTController::sendRefresh()
 
 void TFTController::sendScreenBuffer(Rect updateRect)
 {
+  prepareComposition();
+  SPIBeginWrite();
+  writeScreenRect(updateRect, m_viewPort);
+  SPIEndWrite();
+  endComposition();
+}
+
+
+// sends all rectangles of the region inside a single SPI transaction
+void TFTController::sendScreenBuffer(DirtyRegion const & dirtyRegion)
+{
+  prepareComposition();
   SPIBeginWrite();
+  for (int i = 0; i < dirtyRegion.count(); ++i)
+    writeScreenRect(dirtyRegion[i], m_viewPort);
+  SPIEndWrite();
+  endComposition();
+}
+
 
+// sends rows of "source" (m_viewPort or m_viewPortVisible)
+// SPIBeginWrite() must be called before
+void TFTController::writeScreenRect(Rect updateRect, uint16_t * * source)
+{
   updateRect = updateRect.intersection(Rect(0, 0, m_viewPortWidth - 1, m_viewPortHeight - 1));
+  if (updateRect.X1 > updateRect.X2 || updateRect.Y1 > updateRect.Y2)
+    return;
+
+  if (m_hwScrollOffset == 0) {
+    writeScreenWindow(updateRect, updateRect.Y1, source);
+    return;
+  }
 
+  // hardware scrolling: rows inside the scroll area are stored rotated by m_hwScrollOffset rows, so the rectangle
+  // is split in the rows above the area, the rows inside it (before and after the wrap around) and the rows below
+  const int areaY1  = m_hwScrollY1;
+  const int areaY2  = m_hwScrollY2;
+  const int areaH   = areaY2 - areaY1 + 1;
+  const int X1      = updateRect.X1;
+  const int X2      = updateRect.X2;
+  int y = updateRect.Y1;
+  if (y < areaY1) {
+    const int y2 = tmin<int>(updateRect.Y2, areaY1 - 1);
+    writeScreenWindow(Rect(X1, y, X2, y2), y, source);
+    y = y2 + 1;
+  }
+  while (y <= updateRect.Y2 && y <= areaY2) {
+    const int screenY = areaY1 + (y - areaY1 + m_hwScrollOffset) % areaH;
+    const int y2 = tmin<int>(tmin<int>(updateRect.Y2, areaY2), y + areaY2 - screenY);
+    writeScreenWindow(Rect(X1, y, X2, y2), screenY, source);
+    y = y2 + 1;
+  }
+  if (y <= updateRect.Y2)
+    writeScreenWindow(Rect(X1, y, X2, updateRect.Y2), y, source);
+}
+
+
+// sends rows rect.Y1...rect.Y2 of "source" to the display rows starting at screenY
+// SPIBeginWrite() must be called before
+void TFTController::writeScreenWindow(Rect const & rect, int screenY, uint16_t * * source)
+{
   // Column Address Set
   writeCommand(TFT_CASET);
-  writeWord(m_rotOffsetX + updateRect.X1);   // XS (X Start)
-  writeWord(m_rotOffsetX + updateRect.X2);   // XE (X End)
+  writeWord(m_rotOffsetX + rect.X1);   // XS (X Start)
+  writeWord(m_rotOffsetX + rect.X2);   // XE (X End)
 
   // Row Address Set
   writeCommand(TFT_RASET);
-  writeWord(m_rotOffsetY + updateRect.Y1);  // YS (Y Start)
-  writeWord(m_rotOffsetY + updateRect.Y2);  // YE (Y End)
+  writeWord(m_rotOffsetY + screenY);                    // YS (Y Start)
+  writeWord(m_rotOffsetY + screenY + rect.height() - 1);  // YE (Y End)
 
   writeCommand(TFT_RAMWR);
-  const int width = updateRect.width();
-  for (int row = updateRect.Y1; row <= updateRect.Y2; ++row) {
-    memcpy(m_dmaBuffer, m_viewPort[row] + updateRect.X1, sizeof(uint16_t) * width);
-    writeData(m_dmaBuffer, sizeof(uint16_t) * width);
+  const int width = rect.width();
+  if (m_SPIDevHandle && m_DMAPipeline) {
+    writeScreenRows(source, rect.X1, rect.Y1, rect.Y2, width);
+  } else {
+    for (int row = rect.Y1; row <= rect.Y2; ++row) {
+      memcpy(m_dmaBuffer[0], residentRow(source, row) + rect.X1, sizeof(uint16_t) * width);
+      if (m_composeCount > 0 && source == m_viewPort)
+        composeSprites(m_dmaBuffer[0], rect.X1, row, 1, width);
+      writeData(m_dmaBuffer[0], sizeof(uint16_t) * width);
+    }
   }
+}
 
-  SPIEndWrite();
+
+// Copies several rows at the time into the DMA buffers and queues them, so while a buffer is on the wire
+// the next one is filled. All transactions are completed on return.
+// Chunks are limited to the maximum transfer size of the bus. If the driver rejects a transaction anyway, its rows
+// are sent one at the time by polling transactions and next chunks contain a single row.
+// SPIBeginWrite() and RAMWR command must be sent before
+void TFTController::writeScreenRows(uint16_t * * source, int x1, int y1, int y2, int width)
+{
+  int rowsPerChunk = tmax(1, tmin<int>(m_dmaRows * m_viewPortWidth, m_maxTransferSize / sizeof(uint16_t)) / width);
+  const bool cached = m_tileCacheActive && source == m_viewPort;
+  int pending = 0;
+  int bufIndex = 0;
+
+  gpio_set_level(m_DC, 1);  // 1 = DATA
+
+  for (int row = y1; row <= y2; ) {
+
+    // all buffers queued? wait for the oldest one, which is the next to reuse
+    if (pending == TFT_DMA_BUFFERS) {
+      spi_transaction_t * ta;
+      spi_device_get_trans_result(m_SPIDevHandle, &ta, portMAX_DELAY);
+      --pending;
+    }
+
+    const int rows = tmin(rowsPerChunk, y2 - row + 1);
+    uint16_t * dest = m_dmaBuffer[bufIndex];
+    if (width == m_viewPortStride && !cached && contiguousRows(source, row, row + rows - 1)) {
+      // full rows without padding, copy all of them at once
+      memcpy(dest, source[row], sizeof(uint16_t) * width * rows);
+    } else {
+      for (int i = 0; i < rows; ++i, dest += width)
+        memcpy(dest, residentRow(source, row + i) + x1, sizeof(uint16_t) * width);
+    }
+    if (m_composeCount > 0 && source == m_viewPort)
+      composeSprites(m_dmaBuffer[bufIndex], x1, row, rows, width);
+
+    spi_transaction_t * ta = &m_dmaTrans[bufIndex];
+    memset(ta, 0, sizeof(spi_transaction_t));
+    ta->length    = 8 * sizeof(uint16_t) * width * rows;
+    ta->tx_buffer = m_dmaBuffer[bufIndex];
+    if (spi_device_queue_trans(m_SPIDevHandle, ta, portMAX_DELAY) == ESP_OK) {
+      ++pending;
+    } else {
+      // rejected (ie too large for the bus): complete queued transactions, then send the rows one by one
+      for (; pending > 0; --pending) {
+        spi_transaction_t * qta;
+        spi_device_get_trans_result(m_SPIDevHandle, &qta, portMAX_DELAY);
+      }
+      for (int i = 0; i < rows; ++i)
+        SPIWriteBuffer(m_dmaBuffer[bufIndex] + i * width, sizeof(uint16_t) * width);
+      rowsPerChunk = 1;
+    }
+
+    bufIndex = (bufIndex + 1) % TFT_DMA_BUFFERS;
+    row += rows;
+  }
+
+  // polling transactions (commands) cannot be mixed with queued ones, so wait for all of them
+  while (pending-- > 0) {
+    spi_transaction_t * ta;
+    spi_device_get_trans_result(m_SPIDevHandle, &ta, portMAX_DELAY);
+  }
+}
+
+
+// Rows layout: each row is allocated separately.
+// Contiguous layout: rows are "m_viewPortStride" pixels apart inside a single 32 bytes aligned buffer. The
+// unaligned allocated pointer is stored after the last row pointer.
+uint16_t * * TFTController::allocRows()
+{
+  uint16_t * * rows = (uint16_t**) heap_caps_malloc((m_viewPortHeight + 1) * sizeof(uint16_t*), MALLOC_CAP_32BIT);
+  if (m_viewPortLayout == TFTViewPortLayout::Contiguous) {
+    const int size = m_viewPortStride * m_viewPortHeight * sizeof(uint16_t);
+    uint8_t * block = (uint8_t*) heap_caps_malloc(size + 31, MALLOC_CAP_SPIRAM);
+    uint16_t * aligned = (uint16_t*) (((uintptr_t)block + 31) & ~(uintptr_t)31);
+    memset(aligned, 0, size);
+    for (int i = 0; i < m_viewPortHeight; ++i)
+      rows[i] = aligned + i * m_viewPortStride;
+    rows[m_viewPortHeight] = (uint16_t*) block;
+  } else {
+    for (int i = 0; i < m_viewPortHeight; ++i) {
+      rows[i] = (uint16_t*) heap_caps_malloc(m_viewPortWidth * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+      memset(rows[i], 0, m_viewPortWidth * sizeof(uint16_t));
+    }
+    rows[m_viewPortHeight] = nullptr;
+  }
+  return rows;
+}
+
+
+void TFTController::freeRows(uint16_t * * rows)
+{
+  if (m_viewPortLayout == TFTViewPortLayout::Contiguous) {
+    heap_caps_free(rows[m_viewPortHeight]);
+  } else {
+    for (int i = 0; i < m_viewPortHeight; ++i)
+      heap_caps_free(rows[i]);
+  }
+  heap_caps_free(rows);
+}
+
+
+// true when rows y1..y2 are adjacent in memory (same columns of consecutive rows can be accessed as a single block)
+bool TFTController::contiguousRows(uint16_t * * rows, int y1, int y2)
+{
+  return m_viewPortLayout == TFTViewPortLayout::Contiguous && rows[y2] - rows[y1] == (y2 - y1) * m_viewPortStride;
 }
 
 
 void TFTController::allocViewPort()
 {
-  m_viewPort = (uint16_t**) heap_caps_malloc(m_viewPortHeight * sizeof(uint16_t*), MALLOC_CAP_32BIT);
-  m_dmaBuffer = (uint16_t*) heap_caps_malloc(m_viewPortWidth * sizeof(uint16_t), MALLOC_CAP_DMA);
-  for (int i = 0; i < m_viewPortHeight; ++i) {
-    m_viewPort[i] = (uint16_t*) heap_caps_malloc(m_viewPortWidth * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
-    memset(m_viewPort[i], 0, m_viewPortWidth * sizeof(uint16_t));
+  // stride multiple of 16 pixels, so each row is 32 bytes aligned
+  m_viewPortStride = (m_viewPortWidth + 15) & ~15;
+  m_viewPort = allocRows();
+  // each DMA buffer contains at least one full row
+  m_dmaRows = tmax(1, TFT_DMA_BUFFER_SIZE / (int)(m_viewPortWidth * sizeof(uint16_t)));
+  for (int i = 0; i < TFT_DMA_BUFFERS; ++i)
+    m_dmaBuffer[i] = (uint16_t*) heap_caps_malloc(m_dmaRows * m_viewPortWidth * sizeof(uint16_t), MALLOC_CAP_DMA);
+  if (isDoubleBuffered()) {
+    // front buffer (sent to the display) and hashes of the tiles last sent
+    m_viewPortVisible = allocRows();
+    m_tileCols = (m_viewPortWidth + TFT_TILE_SIZE - 1) / TFT_TILE_SIZE;
+    m_tileRows = (m_viewPortHeight + TFT_TILE_SIZE - 1) / TFT_TILE_SIZE;
+    m_tileHash    = (uint32_t*) heap_caps_malloc(m_tileCols * m_tileRows * sizeof(uint32_t), MALLOC_CAP_32BIT);
+    m_tileRowHash = (uint32_t*) heap_caps_malloc(m_tileCols * sizeof(uint32_t), MALLOC_CAP_32BIT);
+    m_tileDirty   = (uint8_t*) heap_caps_malloc(m_tileCols * m_tileRows, MALLOC_CAP_8BIT);
+    m_tileHashValid = false;  // first swapBuffers() sends everything
+    m_framePending  = false;
   }
+  allocTileCache();
 }
 
 
 void TFTController::freeViewPort()
 {
+  freeTileCache();
   if (m_viewPort) {
-    for (int i = 0; i < m_viewPortHeight; ++i)
-      heap_caps_free(m_viewPort[i]);
-    heap_caps_free(m_viewPort);
+    freeRows(m_viewPort);
     m_viewPort = nullptr;
+    for (int i = 0; i < TFT_DMA_BUFFERS; ++i) {
+      heap_caps_free(m_dmaBuffer[i]);
+      m_dmaBuffer[i] = nullptr;
+    }
+  }
+  if (m_viewPortVisible) {
+    freeRows(m_viewPortVisible);
+    m_viewPortVisible = nullptr;
+    heap_caps_free(m_tileHash);
+    heap_caps_free(m_tileRowHash);
+    heap_caps_free(m_tileDirty);
+    m_tileHash    = nullptr;
+    m_tileRowHash = nullptr;
+    m_tileDirty   = nullptr;
+    m_framePending = false;
+  }
+}
+
+
+void TFTController::setTileCacheSize(int value)
+{
+  value = value <= 0 ? 0 : iclamp(value, 2, TFT_CACHE_MAX_TILES);  // two rows may be accessed at the same time
+  if (value != m_tileCacheSize) {
+    if (m_viewPort) {
+      suspendBackgroundPrimitiveExecution();
+      flushTileCache(true);
+      freeTileCache();
+      m_tileCacheSize = value;
+      allocTileCache();
+      resumeBackgroundPrimitiveExecution();
+    } else
+      m_tileCacheSize = value;
+  }
+}
+
+
+void TFTController::allocTileCache()
+{
+  if (m_tileCacheSize == 0)
+    return;
+  const int bands = (m_viewPortHeight + TFT_CACHE_TILE_ROWS - 1) / TFT_CACHE_TILE_ROWS;
+  m_tileCacheMem  = (uint16_t*) heap_caps_malloc(m_tileCacheSize * TFT_CACHE_TILE_ROWS * m_viewPortWidth * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  m_tileCacheSlot = (int8_t*) heap_caps_malloc(bands, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (!m_tileCacheMem || !m_tileCacheSlot) {
+    // not enough internal memory, draw directly into PSRAM
+    freeTileCache();
+    return;
   }
+  memset(m_tileCacheSlot, -1, bands);
+  for (int i = 0; i < m_tileCacheSize; ++i) {
+    m_tileCacheBand[i]    = -1;
+    m_tileCacheDirty[i]   = false;
+    m_tileCacheLastUse[i] = m_tileCacheClock;
+  }
+  m_tileCacheActive = true;
+}
+
+
+void TFTController::freeTileCache()
+{
+  heap_caps_free(m_tileCacheMem);
+  heap_caps_free(m_tileCacheSlot);
+  m_tileCacheMem    = nullptr;
+  m_tileCacheSlot   = nullptr;
+  m_tileCacheActive = false;
+}
+
+
+// loads "band" into a free or the least recently used slot, writing back the evicted tile if modified
+// the most recently used slot is never evicted, so the row returned by the previous viewPortRow() remains valid
+int TFTController::tileCacheLoad(int band)
+{
+  int slot = 0;
+  uint32_t maxAge = 0;
+  for (int i = 0; i < m_tileCacheSize; ++i) {
+    if (m_tileCacheBand[i] < 0) {
+      slot = i;
+      break;
+    }
+    const uint32_t age = m_tileCacheClock - m_tileCacheLastUse[i];  // wraps correctly
+    if (age > maxAge) {
+      maxAge = age;
+      slot = i;
+    }
+  }
+
+  if (m_tileCacheBand[slot] >= 0) {
+    if (m_tileCacheDirty[slot])
+      tileCacheWriteBack(slot);
+    m_tileCacheSlot[m_tileCacheBand[slot]] = -1;
+  }
+
+  const int y1 = band * TFT_CACHE_TILE_ROWS;
+  const int y2 = tmin(y1 + TFT_CACHE_TILE_ROWS, (int)m_viewPortHeight);
+  for (int y = y1; y < y2; ++y)
+    memcpy(tileCacheRow(slot, y), m_viewPort[y], m_viewPortWidth * sizeof(uint16_t));
+
+  m_tileCacheBand[slot]  = band;
+  m_tileCacheDirty[slot] = false;
+  m_tileCacheSlot[band]  = slot;
+  ++m_tileCacheStats.misses;
+  return slot;
+}
+
+
+void TFTController::tileCacheWriteBack(int slot)
+{
+  const int y1 = m_tileCacheBand[slot] * TFT_CACHE_TILE_ROWS;
+  const int y2 = tmin(y1 + TFT_CACHE_TILE_ROWS, (int)m_viewPortHeight);
+  for (int y = y1; y < y2; ++y)
+    memcpy(m_viewPort[y], tileCacheRow(slot, y), m_viewPortWidth * sizeof(uint16_t));
+  m_tileCacheDirty[slot] = false;
+  ++m_tileCacheStats.writeBacks;
+}
+
+
+// empties the cache, optionally writing back modified tiles
+void TFTController::flushTileCache(bool writeBack)
+{
+  if (!m_tileCacheMem)
+    return;
+  for (int i = 0; i < m_tileCacheSize; ++i) {
+    if (m_tileCacheBand[i] >= 0) {
+      if (writeBack && m_tileCacheDirty[i])
+        tileCacheWriteBack(i);
+      m_tileCacheSlot[m_tileCacheBand[i]] = -1;
+      m_tileCacheBand[i]  = -1;
+      m_tileCacheDirty[i] = false;
+    }
+  }
+}
+
+
+// row "y" of "source" as last drawn: resident tiles of m_viewPort are read from the cache, leaving it unchanged
+uint16_t const * TFTController::residentRow(uint16_t * * source, int y)
+{
+  if (m_tileCacheActive && source == m_viewPort) {
+    const int slot = m_tileCacheSlot[y / TFT_CACHE_TILE_ROWS];
+    if (slot >= 0)
+      return tileCacheRow(slot, y);
+  }
+  return source[y];
 }
 
 
@@ -560,13 +1007,22 @@ void TFTController::updateTaskFunc(void * pvParameters)
 
     ctrl->waitForPrimitives();
 
-    // primitive processing blocked?
-    if (ctrl->m_updateTaskFuncSuspended > 0)
-      ulTaskNotifyTake(true, portMAX_DELAY); // yes, wait for a notify
-
+    // set before checking m_updateTaskFuncSuspended: suspendBackgroundPrimitiveExecution() does the opposite,
+    // so either this task sees the suspension or the suspending task waits for this one to complete
     ctrl->m_updateTaskRunning = true;
+    __sync_synchronize();
 
-    Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+    // primitive processing blocked?
+    if (ctrl->m_updateTaskFuncSuspended > 0) {
+      ctrl->m_updateTaskRunning = false;
+      // loop because also new primitives notify this task
+      while (ctrl->m_updateTaskFuncSuspended > 0)
+        ulTaskNotifyTake(true, portMAX_DELAY); // yes, wait for a notify
+      // primitives may have been executed by processPrimitives() meanwhile
+      continue;
+    }
+
+    DirtyRegion dirtyRegion;
 
     int64_t startTime = ctrl->backgroundPrimitiveTimeoutEnabled() ? esp_timer_get_time() : 0;
     do {
@@ -575,27 +1031,116 @@ void TFTController::updateTaskFunc(void * pvParameters)
       if (ctrl->getPrimitive(&prim, TFT_BACKGROUND_PRIMITIVE_TIMEOUT / 1000) == false)
         break;
 
-      ctrl->execPrimitive(prim, updateRect, false);
-
-      if (ctrl->m_updateTaskFuncSuspended > 0)
+      if (ctrl->m_parallel && isBandPrimitive(prim.cmd)) {
+        ctrl->m_batch[ctrl->m_batchCount++] = prim;
+        if (ctrl->m_batchCount == TFT_PARALLEL_BATCH)
+          ctrl->execBatch(dirtyRegion);
+      } else {
+        // barrier: previous primitives must be completed on all bands
+        ctrl->execBatch(dirtyRegion);
+        if (prim.cmd == PrimitiveCmd::VScroll && ctrl->hardwareScrollApplies(prim.ivalue))
+          ctrl->hardwareVScroll(prim.ivalue, dirtyRegion);
+        else
+          ctrl->execPrimitive(prim, dirtyRegion, false);
+      }
+
+      // start sending the swapped frame without waiting for other primitives
+      if (ctrl->m_updateTaskFuncSuspended > 0 || ctrl->m_framePending)
         break;
 
     } while (!ctrl->backgroundPrimitiveTimeoutEnabled() || (startTime + TFT_BACKGROUND_PRIMITIVE_TIMEOUT > esp_timer_get_time()));
 
-    ctrl->showSprites(updateRect);
+    ctrl->execBatch(dirtyRegion);
+
+    ctrl->showSprites(dirtyRegion);
+
+    // send the frame completed by swapBuffers() while the next one is drawn
+    if (ctrl->m_framePending)
+      ctrl->sendChangedTiles();
 
     ctrl->m_updateTaskRunning = false;
 
     if (!ctrl->isDoubleBuffered())
-      ctrl->sendScreenBuffer(updateRect);
+      ctrl->sendScreenBuffer(dirtyRegion);
   }
 }
 
 
 
+void TFTController::enableParallelExecution(bool value)
+{
+  if (value == m_parallel || portNUM_PROCESSORS < 2)
+    return;
+  suspendBackgroundPrimitiveExecution();
+  if (value && !m_bandsDone) {
+    m_bandsDone = xSemaphoreCreateCounting(portNUM_PROCESSORS, 0);
+    for (int i = 0; i < portNUM_PROCESSORS; ++i)
+      xTaskCreatePinnedToCore(&bandTaskFunc, "", TFT_UPDATETASK_STACK, this, TFT_UPDATETASK_PRIORITY, &m_bandTaskHandle[i], i);
+  }
+  m_parallel = value;
+  resumeBackgroundPrimitiveExecution();
+}
+
+
+// executes all batched primitives: each band task draws them inside its band, then the paint state continues from the bands one
+void TFTController::execBatch(DirtyRegion & dirtyRegion)
+{
+  if (m_batchCount == 0)
+    return;
+
+  // sprites are hidden once here, band tasks cannot restore backgrounds that cross bands
+  Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  hideAllSprites(updateRect);
+  dirtyRegion.add(updateRect);
+
+  // tile cache is not shared between tasks
+  flushTileCache(true);
+  m_tileCacheActive = false;
+
+  Rect bands[portNUM_PROCESSORS];
+  for (int i = 0; i < portNUM_PROCESSORS; ++i)
+    bands[i] = Rect(0, i * m_viewPortHeight / portNUM_PROCESSORS, m_viewPortWidth - 1, (i + 1) * m_viewPortHeight / portNUM_PROCESSORS - 1);
+  beginBands(bands);
+
+  for (int i = 0; i < portNUM_PROCESSORS; ++i) {
+    m_bandDirtyRegion[i].clear();
+    xTaskNotifyGive(m_bandTaskHandle[i]);
+  }
+  for (int i = 0; i < portNUM_PROCESSORS; ++i)
+    xSemaphoreTake(m_bandsDone, portMAX_DELAY);
+
+  endBands();
+  m_tileCacheActive = m_tileCacheMem != nullptr;
+
+  for (int i = 0; i < portNUM_PROCESSORS; ++i)
+    for (int j = 0; j < m_bandDirtyRegion[i].count(); ++j)
+      dirtyRegion.add(m_bandDirtyRegion[i][j]);
+
+  for (int i = 0; i < m_batchCount; ++i)
+    releasePrimitiveBuffers(m_batch[i]);
+  m_batchCount = 0;
+}
+
+
+// band task, one for each core. Band index is the core index.
+void TFTController::bandTaskFunc(void * pvParameters)
+{
+  TFTController * ctrl = (TFTController*) pvParameters;
+  const int band = xPortGetCoreID();
+
+  while (true) {
+    ulTaskNotifyTake(true, portMAX_DELAY);
+    for (int i = 0; i < ctrl->m_batchCount; ++i)
+      ctrl->execPrimitiveInBand(ctrl->m_batch[i], ctrl->m_bandDirtyRegion[band]);
+    xSemaphoreGive(ctrl->m_bandsDone);
+  }
+}
+
+
 void TFTController::suspendBackgroundPrimitiveExecution()
 {
   ++m_updateTaskFuncSuspended;
+  __sync_synchronize();
   while (m_updateTaskRunning)
     taskYIELD();
 }
@@ -613,7 +1158,7 @@ void TFTController::setPixelAt(PixelDesc const & pixelDesc, Rect & updateRect)
 {
   genericSetPixelAt(pixelDesc, updateRect,
                     [&] (RGB888 const & color)           { return preparePixel(color); },
-                    [&] (int X, int Y, uint16_t pattern) { m_viewPort[Y][X] = pattern; }
+                    [&] (int X, int Y, uint16_t pattern) { viewPortRow(Y)[X] = pattern; }
                    );
 }
 
@@ -626,18 +1171,55 @@ void TFTController::absDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color)
                      [&] (RGB888 const & color)                    { return preparePixel(color); },
                      [&] (int Y, int X1, int X2, uint16_t pattern) { rawFillRow(Y, X1, X2, pattern); },
                      [&] (int Y, int X1, int X2)                   { rawInvertRow(Y, X1, X2); },
-                     [&] (int X, int Y, uint16_t pattern)          { m_viewPort[Y][X] = pattern; },
-                     [&] (int X, int Y)                            { m_viewPort[Y][X] = ~m_viewPort[Y][X]; }
+                     [&] (int X, int Y, uint16_t pattern)          { viewPortRow(Y)[X] = pattern; },
+                     [&] (int X, int Y)                            { auto px = viewPortRow(Y) + X; *px = ~*px; }
                      );
 }
 
 
+// fills "count" pixels, by 32 bit words when possible
+static void fillPixels(uint16_t * px, int count, uint16_t pattern)
+{
+  if (count <= 0)
+    return;
+  if ((uintptr_t)px & 2) {
+    *px++ = pattern;
+    --count;
+  }
+  const uint32_t pattern32 = pattern | ((uint32_t)pattern << 16);
+  uint32_t * px32 = (uint32_t*) px;
+  for (int i = count >> 1; i > 0; --i)
+    *px32++ = pattern32;
+  if (count & 1)
+    *(uint16_t*)px32 = pattern;
+}
+
+
+// copies "count" pixels, by 32 bit words when source and dest have the same alignment (faster than memcpy() for short rows)
+static void copyPixels(uint16_t * dst, uint16_t const * src, int count)
+{
+  if (((uintptr_t)dst ^ (uintptr_t)src) & 2) {
+    for (; count > 0; --count)
+      *dst++ = *src++;
+    return;
+  }
+  if (count > 0 && ((uintptr_t)dst & 2)) {
+    *dst++ = *src++;
+    --count;
+  }
+  uint32_t * dst32 = (uint32_t*) dst;
+  uint32_t const * src32 = (uint32_t const *) src;
+  for (int i = count >> 1; i > 0; --i)
+    *dst32++ = *src32++;
+  if (count & 1)
+    *(uint16_t*)dst32 = *(uint16_t const *)src32;
+}
+
+
 // parameters not checked
 void TFTController::rawFillRow(int y, int x1, int x2, uint16_t pattern)
 {
-  auto px = m_viewPort[y] + x1;
-  for (int x = x1; x <= x2; ++x, ++px)
-    *px = pattern;
+  fillPixels(viewPortRow(y) + x1, x2 - x1 + 1, pattern);
 }
 
 
@@ -652,8 +1234,8 @@ void TFTController::rawFillRow(int y, int x1, int x2, RGB888 color)
 // parameters not checked
 void TFTController::swapRows(int yA, int yB, int x1, int x2)
 {
-  auto pxA = m_viewPort[yA] + x1;
-  auto pxB = m_viewPort[yB] + x1;
+  auto pxA = viewPortRow(yA) + x1;
+  auto pxB = viewPortRow(yB) + x1;
   for (int x = x1; x <= x2; ++x, ++pxA, ++pxB)
     tswap(*pxA, *pxB);
 }
@@ -661,7 +1243,7 @@ void TFTController::swapRows(int yA, int yB, int x1, int x2)
 
 void TFTController::rawInvertRow(int y, int x1, int x2)
 {
-  auto px = m_viewPort[y] + x1;
+  auto px = viewPortRow(y) + x1;
   for (int x = x1; x <= x2; ++x, ++px)
     *px = ~*px;
 }
@@ -671,7 +1253,7 @@ void TFTController::drawEllipse(Size const & size, Rect & updateRect)
 {
   genericDrawEllipse(size, updateRect,
                      [&] (RGB888 const & color)           { return preparePixel(color); },
-                     [&] (int X, int Y, uint16_t pattern) { m_viewPort[Y][X] = pattern; }
+                     [&] (int X, int Y, uint16_t pattern) { viewPortRow(Y)[X] = pattern; }
                     );
 }
 
@@ -679,14 +1261,67 @@ void TFTController::drawEllipse(Size const & size, Rect & updateRect)
 void TFTController::clear(Rect & updateRect)
 {
   hideSprites(updateRect);
+  // whole viewport is overwritten: drop cached tiles and fill PSRAM directly
+  flushTileCache(false);
+  m_tileCacheActive = false;
   auto pattern = preparePixel(getActualBrushColor());
-  for (int y = 0; y < m_viewPortHeight; ++y)
-    rawFillRow(y, 0, m_viewPortWidth - 1, pattern);
+  if (m_viewPortLayout == TFTViewPortLayout::Contiguous) {
+    // fill the whole buffer (rows padding included) by 32 bit words
+    const uint32_t pattern32 = pattern | ((uint32_t)pattern << 16);
+    uint32_t * px = (uint32_t*) m_viewPort[0];
+    for (int i = m_viewPortStride * m_viewPortHeight / 2; i > 0; --i, ++px)
+      *px = pattern32;
+  } else {
+    for (int y = 0; y < m_viewPortHeight; ++y)
+      rawFillRow(y, 0, m_viewPortWidth - 1, pattern);
+  }
+  m_tileCacheActive = m_tileCacheMem != nullptr;
 }
 
 
 void TFTController::VScroll(int scroll, Rect & updateRect)
 {
+  // rows are moved or their pointers swapped, so the tile cache is written back and bypassed
+  if (m_tileCacheMem) {
+    hideSprites(updateRect);
+    flushTileCache(true);
+    m_tileCacheActive = false;
+    VScrollRows(scroll, updateRect);
+    m_tileCacheActive = true;
+  } else
+    VScrollRows(scroll, updateRect);
+}
+
+
+void TFTController::VScrollRows(int scroll, Rect & updateRect)
+{
+  if (m_viewPortLayout == TFTViewPortLayout::Contiguous) {
+    // rows pointers cannot be swapped, rows are moved
+    const Rect & region = paintState().scrollingRegion;
+    const int height = region.height();
+    if (region.X1 == 0 && region.X2 == m_viewPortWidth - 1 && scroll != 0 && abs(scroll) < height) {
+      // full width: move all rows at once
+      hideSprites(updateRect);
+      RGB888 color = getActualBrushColor();
+      const int moved = height - abs(scroll);
+      if (scroll < 0) {
+        memmove(m_viewPort[region.Y1], m_viewPort[region.Y1 - scroll], moved * m_viewPortStride * sizeof(uint16_t));
+        for (int y = region.Y1 + moved; y <= region.Y2; ++y)
+          rawFillRow(y, 0, m_viewPortWidth - 1, color);
+      } else {
+        memmove(m_viewPort[region.Y1 + scroll], m_viewPort[region.Y1], moved * m_viewPortStride * sizeof(uint16_t));
+        for (int y = region.Y1; y < region.Y1 + scroll; ++y)
+          rawFillRow(y, 0, m_viewPortWidth - 1, color);
+      }
+    } else {
+      genericVScroll(scroll, updateRect,
+                     [&] (int x1, int x2, int srcY, int dstY)    { memcpy(m_viewPort[dstY] + x1, m_viewPort[srcY] + x1, (x2 - x1 + 1) * sizeof(uint16_t)); }, // rawCopyRow
+                     [&] (int y, int x1, int x2, RGB888 pattern) { rawFillRow(y, x1, x2, pattern); }                                                          // rawFillRow
+                    );
+    }
+    return;
+  }
+
   genericVScroll(scroll, updateRect,
                  [&] (int yA, int yB, int x1, int x2)        { swapRows(yA, yB, x1, x2); },              // swapRowsCopying
                  [&] (int yA, int yB)                        { tswap(m_viewPort[yA], m_viewPort[yB]); }, // swapRowsPointers
@@ -695,27 +1330,305 @@ void TFTController::VScroll(int scroll, Rect & updateRect)
 }
 
 
+void TFTController::enableHardwareScrolling(bool value)
+{
+  if (value == m_hwScroll)
+    return;
+  suspendBackgroundPrimitiveExecution();
+  m_hwScroll = value;
+  if (!value && m_viewPort) {
+    SPIBeginWrite();
+    resetHardwareScroll();
+    SPIEndWrite();
+  }
+  resumeBackgroundPrimitiveExecution();
+  if (!value && m_viewPort)
+    sendRefresh();
+}
+
+
+// true when the VScroll primitive can be executed by hardwareVScroll()
+bool TFTController::hardwareScrollApplies(int scroll)
+{
+  const Rect & region = paintState().scrollingRegion;
+  return m_hwScroll && scroll != 0 && abs(scroll) < region.height() &&
+         !isDoubleBuffered() && m_orientation == TFTOrientation::Rotate0 &&
+         m_viewPortWidth == m_screenWidth && m_viewPortHeight == m_screenHeight &&
+         region.X1 == 0 && region.X2 == m_viewPortWidth - 1;
+}
+
+
+// Executes a full width VScroll primitive moving the scroll area start address of the display, so only the uncovered
+// rows are added to the dirty region. The scroll area follows the scrolling region.
+void TFTController::hardwareVScroll(int scroll, DirtyRegion & dirtyRegion)
+{
+  const Rect region = paintState().scrollingRegion;
+
+  // rows already drawn must reach the display before they are moved there
+  sendScreenBuffer(dirtyRegion);
+  dirtyRegion.clear();
+
+  SPIBeginWrite();
+  if (region.Y1 != m_hwScrollY1 || region.Y2 != m_hwScrollY2) {
+    // new scroll area: rows of the old one are not in place anymore
+    if (m_hwScrollOffset != 0)
+      dirtyRegion.add(Rect(0, 0, m_viewPortWidth - 1, m_viewPortHeight - 1));
+    m_hwScrollY1     = region.Y1;
+    m_hwScrollY2     = region.Y2;
+    m_hwScrollOffset = 0;
+    writeScrollArea();
+  }
+  SPIEndWrite();
+
+  // sprites shown by the display move along with the rows (must be collected before VScroll() hides them)
+  for (int i = 0; i <= spritesCount(); ++i) {
+    Sprite * sprite = i < spritesCount() ? getSprite(i) : mouseCursor();
+    if (sprite->savedBackgroundWidth > 0) {
+      const Rect spriteRect = Rect(sprite->savedX, sprite->savedY, sprite->savedX + sprite->savedBackgroundWidth - 1, sprite->savedY + sprite->savedBackgroundHeight - 1);
+      dirtyRegion.add(spriteRect.translate(0, scroll).intersection(region));
+      // composed sprites don't move with the rows, they must be composed again where they are
+      if (spritesComposed())
+        dirtyRegion.add(spriteRect);
+    }
+  }
+
+  // scroll viewport rows, the hidden sprites rectangles are added to updateRect
+  Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  VScroll(scroll, updateRect);
+
+  const int height = region.height();
+  m_hwScrollOffset = ((m_hwScrollOffset - scroll) % height + height) % height;
+  SPIBeginWrite();
+  writeScrollArea();
+  SPIEndWrite();
+
+  dirtyRegion.add(updateRect);
+  if (scroll < 0)
+    dirtyRegion.add(Rect(region.X1, region.Y2 + scroll + 1, region.X2, region.Y2));  // scroll UP
+  else
+    dirtyRegion.add(Rect(region.X1, region.Y1, region.X2, region.Y1 + scroll - 1));  // scroll DOWN
+}
+
+
+bool TFTController::tryHardwareVScroll(int scroll, DirtyRegion & dirtyRegion)
+{
+  if (!hardwareScrollApplies(scroll))
+    return false;
+  hardwareVScroll(scroll, dirtyRegion);
+  return true;
+}
+
+
+// sends Vertical Scrolling Definition and Vertical Scrolling Start Address
+// SPIBeginWrite() must be called before
+void TFTController::writeScrollArea()
+{
+  // some controllers drive more rows than the screen shows, m_controllerHeight may be smaller than the screen (HX8357)
+  const int rows = tmax<int>(m_controllerHeight, m_screenHeight);
+  const int top  = m_rotOffsetY + m_hwScrollY1;
+  const int area = m_hwScrollY2 - m_hwScrollY1 + 1;
+
+  writeCommand(TFT_VSCRDEF);
+  writeWord(top);                 // TFA (Top Fixed Area)
+  writeWord(area);                // VSA (Vertical Scrolling Area)
+  writeWord(rows - top - area);   // BFA (Bottom Fixed Area)
+
+  writeCommand(TFT_VSCRSADD);
+  writeWord(top + m_hwScrollOffset);
+}
+
+
+// restores the scroll area of the display to the whole screen, without offset
+// SPIBeginWrite() must be called before
+void TFTController::resetHardwareScroll()
+{
+  if (m_hwScrollY1 <= m_hwScrollY2) {
+    writeCommand(TFT_VSCRDEF);
+    writeWord(0);
+    writeWord(tmax<int>(m_controllerHeight, m_screenHeight));
+    writeWord(0);
+    writeCommand(TFT_VSCRSADD);
+    writeWord(0);
+  }
+  m_hwScrollY1     = 0;
+  m_hwScrollY2     = -1;
+  m_hwScrollOffset = 0;
+}
+
+
+// rows are contiguous pixels: each row of the scrolling region is moved with a single memmove()
+// scroll < 0 -> scroll LEFT
+// scroll > 0 -> scroll RIGHT
 void TFTController::HScroll(int scroll, Rect & updateRect)
 {
-  genericHScroll(scroll, updateRect,
-                 [&] (RGB888 const & color)               { return preparePixel(color); }, // preparePixel
-                 [&] (int y)                              { return m_viewPort[y]; },       // rawGetRow
-                 [&] (uint16_t * row, int x)              { return row[x]; },              // rawGetPixelInRow
-                 [&] (uint16_t * row, int x, int pattern) { row[x] = pattern; }            // rawSetPixelInRow
-                );
+  hideSprites(updateRect);
+  auto pattern = preparePixel(getActualBrushColor());
+
+  if (scroll == 0)
+    return;
+
+  const Rect & region = paintState().scrollingRegion;
+  const int width = region.width();
+  const int moved = tmax(0, width - abs(scroll));
+
+  for (int y = region.Y1; y <= region.Y2; ++y) {
+    auto row = viewPortRow(y) + region.X1;
+    if (scroll < 0) {
+      memmove(row, row + width - moved, moved * sizeof(uint16_t));
+      // fill right area with brush color
+      fillPixels(row + moved, width - moved, pattern);
+    } else {
+      memmove(row + width - moved, row, moved * sizeof(uint16_t));
+      // fill left area with brush color
+      fillPixels(row, width - moved, pattern);
+    }
+  }
+}
+
+
+// row of a glyph as a mask (MSB = leftmost pixel), bold applied
+static uint32_t glyphRowMask(uint8_t const * srcrow, int glyphWidthByte, bool bold)
+{
+  uint32_t src = 0;
+  for (int i = 0; i < glyphWidthByte; ++i)
+    src |= (uint32_t)srcrow[i] << (24 - i * 8);
+  return bold ? src | (src >> 1) : src;
 }
 
 
 void TFTController::drawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect)
 {
+  if (!glyphOptions.italic && !glyphOptions.doubleWidth && glyph.width <= 32) {
+    drawGlyphRows(glyph, glyphOptions, penColor, brushColor, updateRect);
+    return;
+  }
   genericDrawGlyph(glyph, glyphOptions, penColor, brushColor, updateRect,
                    [&] (RGB888 const & color) { return preparePixel(color); },
-                   [&] (int y)                { return m_viewPort[y]; },
+                   [&] (int y)                { return viewPortRow(y); },
                    [&] (uint16_t * row, int x, uint16_t pattern) { row[x] = pattern; }
                   );
 }
 
 
+// Draws glyphs up to 32 pixels wide, without italic and double width. Each row of the glyph is a 32 bit mask (bold,
+// blank and underline are applied to the mask), then:
+//   - filled background: each nibble of the mask selects 4 pixels from a table of pen/brush patterns
+//   - transparent background: runs of set bits are filled with the pen pattern
+// With filled background the rendered glyph is taken from the glyph cache when enabled, and rows are just copied.
+void TFTController::drawGlyphRows(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect)
+{
+  const Rect & clip = paintState().absClippingRect;
+
+  int destX = glyph.X + paintState().origin.X;
+  int destY = glyph.Y + paintState().origin.Y;
+
+  const int glyphWidth     = glyph.width;
+  const int glyphHeight    = glyph.height;
+  const int glyphWidthByte = (glyphWidth + 7) / 8;
+
+  if (destX > clip.X2 || destY > clip.Y2)
+    return;
+
+  int X1 = 0;
+  if (destX < clip.X1) {
+    X1 = clip.X1 - destX;
+    destX = clip.X1;
+  }
+  const int XCount = tmin(clip.X2 + 1 - destX, glyphWidth - X1);
+
+  int Y1 = 0;
+  if (destY < clip.Y1) {
+    Y1 = clip.Y1 - destY;
+    destY = clip.Y1;
+  }
+  const int YCount = tmin(clip.Y2 + 1 - destY, glyphHeight - Y1);
+
+  if (XCount <= 0 || YCount <= 0)
+    return;
+
+  updateRect = updateRect.merge(Rect(destX, destY, destX + XCount - 1, destY + YCount - 1));
+  hideSprites(updateRect);
+
+  if (glyphOptions.invert ^ paintState().paintOptions.swapFGBG)
+    tswap(penColor, brushColor);
+
+  // a very simple and ugly reduce luminosity (faint) implementation!
+  if (glyphOptions.reduceLuminosity) {
+    if (penColor.R > 128) penColor.R = 128;
+    if (penColor.G > 128) penColor.G = 128;
+    if (penColor.B > 128) penColor.B = 128;
+  }
+
+  const uint16_t penPattern   = preparePixel(penColor);
+  const uint16_t brushPattern = preparePixel(brushColor);
+  const bool fillBackground   = glyphOptions.fillBackground;
+  const int underlineY        = glyphOptions.underline ? glyphHeight - FABGLIB_UNDERLINE_POSITION - 1 : -1;
+  const uint32_t visibleMask  = XCount == 32 ? 0xffffffff : ~(0xffffffff >> XCount);
+
+  if (fillBackground && m_glyphCacheBudget) {
+    auto entry = glyphCacheGet(glyph, glyphOptions, penPattern, brushPattern);
+    if (entry) {
+      uint16_t const * src = entry->pixels + Y1 * glyphWidth + X1;
+      for (int y = 0; y < YCount; ++y, src += glyphWidth)
+        copyPixels(viewPortRow(destY + y) + destX, src, XCount);
+      return;
+    }
+  }
+
+  // pen/brush patterns of each nibble, one table per core (both may draw glyphs in parallel)
+  TFTGlyphTable & table = m_glyphTable[xPortGetCoreID()];
+  if (fillBackground && (!table.valid || table.pen != penPattern || table.brush != brushPattern)) {
+    for (int nibble = 0; nibble < 16; ++nibble)
+      for (int i = 0; i < 4; ++i)
+        table.patterns[nibble][i] = (nibble << i) & 8 ? penPattern : brushPattern;
+    table.pen   = penPattern;
+    table.brush = brushPattern;
+    table.valid = true;
+  }
+
+  uint8_t const * srcrow = glyph.data + Y1 * glyphWidthByte;
+  for (int y = Y1; y < Y1 + YCount; ++y, ++destY, srcrow += glyphWidthByte) {
+
+    uint16_t * dst = viewPortRow(destY) + destX;
+
+    if (y == underlineY) {
+      fillPixels(dst, XCount, glyphOptions.blank ? brushPattern : penPattern);
+      continue;
+    }
+
+    uint32_t src = glyphOptions.blank ? 0 : glyphRowMask(srcrow, glyphWidthByte, glyphOptions.bold);
+    src = (src << X1) & visibleMask;
+
+    if (fillBackground) {
+      int count = XCount;
+      for (; count >= 4; count -= 4, dst += 4, src <<= 4) {
+        uint16_t const * p = table.patterns[src >> 28];
+        dst[0] = p[0];
+        dst[1] = p[1];
+        dst[2] = p[2];
+        dst[3] = p[3];
+      }
+      for (; count > 0; --count, src <<= 1)
+        *dst++ = src & 0x80000000 ? penPattern : brushPattern;
+    } else {
+      // skip clear bits, fill runs of set bits
+      int x = 0;
+      while (src) {
+        const int skip = __builtin_clz(src);
+        src <<= skip;
+        x += skip;
+        const int run = (~src == 0) ? 32 : __builtin_clz(~src);
+        for (int i = 0; i < run; ++i)
+          dst[x + i] = penPattern;
+        src = run == 32 ? 0 : src << run;
+        x += run;
+      }
+    }
+
+  }
+}
+
+
 void TFTController::invertRect(Rect const & rect, Rect & updateRect)
 {
   genericInvertRect(rect, updateRect,
@@ -728,7 +1641,7 @@ void TFTController::swapFGBG(Rect const & rect, Rect & updateRect)
 {
   genericSwapFGBG(rect, updateRect,
                   [&] (RGB888 const & color)                    { return preparePixel(color); },
-                  [&] (int y)                                   { return m_viewPort[y]; },
+                  [&] (int y)                                   { return viewPortRow(y); },
                   [&] (uint16_t * row, int x)                   { return row[x]; },
                   [&] (uint16_t * row, int x, uint16_t pattern) { row[x] = pattern; }
                  );
@@ -736,13 +1649,41 @@ void TFTController::swapFGBG(Rect const & rect, Rect & updateRect)
 
 
 // supports overlapping of source and dest rectangles
+// Same as genericCopyRect() but the clipped part of each row is moved with a single memmove()
 void TFTController::copyRect(Rect const & source, Rect & updateRect)
 {
-  genericCopyRect(source, updateRect,
-                  [&] (int y)                                   { return m_viewPort[y]; },
-                  [&] (uint16_t * row, int x)                   { return row[x]; },
-                  [&] (uint16_t * row, int x, uint16_t pattern) { row[x] = pattern; }
-                 );
+  const Rect & clip = paintState().absClippingRect;
+
+  const int srcX   = source.X1 + paintState().origin.X;
+  const int srcY   = source.Y1 + paintState().origin.Y;
+  const int width  = source.X2 - source.X1 + 1;
+  const int height = source.Y2 - source.Y1 + 1;
+  const int destX  = paintState().position.X;
+  const int destY  = paintState().position.Y;
+  const int deltaX = destX - srcX;
+  const int deltaY = destY - srcY;
+
+  updateRect = updateRect.merge(Rect(srcX, srcY, srcX + width - 1, srcY + height - 1));
+  updateRect = updateRect.merge(Rect(destX, destY, destX + width - 1, destY + height - 1));
+  hideSprites(updateRect);
+
+  // destination columns inside clipping rect
+  const int x1 = tmax<int>(destX, clip.X1);
+  const int x2 = tmin<int>(destX + width - 1, clip.X2);
+  if (x1 > x2)
+    return;
+  const int count = x2 - x1 + 1;
+
+  // when moving down rows are copied from bottom to top, so source rows are read before being overwritten
+  const int incY   = deltaY < 0 ? 1 : -1;
+  const int startY = deltaY < 0 ? destY : destY + height - 1;
+  for (int y = startY, i = 0; i < height; y += incY, ++i) {
+    if (y >= clip.Y1 && y <= clip.Y2) {
+      auto srcRow = viewPortRow(y - deltaY);
+      auto dstRow = viewPortRow(y);
+      memmove(dstRow + x1, srcRow + x1 - deltaX, count * sizeof(uint16_t));
+    }
+  }
 }
 
 
@@ -750,7 +1691,7 @@ void TFTController::copyRect(Rect const & source, Rect & updateRect)
 void TFTController::readScreen(Rect const & rect, RGB888 * destBuf)
 {
   for (int y = rect.Y1; y <= rect.Y2; ++y) {
-    auto row = m_viewPort[y] + rect.X1;
+    auto row = residentRow(m_viewPort, y) + rect.X1;
     for (int x = rect.X1; x <= rect.X2; ++x, ++destBuf, ++row)
       *destBuf = nativeToRGB888(*row);
   }
@@ -759,48 +1700,629 @@ void TFTController::readScreen(Rect const & rect, RGB888 * destBuf)
 
 void TFTController::rawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount)
 {
-  genericRawDrawBitmap_Native(destX, destY, (uint16_t*) bitmap->data, bitmap->width, X1, Y1, XCount, YCount,
-                                 [&] (int y)                               { return m_viewPort[y]; },  // rawGetRow
-                                 [&] (uint16_t * row, int x, uint16_t src) { row[x] = src; }           // rawSetPixelInRow
-                                );
+  // already in native format, rows are copied (ie tiles of TileMap)
+  const int width = bitmap->width;
+  uint16_t const * src = (uint16_t const *) bitmap->data + Y1 * width + X1;
+  for (int y = 0; y < YCount; ++y, src += width)
+    copyPixels(viewPortRow(destY + y) + destX, src, XCount);
 }
 
 
 void TFTController::rawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
 {
+  auto entry = bitmapCacheGet(bitmap);
+  if (entry) {
+    rawDrawCachedBitmap(entry, destX, destY, (uint16_t*)saveBackground, X1, Y1, XCount, YCount);
+    return;
+  }
   auto foregroundPattern = preparePixel(bitmap->foregroundColor);
+  const int opacity = bitmapOpacity();
   genericRawDrawBitmap_Mask(destX, destY, bitmap, (uint16_t*)saveBackground, X1, Y1, XCount, YCount,
-                            [&] (int y)                 { return m_viewPort[y]; },            // rawGetRow
-                            [&] (uint16_t * row, int x) { return row[x]; },                   // rawGetPixelInRow
-                            [&] (uint16_t * row, int x) { row[x] = foregroundPattern; }       // rawSetPixelInRow
+                            [&] (int y)                 { return viewPortRow(y); },                                 // rawGetRow
+                            [&] (uint16_t * row, int x) { return row[x]; },                                        // rawGetPixelInRow
+                            [&] (uint16_t * row, int x) { blendRGB565BEPixel(row + x, foregroundPattern, opacity); }  // rawSetPixelInRow
                            );
 }
 
 
 void TFTController::rawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
 {
+  auto entry = bitmapCacheGet(bitmap);
+  if (entry) {
+    rawDrawCachedBitmap(entry, destX, destY, (uint16_t*)saveBackground, X1, Y1, XCount, YCount);
+    return;
+  }
+  const int opacity = bitmapOpacity();
   genericRawDrawBitmap_RGBA2222(destX, destY, bitmap, (uint16_t*)saveBackground, X1, Y1, XCount, YCount,
-                                [&] (int y)                              { return m_viewPort[y]; },            // rawGetRow
-                                [&] (uint16_t * row, int x)              { return row[x]; },                   // rawGetPixelInRow
-                                [&] (uint16_t * row, int x, uint8_t src) { row[x] = RGBA2222toNative(src); }   // rawSetPixelInRow
+                                [&] (int y)                              { return viewPortRow(y); },   // rawGetRow
+                                [&] (uint16_t * row, int x)              { return row[x]; },          // rawGetPixelInRow
+                                [&] (uint16_t * row, int x, uint8_t src) {                            // rawSetPixelInRow
+                                  blendRGB565BEPixel(row + x, RGBA2222toNative(src), combineAlpha((src >> 6) * 85, opacity));
+                                }
                                );
 }
 
 
 void TFTController::rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
 {
+  auto entry = bitmapCacheGet(bitmap);
+  if (entry) {
+    rawDrawCachedBitmap(entry, destX, destY, (uint16_t*)saveBackground, X1, Y1, XCount, YCount);
+    return;
+  }
+  const int opacity = bitmapOpacity();
   genericRawDrawBitmap_RGBA8888(destX, destY, bitmap, (uint16_t*)saveBackground, X1, Y1, XCount, YCount,
-                                 [&] (int y)                                       { return m_viewPort[y]; },            // rawGetRow
-                                 [&] (uint16_t * row, int x)                       { return row[x]; },                   // rawGetPixelInRow
-                                 [&] (uint16_t * row, int x, RGBA8888 const & src) { row[x] = RGBA8888toNative(src); }   // rawSetPixelInRow
+                                 [&] (int y)                                       { return viewPortRow(y); },   // rawGetRow
+                                 [&] (uint16_t * row, int x)                       { return row[x]; },          // rawGetPixelInRow
+                                 [&] (uint16_t * row, int x, RGBA8888 const & src) {                            // rawSetPixelInRow
+                                   blendRGB565BEPixel(row + x, RGBA8888toNative(src), combineAlpha(src.A, opacity));
+                                 }
                                 );
 }
 
 
+void TFTController::setBitmapCacheSize(int value)
+{
+  value = imax(0, value);
+  if (value != m_bitmapCacheBudget) {
+    if (m_viewPort)
+      suspendBackgroundPrimitiveExecution();
+    while (m_bitmapCacheCount > 0)
+      bitmapCacheRemove(m_bitmapCacheCount - 1);
+    m_bitmapCacheBudget = value;
+    if (m_viewPort)
+      resumeBackgroundPrimitiveExecution();
+  }
+}
+
+
+void TFTController::invalidateBitmapCache(Bitmap const * bitmap)
+{
+  if (m_viewPort)
+    suspendBackgroundPrimitiveExecution();
+  for (int i = m_bitmapCacheCount - 1; i >= 0; --i)
+    if (bitmap == nullptr || m_bitmapCache[i]->bitmap == bitmap)
+      bitmapCacheRemove(i);
+  if (m_viewPort)
+    resumeBackgroundPrimitiveExecution();
+}
+
+
+void TFTController::bitmapCacheRemove(int index)
+{
+  m_bitmapCacheUsed -= m_bitmapCache[index]->size;
+  heap_caps_free(m_bitmapCache[index]);
+  m_bitmapCache[index] = m_bitmapCache[--m_bitmapCacheCount];
+}
+
+
+// Returns the converted bitmap, converting it if necessary. Returns nullptr when the bitmap has to be drawn directly.
+TFTBitmapCacheEntry * TFTController::bitmapCacheGet(Bitmap const * bitmap)
+{
+  if (m_bitmapCacheBudget == 0)
+    return nullptr;
+
+  // both cores may be drawing, just look for an already converted bitmap
+  const bool readOnly = bandsActive();
+
+  for (int i = 0; i < m_bitmapCacheCount; ++i) {
+    auto entry = m_bitmapCache[i];
+    if (entry->bitmap != bitmap)
+      continue;
+    if (entry->data == bitmap->data && entry->format == bitmap->format && entry->nativeFormat == nativePixelFormat() &&
+        (bitmap->format != PixelFormat::Mask || entry->foreground == preparePixel(bitmap->foregroundColor))) {
+      entry->lastUse = ++m_bitmapCacheClock;
+      ++m_bitmapCacheStats.hits;
+      return entry;
+    }
+    // bitmap has been changed
+    if (!readOnly)
+      bitmapCacheRemove(i--);
+  }
+
+  ++m_bitmapCacheStats.misses;
+  return readOnly ? nullptr : bitmapCacheConvert(bitmap);
+}
+
+
+// Converts the bitmap to native pixels and finds its runs of opaque and of translucent pixels. Alpha values are kept
+// only for bitmaps having translucent pixels. Least recently used bitmaps are removed to stay inside the budget.
+TFTBitmapCacheEntry * TFTController::bitmapCacheConvert(Bitmap const * bitmap)
+{
+  const int width  = bitmap->width;
+  const int height = bitmap->height;
+  const PixelFormat format = bitmap->format;
+  uint8_t const * data = bitmap->data;
+
+  auto alphaAt = [&] (int x, int y) -> int {
+    switch (format) {
+      case PixelFormat::Mask:
+        return (data[y * ((width + 7) / 8) + (x >> 3)] << (x & 7)) & 0x80 ? 255 : 0;
+      case PixelFormat::RGBA2222:
+        return (data[y * width + x] >> 6) * 85;
+      default:
+        return ((RGBA8888 const *) data)[y * width + x].A;
+    }
+  };
+
+  // 0 = transparent, 1 = opaque, 2 = translucent
+  auto kind = [&] (int x, int y) -> int {
+    int alpha = alphaAt(x, y);
+    return alpha == 0 ? 0 : (alpha == 255 ? 1 : 2);
+  };
+
+  if (data == nullptr || width > TFT_BITMAP_CACHE_MAXWIDTH || (format != PixelFormat::Mask && format != PixelFormat::RGBA2222 && format != PixelFormat::RGBA8888))
+    return nullptr;
+
+  int runsCount = 0;
+  bool translucent = false;
+  for (int y = 0; y < height; ++y)
+    for (int x = 0, prev = 0; x < width; ++x) {
+      int k = kind(x, y);
+      if (k && k != prev)
+        ++runsCount;
+      translucent |= (k == 2);
+      prev = k;
+    }
+
+  const int size = sizeof(TFTBitmapCacheEntry) + (height + 1) * sizeof(uint32_t) + width * height * sizeof(uint16_t) + runsCount * 2 * sizeof(uint16_t) +
+                   (translucent ? width * height : 0);
+  if (size > m_bitmapCacheBudget)
+    return nullptr;
+
+  while (m_bitmapCacheCount > 0 && (m_bitmapCacheCount == TFT_BITMAP_CACHE_MAX_ENTRIES || m_bitmapCacheUsed + size > m_bitmapCacheBudget)) {
+    int lru = 0;
+    for (int i = 1; i < m_bitmapCacheCount; ++i)
+      if (m_bitmapCacheClock - m_bitmapCache[i]->lastUse > m_bitmapCacheClock - m_bitmapCache[lru]->lastUse)
+        lru = i;
+    bitmapCacheRemove(lru);
+    ++m_bitmapCacheStats.evictions;
+  }
+
+  auto entry = (TFTBitmapCacheEntry*) heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (!entry)
+    return nullptr;
+  entry->bitmap       = bitmap;
+  entry->data         = data;
+  entry->format       = format;
+  entry->nativeFormat = nativePixelFormat();
+  entry->foreground   = preparePixel(bitmap->foregroundColor);
+  entry->size         = size;
+  entry->lastUse      = ++m_bitmapCacheClock;
+  entry->rowRuns      = (uint32_t*) (entry + 1);
+  entry->pixels       = (uint16_t*) (entry->rowRuns + height + 1);
+  entry->runs         = entry->pixels + width * height;
+  entry->alpha        = translucent ? (uint8_t*) (entry->runs + runsCount * 2) : nullptr;
+
+  uint16_t * px = entry->pixels;
+  int r = 0;
+  for (int y = 0; y < height; ++y) {
+    entry->rowRuns[y] = r;
+    for (int x = 0, prev = 0; x < width; ++x, ++px) {
+      const int alpha = alphaAt(x, y);
+      const int k = alpha == 0 ? 0 : (alpha == 255 ? 1 : 2);
+      if (entry->alpha)
+        entry->alpha[y * width + x] = alpha;
+      if (k == 0) {
+        *px = 0;
+        prev = 0;
+        continue;
+      }
+      switch (format) {
+        case PixelFormat::Mask:
+          *px = entry->foreground;
+          break;
+        case PixelFormat::RGBA2222:
+          *px = RGBA2222toNative(data[y * width + x]);
+          break;
+        default:
+          *px = RGBA8888toNative(((RGBA8888 const *) data)[y * width + x]);
+          break;
+      }
+      if (k != prev) {
+        entry->runs[r * 2]     = x;
+        entry->runs[r * 2 + 1] = k == 2 ? TFT_BITMAP_CACHE_BLENDRUN : 0;
+        ++r;
+        prev = k;
+      }
+      ++entry->runs[r * 2 - 1];
+    }
+  }
+  entry->rowRuns[height] = r;
+
+  m_bitmapCache[m_bitmapCacheCount++] = entry;
+  m_bitmapCacheUsed += size;
+  return entry;
+}
+
+
+// Copies the opaque runs of a converted bitmap and blends the translucent ones. The whole rectangle is saved when
+// saveBackground is not null.
+void TFTController::rawDrawCachedBitmap(TFTBitmapCacheEntry const * entry, int destX, int destY, uint16_t * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  const int width   = entry->bitmap->width;
+  const int yEnd    = Y1 + YCount;
+  const int opacity = bitmapOpacity();
+  for (int y = Y1; y < yEnd; ++y, ++destY) {
+    uint16_t * dst = viewPortRow(destY) + destX;   // pixel X1 of the bitmap
+    if (saveBackground)
+      memcpy(saveBackground + y * width + X1, dst, XCount * sizeof(uint16_t));
+    drawCachedBitmapRow(entry, y, dst, X1, XCount, opacity);
+  }
+}
+
+
+// Draws pixels X1...X1+XCount-1 of row "y" of a converted bitmap. "dst" points to the destination of pixel X1.
+void TFTController::drawCachedBitmapRow(TFTBitmapCacheEntry const * entry, int y, uint16_t * dst, int X1, int XCount, int opacity)
+{
+  const int width = entry->bitmap->width;
+  const int xEnd  = X1 + XCount;
+  uint16_t const * src = entry->pixels + y * width;
+  for (uint32_t r = entry->rowRuns[y]; r < entry->rowRuns[y + 1]; ++r) {
+    const int length = entry->runs[r * 2 + 1];
+    const int x1 = tmax<int>(X1, entry->runs[r * 2]);
+    const int x2 = tmin<int>(xEnd, entry->runs[r * 2] + (length & ~TFT_BITMAP_CACHE_BLENDRUN));
+    if (x1 >= x2)
+      continue;
+    if (length & TFT_BITMAP_CACHE_BLENDRUN) {
+      uint8_t const * alpha = entry->alpha + y * width;
+      for (int x = x1; x < x2; ++x)
+        blendRGB565BEPixel(dst + x - X1, src[x], combineAlpha(alpha[x], opacity));
+    } else
+      blendRGB565BERun(dst + x1 - X1, src + x1, x2 - x1, opacity);
+  }
+}
+
+
+// Like drawCachedBitmapRow() for bitmaps not in the cache (cache disabled or full)
+void TFTController::composeBitmapRow(Bitmap const * bitmap, int y, uint16_t * dst, int X1, int XCount, int opacity)
+{
+  const int width = bitmap->width;
+  const int xEnd  = X1 + XCount;
+  switch (bitmap->format) {
+    case PixelFormat::Native:
+      blendRGB565BERun(dst, (uint16_t const *) bitmap->data + y * width + X1, XCount, opacity);
+      break;
+    case PixelFormat::Mask:
+    {
+      const uint16_t foreground = preparePixel(bitmap->foregroundColor);
+      uint8_t const * src = bitmap->data + y * ((width + 7) / 8);
+      for (int x = X1; x < xEnd; ++x, ++dst)
+        if ((src[x >> 3] << (x & 7)) & 0x80)
+          blendRGB565BEPixel(dst, foreground, opacity);
+      break;
+    }
+    case PixelFormat::RGBA2222:
+    {
+      uint8_t const * src = bitmap->data + y * width;
+      for (int x = X1; x < xEnd; ++x, ++dst)
+        blendRGB565BEPixel(dst, RGBA2222toNative(src[x]), combineAlpha((src[x] >> 6) * 85, opacity));
+      break;
+    }
+    case PixelFormat::RGBA8888:
+    {
+      RGBA8888 const * src = (RGBA8888 const *) bitmap->data + y * width;
+      for (int x = X1; x < xEnd; ++x, ++dst)
+        blendRGB565BEPixel(dst, RGBA8888toNative(src[x]), combineAlpha(src[x].A, opacity));
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+
+void TFTController::enableSpriteCompositing(bool value)
+{
+  if (isDoubleBuffered() || value == spritesComposed())
+    return;
+  suspendBackgroundPrimitiveExecution();
+  // sprites drawn into the viewport must be removed before switching
+  Rect updateRect = Rect(0, 0, -1, -1);
+  hideAllSprites(updateRect);
+  setSpritesComposed(value);
+  for (int i = 0; i <= spritesCount(); ++i) {
+    Sprite * sprite = i < spritesCount() ? getSprite(i) : mouseCursor();
+    sprite->savedBackgroundWidth = sprite->savedBackgroundHeight = 0;
+    sprite->dirty  = true;
+    sprite->redraw = false;
+    // setSprites() and setMouseCursor() don't allocate background buffers of composed sprites
+    if (!value)
+      allocSpriteBackground(sprite);
+  }
+  resumeBackgroundPrimitiveExecution();
+  if (m_viewPort)
+    sendRefresh();
+}
+
+
+// Collects the sprites placed by showSprites() (in compositing mode the saved rectangle is the composed one),
+// sorted by z. The mouse cursor is always the last one.
+void TFTController::prepareComposition()
+{
+  m_composeCount  = 0;
+  m_composePixels = 0;
+  m_composeTime   = 0;
+  if (!spritesComposed())
+    return;
+  const int count = spritesCount() + 1;
+  if (count > m_composeCapacity) {
+    // items are rebuilt on each update, no need to keep them
+    free(m_composeItems);
+    m_composeItems    = (TFTComposeItem *) malloc(sizeof(TFTComposeItem) * count);
+    m_composeCapacity = m_composeItems ? count : 0;
+    if (!m_composeItems)
+      return;
+  }
+  for (int i = 0; i < count; ++i) {
+    Sprite * sprite = i < spritesCount() ? getSprite(i) : mouseCursor();
+    if (sprite->savedBackgroundWidth == 0)
+      continue;
+    // frame changed after showSprites(): next update will compose it
+    Bitmap const * bitmap = sprite->getFrame();
+    if (!bitmap || bitmap->width != sprite->savedBackgroundWidth || bitmap->height != sprite->savedBackgroundHeight)
+      continue;
+    TFTComposeItem item;
+    item.bitmap  = bitmap;
+    item.rect    = Rect(sprite->savedX, sprite->savedY, sprite->savedX + bitmap->width - 1, sprite->savedY + bitmap->height - 1);
+    item.opacity = sprite->opacity;
+    item.z       = i < spritesCount() ? sprite->z : INT8_MAX;
+    // stable insertion sort, sprites are few
+    int j = m_composeCount++;
+    for (; j > 0 && m_composeItems[j - 1].z > item.z; --j)
+      m_composeItems[j] = m_composeItems[j - 1];
+    m_composeItems[j] = item;
+  }
+}
+
+
+void TFTController::endComposition()
+{
+  if (m_composePixels > 0) {
+    ++m_composeStats.frames;
+    m_composeStats.lastPixels   = m_composePixels;
+    m_composeStats.lastTime     = m_composeTime;
+    m_composeStats.totalPixels += m_composePixels;
+    m_composeStats.totalTime   += m_composeTime;
+  }
+  m_composeCount = 0;
+}
+
+
+// Composes sprites over "rows" rows of "width" pixels, copied from viewport position (x1, y1) to "dest"
+void TFTController::composeSprites(uint16_t * dest, int x1, int y1, int rows, int width)
+{
+  const int64_t startTime = esp_timer_get_time();
+  const Rect area = Rect(x1, y1, x1 + width - 1, y1 + rows - 1);
+  for (int i = 0; i < m_composeCount; ++i) {
+    TFTComposeItem const & item = m_composeItems[i];
+    if (!item.rect.intersects(area))
+      continue;
+    const Rect r = item.rect.intersection(area);
+    const int X1     = r.X1 - item.rect.X1;
+    const int XCount = r.width();
+    auto entry = bitmapCacheGet(item.bitmap);
+    uint16_t * dst = dest + (r.Y1 - y1) * width + (r.X1 - x1);
+    for (int y = r.Y1 - item.rect.Y1; y <= r.Y2 - item.rect.Y1; ++y, dst += width) {
+      if (entry)
+        drawCachedBitmapRow(entry, y, dst, X1, XCount, item.opacity);
+      else
+        composeBitmapRow(item.bitmap, y, dst, X1, XCount, item.opacity);
+    }
+    m_composePixels += XCount * r.height();
+  }
+  m_composeTime += esp_timer_get_time() - startTime;
+}
+
+
+void TFTController::setGlyphCacheSize(int value)
+{
+  value = imax(0, value);
+  if (value != m_glyphCacheBudget) {
+    if (m_viewPort)
+      suspendBackgroundPrimitiveExecution();
+    clearGlyphCache();
+    m_glyphCacheBudget = value;
+    if (m_viewPort)
+      resumeBackgroundPrimitiveExecution();
+  }
+}
+
+
+void TFTController::invalidateGlyphCache()
+{
+  if (m_viewPort)
+    suspendBackgroundPrimitiveExecution();
+  clearGlyphCache();
+  if (m_viewPort)
+    resumeBackgroundPrimitiveExecution();
+}
+
+
+void TFTController::clearGlyphCache()
+{
+  while (m_glyphCacheOldest) {
+    auto entry = m_glyphCacheOldest;
+    glyphCacheUnlink(entry);
+    heap_caps_free(entry);
+  }
+}
+
+
+// removes the entry from its hash bucket and from the LRU list, without freeing it
+void TFTController::glyphCacheUnlink(TFTGlyphCacheEntry * entry)
+{
+  auto link = &m_glyphCache[entry->bucket];
+  while (*link != entry)
+    link = &(*link)->next;
+  *link = entry->next;
+  (entry->newer ? entry->newer->older : m_glyphCacheNewest) = entry->older;
+  (entry->older ? entry->older->newer : m_glyphCacheOldest) = entry->newer;
+  m_glyphCacheUsed -= entry->size;
+}
+
+
+// Returns the glyph rendered with filled background using penPattern and brushPattern (already inverted and faint),
+// rendering it if necessary. Returns nullptr when the glyph has to be drawn directly.
+// Entries are kept in a list from the most to the least recently used one, so the entry to evict is always the last.
+TFTGlyphCacheEntry * TFTController::glyphCacheGet(Glyph const & glyph, GlyphOptions glyphOptions, uint16_t penPattern, uint16_t brushPattern)
+{
+  const int width   = glyph.width;
+  const int height  = glyph.height;
+  const int options = glyphOptions.bold | (glyphOptions.blank << 1) | (glyphOptions.underline << 2);
+
+  const uint32_t key = (uint32_t)(uintptr_t)glyph.data ^ ((uint32_t)penPattern << 16) ^ brushPattern ^ (options << 13);
+  const int bucket = ((key * 2654435761u) >> 16) & (TFT_GLYPH_CACHE_BUCKETS - 1);
+
+  // both cores may be drawing, just look for an already rendered glyph
+  const bool readOnly = bandsActive();
+
+  for (auto entry = m_glyphCache[bucket]; entry; entry = entry->next) {
+    if (entry->data == glyph.data && entry->pen == penPattern && entry->brush == brushPattern && entry->options == options &&
+        entry->width == width && entry->height == height) {
+      ++m_glyphCacheStats.hits;
+      if (!readOnly && entry != m_glyphCacheNewest) {
+        // move to the head of LRU list
+        entry->newer->older = entry->older;
+        (entry->older ? entry->older->newer : m_glyphCacheOldest) = entry->newer;
+        entry->older = m_glyphCacheNewest;
+        entry->newer = nullptr;
+        m_glyphCacheNewest->newer = entry;
+        m_glyphCacheNewest = entry;
+      }
+      return entry;
+    }
+  }
+
+  ++m_glyphCacheStats.misses;
+
+  const int size = sizeof(TFTGlyphCacheEntry) + width * height * sizeof(uint16_t);
+  if (readOnly || size > m_glyphCacheBudget)
+    return nullptr;
+
+  // evict least recently used glyphs, reusing the memory of the last one when it has the same size (same font)
+  TFTGlyphCacheEntry * entry = nullptr;
+  while (m_glyphCacheOldest && m_glyphCacheUsed + size > m_glyphCacheBudget) {
+    heap_caps_free(entry);
+    entry = m_glyphCacheOldest;
+    glyphCacheUnlink(entry);
+    ++m_glyphCacheStats.evictions;
+  }
+  if (entry && entry->size != size) {
+    heap_caps_free(entry);
+    entry = nullptr;
+  }
+  if (!entry)
+    entry = (TFTGlyphCacheEntry*) heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (!entry)
+    return nullptr;
+  entry->data    = glyph.data;
+  entry->width   = width;
+  entry->height  = height;
+  entry->options = options;
+  entry->bucket  = bucket;
+  entry->pen     = penPattern;
+  entry->brush   = brushPattern;
+  entry->size    = size;
+  entry->pixels  = (uint16_t*) (entry + 1);
+
+  const int glyphWidthByte  = (width + 7) / 8;
+  const int underlineY      = glyphOptions.underline ? height - FABGLIB_UNDERLINE_POSITION - 1 : -1;
+  const uint32_t widthMask  = width == 32 ? 0xffffffff : ~(0xffffffff >> width);
+  uint16_t * px = entry->pixels;
+  for (int y = 0; y < height; ++y) {
+    uint32_t src = 0;
+    if (y == underlineY)
+      src = glyphOptions.blank ? 0 : widthMask;
+    else if (!glyphOptions.blank)
+      src = glyphRowMask(glyph.data + y * glyphWidthByte, glyphWidthByte, glyphOptions.bold) & widthMask;
+    for (int x = 0; x < width; ++x, src <<= 1)
+      *px++ = src & 0x80000000 ? penPattern : brushPattern;
+  }
+
+  entry->next  = m_glyphCache[bucket];
+  m_glyphCache[bucket] = entry;
+  entry->newer = nullptr;
+  entry->older = m_glyphCacheNewest;
+  (m_glyphCacheNewest ? m_glyphCacheNewest->newer : m_glyphCacheOldest) = entry;
+  m_glyphCacheNewest = entry;
+  m_glyphCacheUsed += size;
+  return entry;
+}
+
+
+// Finds which tiles of the back buffer differ from the last frame sent, then swaps back and front buffers.
+// Changed tiles are sent by the update task (see sendChangedTiles()) after the drawing task has been notified,
+// so next frame can be drawn while this one is sent.
+// Tiles are compared by a 32 bit hash only, a memcmp() with the front buffer would read it again from PSRAM at each frame.
+// A changed tile whose hash collides with the previous one (about 1 in 2^32 changed tiles) is not sent: it stays stale on
+// the display until its content changes again.
 void TFTController::swapBuffers()
 {
-  // nothing to do, we just send current view port to the device
-  sendScreenBuffer(Rect(0, 0, getViewPortWidth() - 1, getViewPortHeight() - 1));
+  if (!m_viewPortVisible) {
+    // not double buffered, just send current view port
+    sendScreenBuffer(Rect(0, 0, getViewPortWidth() - 1, getViewPortHeight() - 1));
+    return;
+  }
+
+  // tiles are compared and sent from PSRAM, and m_viewPort is going to be swapped
+  flushTileCache(true);
+
+  const int width  = m_viewPortWidth;
+  const int height = m_viewPortHeight;
+  uint32_t * hash  = m_tileRowHash;
+
+  for (int ty = 0; ty < m_tileRows; ++ty) {
+
+    // FNV-1a like hash of each tile, processing a full row of the tiles row at the time
+    for (int tx = 0; tx < m_tileCols; ++tx)
+      hash[tx] = 2166136261u;
+    const int y1 = ty * TFT_TILE_SIZE;
+    const int y2 = tmin(y1 + TFT_TILE_SIZE, height);
+    for (int y = y1; y < y2; ++y) {
+      uint16_t const * row = m_viewPort[y];
+      for (int tx = 0, x = 0; tx < m_tileCols; ++tx) {
+        uint32_t h = hash[tx];
+        const int xEnd = tmin(x + TFT_TILE_SIZE, width);
+        for (; x < xEnd; ++x)
+          h = (h ^ row[x]) * 16777619u;
+        hash[tx] = h;
+      }
+    }
+
+    uint32_t * tileHash  = m_tileHash + ty * m_tileCols;
+    uint8_t *  tileDirty = m_tileDirty + ty * m_tileCols;
+    for (int tx = 0; tx < m_tileCols; ++tx) {
+      tileDirty[tx] = !m_tileHashValid || hash[tx] != tileHash[tx];
+      tileHash[tx]  = hash[tx];
+    }
+  }
+  m_tileHashValid = true;
+
+  tswap(m_viewPort, m_viewPortVisible);
+  m_framePending = true;
+}
+
+
+// sends tiles marked by swapBuffers(), merging adjacent tiles of the same tiles row
+void TFTController::sendChangedTiles()
+{
+  SPIBeginWrite();
+  for (int ty = 0; ty < m_tileRows; ++ty) {
+    uint8_t const * tileDirty = m_tileDirty + ty * m_tileCols;
+    for (int tx = 0; tx < m_tileCols; ) {
+      if (tileDirty[tx]) {
+        int txEnd = tx + 1;
+        while (txEnd < m_tileCols && tileDirty[txEnd])
+          ++txEnd;
+        writeScreenRect(Rect(tx * TFT_TILE_SIZE, ty * TFT_TILE_SIZE, txEnd * TFT_TILE_SIZE - 1, (ty + 1) * TFT_TILE_SIZE - 1), m_viewPortVisible);
+        tx = txEnd;
+      } else
+        ++tx;
+    }
+  }
+  SPIEndWrite();
+  m_framePending = false;
 }
 
 
@@ -37,6 +37,7 @@
 #include "SPI.h"
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "esp32-hal.h"
 #include "driver/spi_master.h"
@@ -49,7 +50,31 @@
 #define TFT_CASET      0x2A
 #define TFT_RASET      0x2B
 #define TFT_RAMWR      0x2C
+#define TFT_VSCRDEF    0x33
 #define TFT_MADCTL     0x36
+#define TFT_VSCRSADD   0x37
+
+// number of DMA buffers used to send the screen buffer (one is filled while the others are on the wire)
+#define TFT_DMA_BUFFERS 2
+
+// rows of each tile of the internal RAM tile cache (see TFTController.setTileCacheSize())
+#define TFT_CACHE_TILE_ROWS 8
+
+// maximum number of tiles of the internal RAM tile cache
+#define TFT_CACHE_MAX_TILES 16
+
+// maximum number of primitives executed in parallel by the bands workers before a barrier
+#define TFT_PARALLEL_BATCH  32
+
+// maximum number of bitmaps in the native bitmap cache (see TFTController.setBitmapCacheSize())
+#define TFT_BITMAP_CACHE_MAX_ENTRIES 32
+
+// in TFTBitmapCacheEntry.runs marks runs of translucent pixels, so bitmaps wider than TFT_BITMAP_CACHE_MAXWIDTH are not cached
+#define TFT_BITMAP_CACHE_BLENDRUN    0x8000
+#define TFT_BITMAP_CACHE_MAXWIDTH    0x7fff
+
+// number of hash buckets of the rendered glyph cache (see TFTController.setGlyphCacheSize()), must be a power of two
+#define TFT_GLYPH_CACHE_BUCKETS      64
 
 
 
@@ -68,6 +93,109 @@ enum class TFTOrientation {
 };
 
 
+/** \ingroup Enumerations
+ * @brief This enum defines how TFT viewport memory is allocated
+ */
+enum class TFTViewPortLayout {
+  Rows,               /**< Each row is allocated separately. Vertical scrolling swaps rows pointers. */
+  Contiguous,         /**< All rows are in a single 32 bytes aligned buffer. Vertical scrolling moves memory. */
+};
+
+
+/**
+ * @brief Counters of the TFT tile cache
+ */
+struct TFTTileCacheStats {
+  uint32_t hits;        /**< Rows accesses served by a tile already in cache */
+  uint32_t misses;      /**< Rows accesses that required to load a tile from PSRAM */
+  uint32_t writeBacks;  /**< Modified tiles written back to PSRAM */
+};
+
+
+/**
+ * @brief Counters of the TFT native bitmap cache
+ */
+struct TFTBitmapCacheStats {
+  uint32_t hits;        /**< Bitmap draws that used an already converted bitmap */
+  uint32_t misses;      /**< Bitmap draws of bitmaps not in cache */
+  uint32_t evictions;   /**< Converted bitmaps removed to make room for new ones */
+};
+
+
+/**
+ * @brief Counters of the TFT rendered glyph cache
+ */
+struct TFTGlyphCacheStats {
+  uint32_t hits;        /**< Glyph draws that copied an already rendered glyph */
+  uint32_t misses;      /**< Glyph draws of glyphs not in cache */
+  uint32_t evictions;   /**< Rendered glyphs removed to make room for new ones */
+};
+
+
+/**
+ * @brief Costs of TFT sprite compositing
+ */
+struct TFTComposeStats {
+  uint32_t frames;      /**< Screen updates that composed at least one sprite pixel */
+  uint32_t lastPixels;  /**< Sprite pixels composed by the last update */
+  uint32_t lastTime;    /**< Microseconds spent composing sprites by the last update */
+  uint32_t totalPixels; /**< Sprite pixels composed by all updates */
+  uint32_t totalTime;   /**< Microseconds spent composing sprites by all updates */
+};
+
+
+// A sprite to compose, in the order of composition
+struct TFTComposeItem {
+  Bitmap const * bitmap;
+  Rect           rect;
+  uint8_t        opacity;
+  int8_t         z;
+};
+
+
+// A bitmap converted to native pixels, plus the opaque runs of each row. Allocated as a single block.
+struct TFTBitmapCacheEntry {
+  Bitmap const *    bitmap;
+  uint8_t const *   data;           // bitmap->data at conversion time
+  PixelFormat       format;         // bitmap->format at conversion time
+  NativePixelFormat nativeFormat;
+  uint16_t          foreground;     // native foreground color of PixelFormat::Mask bitmaps
+  int               size;           // allocated bytes
+  uint32_t          lastUse;
+  uint16_t *        pixels;         // width * height native pixels
+  uint32_t *        rowRuns;        // for each row index of its first run, plus one final item
+  uint16_t *        runs;           // runs as pairs of first X and length, TFT_BITMAP_CACHE_BLENDRUN set for translucent runs
+  uint8_t *         alpha;          // width * height alpha values, nullptr when no pixel is translucent
+};
+
+
+// A glyph rendered with filled background. Identified by font data, size, bold/blank/underline options and the
+// final (inverted, reduced luminosity) pen and brush colors. Allocated as a single block.
+struct TFTGlyphCacheEntry {
+  TFTGlyphCacheEntry * next;        // next entry of the same hash bucket
+  TFTGlyphCacheEntry * newer;       // more recently used entry
+  TFTGlyphCacheEntry * older;       // less recently used entry
+  uint8_t const *      data;        // glyph data (font character)
+  uint8_t              width;
+  uint8_t              height;
+  uint8_t              options;     // bit 0 = bold, bit 1 = blank, bit 2 = underline
+  uint8_t              bucket;
+  uint16_t             pen;
+  uint16_t             brush;
+  int                  size;        // allocated bytes
+  uint16_t *           pixels;      // width * height native pixels
+};
+
+
+// Native pen and brush patterns for each combination of 4 glyph pixels, used to draw glyphs with filled background
+struct TFTGlyphTable {
+  bool     valid;
+  uint16_t pen;
+  uint16_t brush;
+  uint16_t patterns[16][4];   // nibble (MSB = leftmost pixel) -> 4 native pixels
+};
+
+
 /**
  * @brief Base abstract class for TFT drivers with SPI connection.
  *
@@ -166,7 +294,8 @@ public:
    * @param modeline Native display reoslution. Allowed values like TFT_240x240, TFT_240x320...
    * @param viewPortWidth Virtual viewport width. Should be larger or equal to display native width.
    * @param viewPortHeight Virtual viewport height. Should be larger or equal to display native height.
-   * @param doubleBuffered if True allocates another viewport of the same size to use as back buffer.
+   * @param doubleBuffered if True allocates another viewport of the same size to use as back buffer. On swap only
+   *                       the tiles that differ from the previous frame are sent, while the next frame is drawn.
    *
    * Example:
    *
@@ -246,6 +375,32 @@ public:
    */
   void setOrientation(TFTOrientation value, bool force = false);
 
+  /**
+   * @brief Keeps viewport and its content when orientation changes
+   *
+   * When enabled setOrientation() doesn't reallocate the viewport and doesn't reset paint state: the viewport keeps its
+   * size and content, the display memory access control (MADCTL) and the address window offsets are changed, then the
+   * whole viewport is sent again. So what has been drawn appears rotated on the display without redrawing it.<br>
+   * Applies when the viewport fits the rotated screen: always for Rotate0 and Rotate180, for Rotate90 and Rotate270 only on
+   * square displays (or viewports smaller than the screen). Otherwise the viewport is reallocated as when disabled.
+   *
+   * @param value True keeps viewport when orientation changes.
+   *
+   * Example:
+   *
+   *     // the screen is turned upside down, drawings are kept
+   *     DisplayController.enableCanonicalViewPort(true);
+   *     DisplayController.setOrientation(fabgl::TFTOrientation::Rotate180);
+   */
+  void enableCanonicalViewPort(bool value) { m_canonicalViewPort = value; }
+
+  /**
+   * @brief Determines whether viewport and its content are kept when orientation changes
+   *
+   * @return True when viewport is kept
+   */
+  bool canonicalViewPortEnabled() { return m_canonicalViewPort; }
+
   /**
    * @brief Inverts horizontal axis
    *
@@ -255,6 +410,255 @@ public:
    */
   void setReverseHorizontal(bool value);
 
+  /**
+   * @brief Sets how viewport memory is allocated
+   *
+   * Rows layout (default) allocates each row separately, so it fits in fragmented memory and vertical scrolling just swaps rows pointers.
+   * Contiguous layout allocates a single 32 bytes aligned buffer, making clear, full width scrolling and transfers operate on many rows at once.<br>
+   * Can be called before or after setResolution(). When called after the viewport is reallocated and cleared.
+   *
+   * @param value Viewport layout.
+   *
+   * Example:
+   *
+   *     DisplayController.setViewPortLayout(fabgl::TFTViewPortLayout::Contiguous);
+   *     DisplayController.setResolution(TFT_320x480);
+   */
+  void setViewPortLayout(TFTViewPortLayout value);
+
+  /**
+   * @brief Gets current viewport memory layout
+   *
+   * @return Viewport layout
+   */
+  TFTViewPortLayout viewPortLayout() { return m_viewPortLayout; }
+
+  /**
+   * @brief Enables or disables pipelined DMA transfers of the screen buffer
+   *
+   * When enabled (default) several rows at the time are copied into DMA buffers and queued, so copying the next rows
+   * overlaps with sending the previous ones. When disabled each row is copied and sent before copying the next one.<br>
+   * Used only when the controller is initialized using the SDK driver.
+   *
+   * @param value True enables pipelined transfers.
+   */
+  void enableDMAPipeline(bool value) { m_DMAPipeline = value; }
+
+  /**
+   * @brief Enables or disables parallel execution of primitives on both cores
+   *
+   * When enabled the viewport is split in two horizontal bands, each one drawn by a task running on a different core.
+   * Both tasks execute the same primitives, clipped to their band, so paint state remains the same. Primitives that move
+   * pixels across bands (VScroll, CopyRect), refresh sprites or swap buffers wait for both tasks to complete and are
+   * executed alone.<br>
+   * Applies to primitives executed in background (not double buffered). While enabled the tile cache is bypassed.
+   *
+   * @param value True enables parallel execution.
+   *
+   * Example:
+   *
+   *     DisplayController.enableParallelExecution(true);
+   */
+  void enableParallelExecution(bool value);
+
+  /**
+   * @brief Enables or disables hardware vertical scrolling
+   *
+   * When enabled, full width vertical scrolls (see Canvas.scroll()) move the display content using the scroll area of the
+   * controller (VSCRDEF/VSCRSADD commands), so only the rows uncovered by the scroll are sent instead of the whole scrolling
+   * region. The viewport is still scrolled in memory, and rows sent later are remapped to where the controller shows them.<br>
+   * Applies when orientation is TFTOrientation::Rotate0, the viewport has the same size of the screen and it is not double
+   * buffered. Otherwise scrolling is done as usual.
+   *
+   * @param value True enables hardware scrolling.
+   *
+   * Example:
+   *
+   *     DisplayController.enableHardwareScrolling(true);
+   */
+  void enableHardwareScrolling(bool value);
+
+  /**
+   * @brief Determines whether hardware vertical scrolling is enabled
+   *
+   * @return True when hardware scrolling is enabled
+   */
+  bool hardwareScrollingEnabled() { return m_hwScroll; }
+
+  /**
+   * @brief Enables or disables sprites compositing
+   *
+   * When enabled sprites and mouse cursor are not drawn into the viewport, which contains just the background painted by
+   * primitives. They are composed over the background while the changed rectangles are sent to the display, by ascending
+   * Sprite.z (sprites with the same z follow array order), and the mouse cursor is composed over all of them.
+   * So sprites don't need background buffers, painting primitives never restores sprites, and a moved sprite costs just
+   * sending its old and new rectangles.<br>
+   * Sprites are always over primitives (allowDraw of dynamic sprites is ignored), static sprites are composed again
+   * when allowDraw is set. Set Sprite.dirty after changing opacity or z.<br>
+   * Should be enabled before setSprites() and setMouseCursor(), so background buffers are not allocated. When disabled background
+   * buffers of current sprites and mouse cursor are allocated again. Does nothing when double buffered.
+   * Use spriteCompositingStats() to get the cost of composition.
+   *
+   * @param value True enables sprites compositing.
+   *
+   * Example:
+   *
+   *     DisplayController.enableSpriteCompositing(true);
+   *     DisplayController.setSprites(sprites, 10);
+   */
+  void enableSpriteCompositing(bool value);
+
+  /**
+   * @brief Determines whether sprites compositing is enabled
+   *
+   * @return True when sprites compositing is enabled
+   */
+  bool spriteCompositingEnabled() { return spritesComposed(); }
+
+  /**
+   * @brief Gets the cost of sprites compositing, for the last screen update and in total
+   *
+   * @return Composition counters
+   */
+  TFTComposeStats spriteCompositingStats() { return m_composeStats; }
+
+  /**
+   * @brief Resets sprites compositing counters
+   */
+  void resetSpriteCompositingStats() { m_composeStats = { }; }
+
+  /**
+   * @brief Sets the number of tiles of the internal RAM cache
+   *
+   * Viewport is allocated in PSRAM, which is much slower than internal RAM. The tile cache keeps the last used
+   * tiles (bands of TFT_CACHE_TILE_ROWS full rows) in internal RAM, so primitives draw there. Modified tiles are
+   * written back to PSRAM when evicted, and are sent to the display directly from the cache while they are resident.<br>
+   * Each tile requires TFT_CACHE_TILE_ROWS * viewport width * 2 bytes of internal RAM. If there isn't enough memory
+   * the cache is disabled. Can be called before or after setResolution().
+   *
+   * @param value Number of tiles (0 = disabled, otherwise 2 to TFT_CACHE_MAX_TILES). Default is 0.
+   *
+   * Example:
+   *
+   *     // 4 tiles, 30KBytes at 480 pixels width
+   *     DisplayController.setTileCacheSize(4);
+   */
+  void setTileCacheSize(int value);
+
+  /**
+   * @brief Gets the number of tiles of the internal RAM cache
+   *
+   * @return Number of tiles (0 = disabled)
+   */
+  int tileCacheSize() { return m_tileCacheMem ? m_tileCacheSize : 0; }
+
+  /**
+   * @brief Gets tile cache hits, misses and write backs counters
+   *
+   * @return Cache counters
+   */
+  TFTTileCacheStats tileCacheStats() { return m_tileCacheStats; }
+
+  /**
+   * @brief Resets tile cache counters
+   */
+  void resetTileCacheStats() { m_tileCacheStats = { }; }
+
+  /**
+   * @brief Sets the memory budget of the native bitmap cache
+   *
+   * Drawing RGBA2222, RGBA8888 and Mask bitmaps (and sprites) converts every pixel to the native format. The bitmap cache
+   * keeps the last drawn bitmaps already converted, with the opaque and translucent runs of each row, so drawing becomes a
+   * copy of opaque spans (translucent pixels are still blended). Least recently used bitmaps are removed when the budget
+   * is exceeded, and bitmaps larger than the budget are not cached. Up to TFT_BITMAP_CACHE_MAX_ENTRIES bitmaps are kept in internal RAM.<br>
+   * Bitmaps are identified by address and data pointer: call invalidateBitmapCache() after changing the pixels of a bitmap,
+   * or before freeing a bitmap whose memory could be reused by another one.
+   *
+   * @param value Budget in bytes (0 = disabled). Default is 0.
+   *
+   * Example:
+   *
+   *     DisplayController.setBitmapCacheSize(16384);
+   */
+  void setBitmapCacheSize(int value);
+
+  /**
+   * @brief Gets the memory budget of the native bitmap cache
+   *
+   * @return Budget in bytes (0 = disabled)
+   */
+  int bitmapCacheSize() { return m_bitmapCacheBudget; }
+
+  /**
+   * @brief Removes a bitmap, or all bitmaps, from the native bitmap cache
+   *
+   * @param bitmap Bitmap to remove. If nullptr all bitmaps are removed.
+   */
+  void invalidateBitmapCache(Bitmap const * bitmap = nullptr);
+
+  /**
+   * @brief Gets bitmap cache hits, misses and evictions counters
+   *
+   * @return Cache counters
+   */
+  TFTBitmapCacheStats bitmapCacheStats() { return m_bitmapCacheStats; }
+
+  /**
+   * @brief Resets bitmap cache counters
+   */
+  void resetBitmapCacheStats() { m_bitmapCacheStats = { }; }
+
+  /**
+   * @brief Sets the memory budget of the rendered glyph cache
+   *
+   * Text drawn with filled background (Canvas.drawText(), drawChar() and Terminal cells) rasterizes every glyph from the
+   * 1 bit font data. The glyph cache keeps the last drawn glyphs already rendered in native format, for each combination
+   * of font character, colors and bold/blank/underline/invert/faint options, so drawing becomes a copy of rows. Least
+   * recently used glyphs are removed when the budget is exceeded. Italic, double width, wider than 32 pixels and transparent
+   * background glyphs are not cached.<br>
+   * A glyph of a 8x16 font needs about 290 bytes. A budget smaller than the set of glyphs and colors on screen makes drawing
+   * slower than without cache: use glyphCacheStats() to tune it.<br>
+   * Glyphs are identified by their data pointer: call invalidateGlyphCache() after changing the data of a font in RAM.
+   *
+   * @param value Budget in bytes (0 = disabled). Default is 0.
+   *
+   * Example:
+   *
+   *     DisplayController.setGlyphCacheSize(32768);
+   */
+  void setGlyphCacheSize(int value);
+
+  /**
+   * @brief Gets the memory budget of the rendered glyph cache
+   *
+   * @return Budget in bytes (0 = disabled)
+   */
+  int glyphCacheSize() { return m_glyphCacheBudget; }
+
+  /**
+   * @brief Gets the memory currently used by the rendered glyph cache
+   *
+   * @return Used bytes
+   */
+  int glyphCacheUsed() { return m_glyphCacheUsed; }
+
+  /**
+   * @brief Removes all glyphs from the rendered glyph cache
+   */
+  void invalidateGlyphCache();
+
+  /**
+   * @brief Gets glyph cache hits, misses and evictions counters
+   *
+   * @return Cache counters
+   */
+  TFTGlyphCacheStats glyphCacheStats() { return m_glyphCacheStats; }
+
+  /**
+   * @brief Resets glyph cache counters
+   */
+  void resetGlyphCacheStats() { m_glyphCacheStats = { }; }
+
 
 protected:
 
@@ -262,6 +666,10 @@ protected:
 
   virtual void setupOrientation();
 
+  void writeOrientation();
+
+  bool viewPortFitsOrientation(TFTOrientation value);
+
   // abstract method of DisplayController
   int getBitmapSavePixelSize() { return 2; }
 
@@ -272,6 +680,11 @@ protected:
   void sendRefresh();
 
   void sendScreenBuffer(Rect updateRect);
+  void sendScreenBuffer(DirtyRegion const & dirtyRegion);
+  void writeScreenRect(Rect updateRect, uint16_t * * source);
+  void writeScreenWindow(Rect const & rect, int screenY, uint16_t * * source);
+  void writeScreenRows(uint16_t * * source, int x1, int y1, int y2, int width);
+  void sendChangedTiles();
   void writeCommand(uint8_t cmd);
   void writeByte(uint8_t data);
   void writeWord(uint16_t data);
@@ -288,9 +701,55 @@ protected:
 
   void allocViewPort();
   void freeViewPort();
+  uint16_t * * allocRows();
+  void freeRows(uint16_t * * rows);
+  bool contiguousRows(uint16_t * * rows, int y1, int y2);
+
+  // returns row "y" of m_viewPort to draw into, through the tile cache when enabled
+  uint16_t * viewPortRow(int y)
+  {
+    if (!m_tileCacheActive)
+      return m_viewPort[y];
+    const int band = y / TFT_CACHE_TILE_ROWS;
+    int slot = m_tileCacheSlot[band];
+    if (slot < 0)
+      slot = tileCacheLoad(band);
+    else
+      ++m_tileCacheStats.hits;
+    m_tileCacheDirty[slot]   = true;
+    m_tileCacheLastUse[slot] = ++m_tileCacheClock;
+    return tileCacheRow(slot, y);
+  }
+
+  uint16_t * tileCacheRow(int slot, int y) { return m_tileCacheMem + (slot * TFT_CACHE_TILE_ROWS + y % TFT_CACHE_TILE_ROWS) * m_viewPortWidth; }
+  uint16_t const * residentRow(uint16_t * * source, int y);
+  int tileCacheLoad(int band);
+  void tileCacheWriteBack(int slot);
+  void flushTileCache(bool writeBack);
+  void allocTileCache();
+  void freeTileCache();
+
+  TFTBitmapCacheEntry * bitmapCacheGet(Bitmap const * bitmap);
+  TFTBitmapCacheEntry * bitmapCacheConvert(Bitmap const * bitmap);
+  void bitmapCacheRemove(int index);
+  void rawDrawCachedBitmap(TFTBitmapCacheEntry const * entry, int destX, int destY, uint16_t * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  void drawCachedBitmapRow(TFTBitmapCacheEntry const * entry, int y, uint16_t * dst, int X1, int XCount, int opacity);
+  void composeBitmapRow(Bitmap const * bitmap, int y, uint16_t * dst, int X1, int XCount, int opacity);
+  void prepareComposition();
+  void endComposition();
+  void composeSprites(uint16_t * dest, int x1, int y1, int rows, int width);
+
+  TFTGlyphCacheEntry * glyphCacheGet(Glyph const & glyph, GlyphOptions glyphOptions, uint16_t penPattern, uint16_t brushPattern);
+  void glyphCacheUnlink(TFTGlyphCacheEntry * entry);
+  void clearGlyphCache();
 
   static void updateTaskFunc(void * pvParameters);
 
+  static void bandTaskFunc(void * pvParameters);
+
+  void execBatch(DirtyRegion & dirtyRegion);
+
   // abstract method of DisplayController
   void setPixelAt(PixelDesc const & pixelDesc, Rect & updateRect);
 
@@ -302,11 +761,25 @@ protected:
 
   void VScroll(int scroll, Rect & updateRect);
 
+  void VScrollRows(int scroll, Rect & updateRect);
+
+  bool hardwareScrollApplies(int scroll);
+
+  void hardwareVScroll(int scroll, DirtyRegion & dirtyRegion);
+
+  bool tryHardwareVScroll(int scroll, DirtyRegion & dirtyRegion);
+
+  void writeScrollArea();
+
+  void resetHardwareScroll();
+
   void HScroll(int scroll, Rect & updateRect);
 
   // abstract method of DisplayController
   void drawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect);
 
+  void drawGlyphRows(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect);
+
   // abstract method of DisplayController
   void swapBuffers();
 
@@ -356,7 +829,15 @@ protected:
   spi_device_handle_t m_SPIDevHandle;
 
   uint16_t * *       m_viewPort;
-  uint16_t *		 m_dmaBuffer;
+  uint16_t * *       m_viewPortVisible;   // front buffer on double buffering (nullptr otherwise)
+
+  // on TFTViewPortLayout::Contiguous rows are "m_viewPortStride" pixels apart
+  TFTViewPortLayout  m_viewPortLayout;
+  int16_t            m_viewPortStride;
+  uint16_t *         m_dmaBuffer[TFT_DMA_BUFFERS];
+  spi_transaction_t  m_dmaTrans[TFT_DMA_BUFFERS];
+  int16_t            m_dmaRows;       // rows each DMA buffer can contain
+  int16_t            m_maxTransferSize;   // maximum bytes of a SPI transaction allowed by the bus
 
   int16_t            m_screenWidth;
   int16_t            m_screenHeight;
@@ -385,6 +866,70 @@ protected:
 
   TFTOrientation     m_orientation;
   bool               m_reverseHorizontal;
+  bool               m_canonicalViewPort;
+
+  bool               m_DMAPipeline;
+
+  // hardware scrolling: rows m_hwScrollY1..m_hwScrollY2 are shown rotated by m_hwScrollOffset rows (none when Y1 > Y2)
+  bool               m_hwScroll;
+  int16_t            m_hwScrollY1;
+  int16_t            m_hwScrollY2;
+  int16_t            m_hwScrollOffset;
+
+  // double buffering: hash of each tile as last sent and tiles to send
+  uint32_t *         m_tileHash;
+  uint32_t *         m_tileRowHash;       // m_tileCols hashes of the tiles row being hashed by swapBuffers()
+  uint8_t *          m_tileDirty;
+  int16_t            m_tileCols;
+  int16_t            m_tileRows;
+  bool               m_tileHashValid;
+  volatile bool      m_framePending;      // true when swapBuffers() has been executed but changed tiles are not sent yet
+
+  // internal RAM write-back cache of m_viewPort bands of TFT_CACHE_TILE_ROWS rows
+  int                m_tileCacheSize;
+  bool               m_tileCacheActive;   // false when not allocated or bypassed
+  uint16_t *         m_tileCacheMem;
+  int8_t *           m_tileCacheSlot;     // for each band: slot that contains it or -1
+  int16_t            m_tileCacheBand[TFT_CACHE_MAX_TILES];  // for each slot: band it contains or -1
+  bool               m_tileCacheDirty[TFT_CACHE_MAX_TILES];
+  uint32_t           m_tileCacheLastUse[TFT_CACHE_MAX_TILES];
+  uint32_t           m_tileCacheClock;
+  TFTTileCacheStats  m_tileCacheStats;
+
+  // parallel execution: primitives queued by updateTaskFunc() and executed by one task per core (band)
+  volatile bool      m_parallel;
+  TaskHandle_t       m_bandTaskHandle[portNUM_PROCESSORS];
+  SemaphoreHandle_t  m_bandsDone;
+  DirtyRegion        m_bandDirtyRegion[portNUM_PROCESSORS];
+  Primitive          m_batch[TFT_PARALLEL_BATCH];
+  int                m_batchCount;
+
+  // bitmaps converted to native format, used by rawDrawBitmap_...()
+  int                   m_bitmapCacheBudget;
+  int                   m_bitmapCacheUsed;
+  int                   m_bitmapCacheCount;
+  TFTBitmapCacheEntry * m_bitmapCache[TFT_BITMAP_CACHE_MAX_ENTRIES];
+  uint32_t              m_bitmapCacheClock;
+  TFTBitmapCacheStats   m_bitmapCacheStats;
+
+  // used by drawGlyphRows()
+  TFTGlyphTable         m_glyphTable[portNUM_PROCESSORS];
+
+  // sprites composed while sending the screen (see enableSpriteCompositing())
+  TFTComposeItem *      m_composeItems;
+  int                   m_composeCapacity;
+  int                   m_composeCount;
+  uint32_t              m_composePixels;
+  uint32_t              m_composeTime;
+  TFTComposeStats       m_composeStats;
+
+  // glyphs rendered with filled background, used by drawGlyphRows()
+  int                   m_glyphCacheBudget;
+  int                   m_glyphCacheUsed;
+  TFTGlyphCacheEntry *  m_glyphCache[TFT_GLYPH_CACHE_BUCKETS];
+  TFTGlyphCacheEntry *  m_glyphCacheNewest;
+  TFTGlyphCacheEntry *  m_glyphCacheOldest;
+  TFTGlyphCacheStats    m_glyphCacheStats;
 
 };
 
@@ -28,12 +28,18 @@
 #include <math.h>
 
 #include "freertos/task.h"
+#include "esp_log.h"
 
 #include "fabutils.h"
 #include "images/cursors.h"
 
 
 
+// maximum time (ms) a producer waits for the executor before checking again the ring
+#define DISPLAYCONTROLLER_PROGRESS_TIMEOUT_MS 10
+
+
+
 namespace fabgl {
 
 
@@ -114,9 +120,13 @@ Sprite::Sprite()
   savedBackgroundHeight   = 0;
   savedBackground         = nullptr; // allocated or reallocated when bitmaps are added
   collisionDetectorObject = nullptr;
+  opacity                 = 255;
+  z                       = 0;
   visible                 = true;
   isStatic                = false;
   allowDraw               = true;
+  dirty                   = false;
+  redraw                  = false;
 }
 
 
@@ -132,6 +142,7 @@ void Sprite::clearBitmaps()
   free(frames);
   frames = nullptr;
   framesCount = 0;
+  dirty = true;
 }
 
 
@@ -140,6 +151,7 @@ Sprite * Sprite::addBitmap(Bitmap * bitmap)
   ++framesCount;
   frames = (Bitmap**) realloc(frames, sizeof(Bitmap*) * framesCount);
   frames[framesCount - 1] = bitmap;
+  dirty = true;
   return this;
 }
 
@@ -150,6 +162,7 @@ Sprite * Sprite::addBitmap(Bitmap * bitmap[], int count)
   for (int i = 0; i < count; ++i)
     frames[framesCount + i] = bitmap[i];
   framesCount += count;
+  dirty = true;
   return this;
 }
 
@@ -158,6 +171,7 @@ Sprite * Sprite::moveBy(int offsetX, int offsetY)
 {
   x += offsetX;
   y += offsetY;
+  dirty = true;
   return this;
 }
 
@@ -174,6 +188,7 @@ Sprite * Sprite::moveBy(int offsetX, int offsetY, int wrapAroundWidth, int wrapA
     y = - (int) getHeight();
   if (y < - (int) getHeight())
     y = wrapAroundHeight;
+  dirty = true;
   return this;
 }
 
@@ -182,6 +197,7 @@ Sprite * Sprite::moveTo(int x, int y)
 {
   this->x = x;
   this->y = y;
+  dirty = true;
   return this;
 }
 
@@ -219,12 +235,13 @@ void Bitmap::allocate()
   if (dataAllocated) {
     free((void*)data);
     data = nullptr;
+    dataAllocated = false;
   }
-  dataAllocated = true;
   switch (format) {
     case PixelFormat::Undefined:
     case PixelFormat::Native:
-      break;
+      // nothing allocated, data still points to the caller pixels
+      return;
     case PixelFormat::Mask:
       data = (uint8_t*) malloc((width + 7) * height / 8);
       break;
@@ -235,6 +252,7 @@ void Bitmap::allocate()
       data = (uint8_t*) malloc(width * height * 4);
       break;
   }
+  dataAllocated = true;
 }
 
 
@@ -316,6 +334,78 @@ Bitmap::~Bitmap()
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// DirtyRegion implementation
+
+
+// number of unchanged pixels the bounding box of "a" and "b" adds to them
+// areas are 64 bit: Rect coordinates are 16 bit, so an area may not fit in an int
+int64_t IRAM_ATTR DirtyRegion::mergeWaste(Rect const & a, Rect const & b)
+{
+  Rect m = a.merge(b);
+  int64_t used = (int64_t) a.width() * a.height() + (int64_t) b.width() * b.height();
+  if (a.intersects(b)) {
+    Rect i = a.intersection(b);
+    used -= (int64_t) i.width() * i.height();
+  }
+  return (int64_t) m.width() * m.height() - used;
+}
+
+
+void IRAM_ATTR DirtyRegion::add(Rect const & rect)
+{
+  if (rect.X1 > rect.X2 || rect.Y1 > rect.Y2)
+    return;
+
+  // merge with existing rectangles while cheap enough (a merged rectangle may become cheap to merge with others)
+  Rect r = rect;
+  while (true) {
+    int best = -1;
+    int64_t bestWaste = FABGLIB_DIRTY_REGION_MERGE_WASTE + 1;
+    for (int i = 0; i < m_count; ++i) {
+      int64_t waste = mergeWaste(m_rects[i], r);
+      if (waste < bestWaste) {
+        best = i;
+        bestWaste = waste;
+      }
+    }
+    if (best < 0)
+      break;
+    r = r.merge(m_rects[best]);
+    remove(best);
+  }
+  m_rects[m_count++] = r;
+
+  // too many rectangles, merge the pair that wastes fewer pixels
+  if (m_count > FABGLIB_DIRTY_REGION_RECTS) {
+    int bestA = 0, bestB = 1;
+    int64_t bestWaste = INT64_MAX;
+    for (int a = 0; a < m_count - 1; ++a)
+      for (int b = a + 1; b < m_count; ++b) {
+        int64_t waste = mergeWaste(m_rects[a], m_rects[b]);
+        if (waste < bestWaste) {
+          bestA = a;
+          bestB = b;
+          bestWaste = waste;
+        }
+      }
+    m_rects[bestA] = m_rects[bestA].merge(m_rects[bestB]);
+    remove(bestB);
+  }
+}
+
+
+Rect DirtyRegion::bounds() const
+{
+  Rect r = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  for (int i = 0; i < m_count; ++i)
+    r = r.merge(m_rects[i]);
+  return r;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // DisplayController implementation
@@ -324,7 +414,6 @@ Bitmap::~Bitmap()
 DisplayController::DisplayController()
   : m_primDynMemPool(FABGLIB_PRIMITIVES_DYNBUFFERS_SIZE)
 {
-  m_execQueue                           = nullptr;
   m_backgroundPrimitiveExecutionEnabled = true;
   m_sprites                             = nullptr;
   m_spritesCount                        = 0;
@@ -332,22 +421,43 @@ DisplayController::DisplayController()
   m_mouseCursor.visible                 = false;
   m_backgroundPrimitiveTimeoutEnabled   = true;
   m_spritesHidden                       = true;
+  m_dirtyRegion                         = nullptr;
+  m_bitmapOpacity                       = 255;
+  m_spritesComposed                     = false;
+  m_bandsActive                         = false;
+  m_pendingBatch.count                  = 0;
+  m_execBatch.count                     = 0;
+  m_execBatchPos                        = 0;
+  m_consumerWaiting                     = false;
+  m_consumerTask                        = nullptr;
+  m_producerWaiting                     = false;
+  m_execProgress                        = xSemaphoreCreateBinary();
+  vPortCPUInitializeMutex(&m_pendingBatchMux);
 }
 
 
 DisplayController::~DisplayController()
 {
-  vQueueDelete(m_execQueue);
+  vSemaphoreDelete(m_execProgress);
 }
 
 
 void DisplayController::setDoubleBuffered(bool value)
 {
   m_doubleBuffered = value;
-  if (m_execQueue)
-    vQueueDelete(m_execQueue);
+  m_pendingBatch.count = 0;
+  m_execBatch.count    = 0;
+  m_execBatchPos       = 0;
   // on double buffering a queue of single element is enough and necessary (see addPrimitive() for details)
-  m_execQueue = xQueueCreate(value ? 1 : FABGLIB_EXEC_QUEUE_SIZE, sizeof(Primitive));
+  int capacity = value ? 1 : tmax(1, FABGLIB_EXEC_QUEUE_SIZE / FABGLIB_PRIMITIVES_BATCH_SIZE);
+  // low memory: a smaller ring just makes addPrimitive() wait more often
+  while (!m_execRing.init(capacity)) {
+    if (capacity == 1) {
+      ESP_LOGE("FabGL", "unable to allocate primitives queue");
+      abort();
+    }
+    capacity /= 2;
+  }
 }
 
 
@@ -371,7 +481,16 @@ void DisplayController::addPrimitive(Primitive & primitive)
 {
   if ((m_backgroundPrimitiveExecutionEnabled && m_doubleBuffered == false) || primitive.cmd == PrimitiveCmd::SwapBuffers) {
     primitiveReplaceDynamicBuffers(primitive);
-    xQueueSendToBack(m_execQueue, &primitive, portMAX_DELAY);
+
+    // primitives are collected in m_pendingBatch, which is sent when full or when the executor is waiting for it.
+    // While the executor is busy it takes m_pendingBatch by itself (see receiveBatch()).
+    portENTER_CRITICAL(&m_pendingBatchMux);
+    if (!coalescePrimitive(primitive))
+      m_pendingBatch.prims[m_pendingBatch.count++] = primitive;
+    const bool send = m_pendingBatch.count == FABGLIB_PRIMITIVES_BATCH_SIZE || m_consumerWaiting || primitive.cmd == PrimitiveCmd::SwapBuffers;
+    portEXIT_CRITICAL(&m_pendingBatchMux);
+    if (send)
+      flushPendingBatch();
 
     if (m_doubleBuffered) {
       // wait notufy from PrimitiveCmd::SwapBuffers executor
@@ -386,6 +505,107 @@ void DisplayController::addPrimitive(Primitive & primitive)
 }
 
 
+// Tries to merge the primitive with the ones already in m_pendingBatch, returns true if nothing has to be added:
+//   - a state setting primitive replaces the same one just added (nothing has been drawn in between)
+//   - a state setting primitive that sets the value already set by the last one of the same type is dropped
+// m_pendingBatchMux must be locked
+bool DisplayController::coalescePrimitive(Primitive const & primitive)
+{
+  auto sameValue = [&] (Primitive const & p) {
+    switch (p.cmd) {
+      case PrimitiveCmd::SetPenColor:
+      case PrimitiveCmd::SetBrushColor:
+        return p.color == primitive.color;
+      case PrimitiveCmd::SetGlyphOptions:
+        return p.glyphOptions.value == primitive.glyphOptions.value;
+      case PrimitiveCmd::SetPaintOptions:
+        return p.paintOptions.swapFGBG == primitive.paintOptions.swapFGBG && p.paintOptions.NOT == primitive.paintOptions.NOT;
+      case PrimitiveCmd::SetScrollingRegion:
+      case PrimitiveCmd::SetClippingRect:
+      {
+        Rect r = p.rect;
+        return r == primitive.rect;
+      }
+      case PrimitiveCmd::SetOrigin:
+      {
+        Point pt = p.position;
+        return pt == primitive.position;
+      }
+      case PrimitiveCmd::SetPenWidth:
+        return p.ivalue == primitive.ivalue;
+      case PrimitiveCmd::SetLineEnds:
+        return p.lineEnds == primitive.lineEnds;
+      default:
+        return false;  // MoveTo is not idempotent (LineTo changes current position)
+    }
+  };
+
+  switch (primitive.cmd) {
+    case PrimitiveCmd::SetPenColor:
+    case PrimitiveCmd::SetBrushColor:
+    case PrimitiveCmd::SetGlyphOptions:
+    case PrimitiveCmd::SetPaintOptions:
+    case PrimitiveCmd::SetScrollingRegion:
+    case PrimitiveCmd::SetOrigin:
+    case PrimitiveCmd::SetClippingRect:
+    case PrimitiveCmd::SetPenWidth:
+    case PrimitiveCmd::SetLineEnds:
+    case PrimitiveCmd::MoveTo:
+      break;
+    default:
+      return false;
+  }
+
+  const int count = m_pendingBatch.count;
+  if (count > 0 && m_pendingBatch.prims[count - 1].cmd == primitive.cmd) {
+    m_pendingBatch.prims[count - 1] = primitive;
+    return true;
+  }
+  for (int i = count - 1; i >= 0; --i) {
+    Primitive const & p = m_pendingBatch.prims[i];
+    if (p.cmd == PrimitiveCmd::Reset)
+      break;
+    if (p.cmd == primitive.cmd)
+      return sameValue(p);
+  }
+  return false;
+}
+
+
+// Sends m_pendingBatch to the executor, waiting for space when m_execRing is full.
+// Producers are serialized by m_pendingBatchMux, so m_execRing has a single producer at the time.
+void DisplayController::flushPendingBatch()
+{
+  while (true) {
+    bool sent = false;
+    TaskHandle_t wake = nullptr;
+    portENTER_CRITICAL(&m_pendingBatchMux);
+    if (m_pendingBatch.count == 0 || m_execRing.push(m_pendingBatch)) {  // count = 0: taken by the executor
+      m_pendingBatch.count = 0;
+      sent = true;
+      if (m_consumerWaiting)
+        wake = m_consumerTask;
+    }
+    portEXIT_CRITICAL(&m_pendingBatchMux);
+    if (wake)
+      xTaskNotifyGive(wake);
+    if (sent)
+      break;
+    // ring full, wait for the executor to take something
+    waitExecProgress();
+  }
+}
+
+
+// waits for the executor to take a batch or to become idle. Can wake up earlier, callers must check their condition again.
+void DisplayController::waitExecProgress()
+{
+  m_producerWaiting = true;
+  xSemaphoreTake(m_execProgress, msToTicks(DISPLAYCONTROLLER_PROGRESS_TIMEOUT_MS));
+  m_producerWaiting = false;
+}
+
+
 // some primitives require additional buffers (like drawPath and fillPath).
 // this function copies primitive data into an allocated buffer (using LightMemoryPool allocator) that
 // will be freed inside primitive drawing code.
@@ -414,32 +634,124 @@ void DisplayController::primitiveReplaceDynamicBuffers(Primitive & primitive)
 }
 
 
+// Receives next batch into m_execBatch. Ring batches come first, then the one addPrimitive() is filling.
+// If there is nothing waits up to "ticksToWait" for a task notification, asking addPrimitive() to send its batch immediately.
+bool DisplayController::receiveBatch(TickType_t ticksToWait)
+{
+  while (!m_execRing.pop(&m_execBatch)) {
+    bool taken = false;
+    bool wait  = false;
+    portENTER_CRITICAL(&m_pendingBatchMux);
+    // a batch pushed after the check above must be executed before
+    if (m_execRing.isEmpty()) {
+      if (m_pendingBatch.count > 0) {
+        m_execBatch = m_pendingBatch;
+        m_pendingBatch.count = 0;
+        taken = true;
+      } else if (ticksToWait > 0) {
+        m_consumerTask    = xTaskGetCurrentTaskHandle();
+        m_consumerWaiting = true;
+        wait = true;
+      }
+    }
+    portEXIT_CRITICAL(&m_pendingBatchMux);
+    if (taken)
+      break;
+    if (wait) {
+      // idle: wake up primitivesExecutionWait()
+      if (m_producerWaiting)
+        xSemaphoreGive(m_execProgress);
+      // other notifications (ie resumeBackgroundPrimitiveExecution()) just check the ring again
+      const bool notified = ulTaskNotifyTake(true, ticksToWait);
+      m_consumerWaiting = false;
+      if (!notified && m_execRing.isEmpty())
+        return false;
+    } else if (m_execRing.isEmpty()) {
+      if (m_producerWaiting)
+        xSemaphoreGive(m_execProgress);
+      return false;
+    }
+  }
+  m_execBatchPos = 0;
+  // there is space in the ring now
+  if (m_producerWaiting)
+    xSemaphoreGive(m_execProgress);
+  return true;
+}
+
+
+// call this only inside an ISR
+bool IRAM_ATTR DisplayController::receiveBatchISR()
+{
+  bool taken = m_execRing.pop(&m_execBatch);
+  if (!taken) {
+    portENTER_CRITICAL_ISR(&m_pendingBatchMux);
+    if (m_pendingBatch.count > 0 && m_execRing.isEmpty()) {
+      m_execBatch = m_pendingBatch;
+      m_pendingBatch.count = 0;
+      taken = true;
+    }
+    portEXIT_CRITICAL_ISR(&m_pendingBatchMux);
+  }
+  if (m_producerWaiting)
+    xSemaphoreGiveFromISR(m_execProgress, nullptr);
+  if (taken)
+    m_execBatchPos = 0;
+  return taken;
+}
+
+
 // call this only inside an ISR
 bool IRAM_ATTR DisplayController::getPrimitiveISR(Primitive * primitive)
 {
-  return xQueueReceiveFromISR(m_execQueue, primitive, nullptr);
+  if (m_execBatchPos == m_execBatch.count && !receiveBatchISR())
+    return false;
+  *primitive = m_execBatch.prims[m_execBatchPos++];
+  return true;
 }
 
 
 bool DisplayController::getPrimitive(Primitive * primitive, int timeOutMS)
 {
-  return xQueueReceive(m_execQueue, primitive, msToTicks(timeOutMS));
+  if (m_execBatchPos == m_execBatch.count && !receiveBatch(msToTicks(timeOutMS)))
+    return false;
+  *primitive = m_execBatch.prims[m_execBatchPos++];
+  return true;
 }
 
 
+// Waits until there are primitives to execute, without taking them: m_execRing and m_pendingBatch are consumed
+// only by getPrimitive(), after the driver checked that background execution is not suspended (processPrimitives()
+// may be consuming them).
 // cannot be called inside an ISR
 void DisplayController::waitForPrimitives()
 {
-  Primitive p;
-  xQueuePeek(m_execQueue, &p, portMAX_DELAY);
+  while (m_execBatchPos == m_execBatch.count && m_execRing.isEmpty()) {
+    bool wait = false;
+    portENTER_CRITICAL(&m_pendingBatchMux);
+    if (m_execRing.isEmpty() && m_pendingBatch.count == 0) {
+      m_consumerTask    = xTaskGetCurrentTaskHandle();
+      m_consumerWaiting = true;
+      wait = true;
+    }
+    portEXIT_CRITICAL(&m_pendingBatchMux);
+    if (!wait)
+      break;
+    // idle: wake up primitivesExecutionWait()
+    if (m_producerWaiting)
+      xSemaphoreGive(m_execProgress);
+    ulTaskNotifyTake(true, portMAX_DELAY);
+    m_consumerWaiting = false;
+  }
 }
 
 
 void DisplayController::primitivesExecutionWait()
 {
   if (m_backgroundPrimitiveExecutionEnabled) {
-    while (uxQueueMessagesWaiting(m_execQueue) > 0)
-      ;
+    flushPendingBatch();
+    while (!m_execRing.isEmpty() || m_execBatchPos < m_execBatch.count)
+      waitExecProgress();
   }
 }
 
@@ -468,7 +780,7 @@ void IRAM_ATTR DisplayController::processPrimitives()
   suspendBackgroundPrimitiveExecution();
   Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
   Primitive prim;
-  while (xQueueReceive(m_execQueue, &prim, 0) == pdTRUE)
+  while (getPrimitive(&prim))
     execPrimitive(prim, updateRect, false);
   showSprites(updateRect);
   resumeBackgroundPrimitiveExecution();
@@ -485,20 +797,24 @@ void DisplayController::setSprites(Sprite * sprites, int count, int spriteSize)
   m_spriteSize   = spriteSize;
   m_spritesCount = count;
 
-  // allocates background buffer
-  if (!isDoubleBuffered()) {
+  // allocates background buffer (not necessary when sprites are composed by the driver)
+  if (!isDoubleBuffered() && !m_spritesComposed) {
     uint8_t * spritePtr = (uint8_t*)m_sprites;
-    for (int i = 0; i < m_spritesCount; ++i, spritePtr += m_spriteSize) {
-      Sprite * sprite = (Sprite*) spritePtr;
-      int reqBackBufferSize = 0;
-      for (int i = 0; i < sprite->framesCount; ++i)
-        reqBackBufferSize = tmax(reqBackBufferSize, sprite->frames[i]->width * getBitmapSavePixelSize() * sprite->frames[i]->height);
-      sprite->savedBackground = (uint8_t*) realloc(sprite->savedBackground, reqBackBufferSize);
-    }
+    for (int i = 0; i < m_spritesCount; ++i, spritePtr += m_spriteSize)
+      allocSpriteBackground((Sprite*) spritePtr);
   }
 }
 
 
+void DisplayController::allocSpriteBackground(Sprite * sprite)
+{
+  int reqBackBufferSize = 0;
+  for (int i = 0; i < sprite->framesCount; ++i)
+    reqBackBufferSize = tmax(reqBackBufferSize, sprite->frames[i]->width * getBitmapSavePixelSize() * sprite->frames[i]->height);
+  sprite->savedBackground = (uint8_t*) realloc(sprite->savedBackground, reqBackBufferSize);
+}
+
+
 Sprite * IRAM_ATTR DisplayController::getSprite(int index)
 {
   return (Sprite*) ((uint8_t*)m_sprites + index * m_spriteSize);
@@ -512,95 +828,263 @@ void DisplayController::refreshSprites()
 }
 
 
-void IRAM_ATTR DisplayController::hideSprites(Rect & updateRect)
+// sprite rectangles go to the dirty region when primitives are executed by execPrimitive(DirtyRegion), so a sprite
+// far from the drawn primitive doesn't enlarge the primitive rectangle
+void IRAM_ATTR DisplayController::addSpriteRect(Rect const & rect, Rect & updateRect)
 {
-  if (!m_spritesHidden) {
-    m_spritesHidden = true;
+  if (m_dirtyRegion)
+    m_dirtyRegion->add(rect);
+  else
+    updateRect = updateRect.merge(rect);
+}
 
-    // normal sprites
-    if (spritesCount() > 0 && !isDoubleBuffered()) {
-      // restore saved backgrounds
-      for (int i = spritesCount() - 1; i >= 0; --i) {
-        Sprite * sprite = getSprite(i);
-        if (sprite->allowDraw && sprite->savedBackgroundWidth > 0) {
-          int savedX = sprite->savedX;
-          int savedY = sprite->savedY;
-          int savedWidth  = sprite->savedBackgroundWidth;
-          int savedHeight = sprite->savedBackgroundHeight;
-          Bitmap bitmap(savedWidth, savedHeight, sprite->savedBackground, PixelFormat::Native);
-          absDrawBitmap(savedX, savedY, &bitmap, nullptr, true);
-          updateRect = updateRect.merge(Rect(savedX, savedY, savedX + savedWidth - 1, savedY + savedHeight - 1));
-          sprite->savedBackgroundWidth = sprite->savedBackgroundHeight = 0;
-        }
-      }
+
+// A sprite is on screen when it has been drawn and its background can be restored. Static sprites (allowDraw = 0 after
+// the first drawing) are part of the background.
+static bool IRAM_ATTR spriteOnScreen(Sprite * sprite)
+{
+  return sprite->allowDraw && sprite->savedBackgroundWidth > 0;
+}
+
+
+static bool IRAM_ATTR spriteWanted(Sprite * sprite)
+{
+  return sprite->visible && sprite->allowDraw && sprite->getFrame();
+}
+
+
+static Rect IRAM_ATTR spriteSavedRect(Sprite * sprite)
+{
+  return Rect(sprite->savedX, sprite->savedY, sprite->savedX + sprite->savedBackgroundWidth - 1, sprite->savedY + sprite->savedBackgroundHeight - 1);
+}
+
+
+// rectangle where the sprite will be drawn
+static Rect IRAM_ATTR spriteRect(Sprite * sprite)
+{
+  Bitmap const * bitmap = sprite->getFrame();
+  return Rect(sprite->x, sprite->y, sprite->x + bitmap->width - 1, sprite->y + bitmap->height - 1);
+}
+
+
+// true when an on screen sprite has to be redrawn because it has been changed, moved or hidden
+static bool IRAM_ATTR spriteChanged(Sprite * sprite)
+{
+  if (sprite->dirty || sprite->isStatic || !sprite->visible || !sprite->getFrame())
+    return true;
+  Bitmap const * bitmap = sprite->getFrame();
+  return sprite->x != sprite->savedX || sprite->y != sprite->savedY ||
+         bitmap->width != sprite->savedBackgroundWidth || bitmap->height != sprite->savedBackgroundHeight;
+}
+
+
+void IRAM_ATTR DisplayController::restoreSpriteBackground(Sprite * sprite, Rect & updateRect)
+{
+  int savedX = sprite->savedX;
+  int savedY = sprite->savedY;
+  int savedWidth  = sprite->savedBackgroundWidth;
+  int savedHeight = sprite->savedBackgroundHeight;
+  Bitmap bitmap(savedWidth, savedHeight, sprite->savedBackground, PixelFormat::Native);
+  absDrawBitmap(savedX, savedY, &bitmap, nullptr, true);
+  addSpriteRect(Rect(savedX, savedY, savedX + savedWidth - 1, savedY + savedHeight - 1), updateRect);
+  sprite->savedBackgroundWidth = sprite->savedBackgroundHeight = 0;
+}
+
+
+// saves background and draws the sprite
+void IRAM_ATTR DisplayController::drawSprite(Sprite * sprite, Rect & updateRect)
+{
+  // save sprite X and Y so other threads can change them without interferring
+  int spriteX = sprite->x;
+  int spriteY = sprite->y;
+  Bitmap const * bitmap = sprite->getFrame();
+  int bitmapWidth  = bitmap->width;
+  int bitmapHeight = bitmap->height;
+  m_bitmapOpacity = sprite->opacity;
+  absDrawBitmap(spriteX, spriteY, bitmap, sprite->savedBackground, true);
+  m_bitmapOpacity = 255;
+  sprite->savedX = spriteX;
+  sprite->savedY = spriteY;
+  sprite->savedBackgroundWidth  = bitmapWidth;
+  sprite->savedBackgroundHeight = bitmapHeight;
+  addSpriteRect(Rect(spriteX, spriteY, spriteX + bitmapWidth - 1, spriteY + bitmapHeight - 1), updateRect);
+}
+
+
+// Restores the backgrounds of the sprites that have to be redrawn, marking them with "redraw". The mouse cursor is
+// handled as the topmost sprite. A sprite has to be redrawn when:
+//   - it is on screen and has been changed, or it intersects "rect" (the area a primitive is going to paint)
+//   - it is visible but not on screen
+//   - it is on screen and intersects the old or new rectangle of a lower sprite to redraw (overlap graph edge): the
+//     lower sprite is going to be restored or drawn below it, so it has to be restored before and drawn after
+// Sprites are examined from bottom to top, so one pass finds all the edges. Backgrounds are restored from top to bottom.
+// Sprites already marked are not examined again, unless "recheck" is true (they may have been moved in the meantime).
+void IRAM_ATTR DisplayController::restoreChangedSprites(Rect const & rect, bool recheck, Rect & updateRect)
+{
+  const int count = spritesCount() + 1;
+
+  // lowest sprite to examine, nothing to do when there isn't any
+  int first = count;
+  for (int i = 0; i < count; ++i) {
+    Sprite * sprite = spriteAt(i);
+    if (sprite->redraw ? recheck : (spriteOnScreen(sprite) ? spriteChanged(sprite) || rect.intersects(spriteSavedRect(sprite)) : spriteWanted(sprite))) {
+      first = i;
+      break;
     }
+  }
 
-    // mouse cursor sprite
-    Sprite * mouseSprite = mouseCursor();
-    if (mouseSprite->savedBackgroundWidth > 0) {
-      int savedX = mouseSprite->savedX;
-      int savedY = mouseSprite->savedY;
-      int savedWidth  = mouseSprite->savedBackgroundWidth;
-      int savedHeight = mouseSprite->savedBackgroundHeight;
-      Bitmap bitmap(savedWidth, savedHeight, mouseSprite->savedBackground, PixelFormat::Native);
-      absDrawBitmap(savedX, savedY, &bitmap, nullptr, true);
-      updateRect = updateRect.merge(Rect(savedX, savedY, savedX + savedWidth - 1, savedY + savedHeight - 1));
-      mouseSprite->savedBackgroundWidth = mouseSprite->savedBackgroundHeight = 0;
+  for (int j = first; j < count; ++j) {
+    Sprite * sprite = spriteAt(j);
+    if (sprite->redraw)
+      continue;
+    if (!spriteOnScreen(sprite)) {
+      sprite->redraw = spriteWanted(sprite);
+      continue;
+    }
+    Rect saved = spriteSavedRect(sprite);
+    bool redraw = spriteChanged(sprite) || rect.intersects(saved);
+    for (int i = 0; !redraw && i < j; ++i) {
+      Sprite * lower = spriteAt(i);
+      if (lower->redraw)
+        redraw = (spriteOnScreen(lower) && saved.intersects(spriteSavedRect(lower))) || (spriteWanted(lower) && saved.intersects(spriteRect(lower)));
     }
+    sprite->redraw = redraw;
+  }
 
+  for (int j = count - 1; j >= first; --j) {
+    Sprite * sprite = spriteAt(j);
+    if (sprite->redraw && spriteOnScreen(sprite))
+      restoreSpriteBackground(sprite, updateRect);
   }
 }
 
 
+// Called before a primitive paints inside updateRect: restores sprites intersecting it and the ones overlapping them.
+// When double buffered the screen is completely redrawn, so only the mouse cursor is restored.
+void IRAM_ATTR DisplayController::hideSprites(Rect & updateRect)
+{
+  if (m_spritesHidden || spritesComposed())
+    return;
+
+  if (isDoubleBuffered()) {
+    m_spritesHidden = true;
+    Sprite * mouseSprite = mouseCursor();
+    if (mouseSprite->savedBackgroundWidth > 0)
+      restoreSpriteBackground(mouseSprite, updateRect);
+    return;
+  }
+
+  Rect rect = updateRect;
+  restoreChangedSprites(rect, false, updateRect);
+}
+
+
+// Restores all sprites, next hideSprites() calls do nothing until showSprites(). Used when the primitives to execute
+// cannot restore sprites by themselves (ie band parallel execution).
+void IRAM_ATTR DisplayController::hideAllSprites(Rect & updateRect)
+{
+  if (m_spritesHidden || spritesComposed())
+    return;
+
+  if (isDoubleBuffered()) {
+    hideSprites(updateRect);
+    return;
+  }
+
+  m_spritesHidden = true;
+  for (int i = spritesCount(); i >= 0; --i) {
+    Sprite * sprite = spriteAt(i);
+    if (spriteOnScreen(sprite))
+      restoreSpriteBackground(sprite, updateRect);
+  }
+}
+
+
+// Draws the sprites restored by hideSprites(), plus the ones changed after it. When double buffered all sprites are drawn.
 void IRAM_ATTR DisplayController::showSprites(Rect & updateRect)
 {
-  if (m_spritesHidden) {
-    m_spritesHidden = false;
-
-    // normal sprites
-    // save backgrounds and draw sprites
-    for (int i = 0; i < spritesCount(); ++i) {
-      Sprite * sprite = getSprite(i);
-      if (sprite->visible && sprite->allowDraw && sprite->getFrame()) {
-        // save sprite X and Y so other threads can change them without interferring
-        int spriteX = sprite->x;
-        int spriteY = sprite->y;
-        Bitmap const * bitmap = sprite->getFrame();
-        int bitmapWidth  = bitmap->width;
-        int bitmapHeight = bitmap->height;
-        absDrawBitmap(spriteX, spriteY, bitmap, sprite->savedBackground, true);
-        sprite->savedX = spriteX;
-        sprite->savedY = spriteY;
-        sprite->savedBackgroundWidth  = bitmapWidth;
-        sprite->savedBackgroundHeight = bitmapHeight;
+  if (isDoubleBuffered()) {
+    if (m_spritesHidden) {
+      m_spritesHidden = false;
+      for (int i = 0; i < spritesCount(); ++i) {
+        Sprite * sprite = getSprite(i);
+        if (spriteWanted(sprite)) {
+          drawSprite(sprite, updateRect);
+          if (sprite->isStatic)
+            sprite->allowDraw = false;
+        }
+      }
+      Sprite * mouseSprite = mouseCursor();
+      if (mouseSprite->visible && mouseSprite->getFrame())
+        drawSprite(mouseSprite, updateRect);
+    }
+    return;
+  }
+
+  if (spritesComposed()) {
+    showComposedSprites(updateRect);
+    return;
+  }
+
+  m_spritesHidden = false;
+
+  const Rect noRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  restoreChangedSprites(noRect, true, updateRect);
+
+  for (int i = 0; i <= spritesCount(); ++i) {
+    Sprite * sprite = spriteAt(i);
+    if (sprite->redraw) {
+      sprite->redraw = false;
+      if (spriteWanted(sprite)) {
+        sprite->dirty = false;
+        drawSprite(sprite, updateRect);
         if (sprite->isStatic)
           sprite->allowDraw = false;
-        updateRect = updateRect.merge(Rect(spriteX, spriteY, spriteX + bitmapWidth - 1, spriteY + bitmapHeight - 1));
       }
     }
+  }
+}
 
-    // mouse cursor sprite
-    // save backgrounds and draw mouse cursor
-    Sprite * mouseSprite = mouseCursor();
-    if (mouseSprite->visible && mouseSprite->getFrame()) {
-      // save sprite X and Y so other threads can change them without interferring
-      int spriteX = mouseSprite->x;
-      int spriteY = mouseSprite->y;
-      Bitmap const * bitmap = mouseSprite->getFrame();
-      int bitmapWidth  = bitmap->width;
-      int bitmapHeight = bitmap->height;
-      absDrawBitmap(spriteX, spriteY, bitmap, mouseSprite->savedBackground, true);
-      mouseSprite->savedX = spriteX;
-      mouseSprite->savedY = spriteY;
-      mouseSprite->savedBackgroundWidth  = bitmapWidth;
-      mouseSprite->savedBackgroundHeight = bitmapHeight;
-      updateRect = updateRect.merge(Rect(spriteX, spriteY, spriteX + bitmapWidth - 1, spriteY + bitmapHeight - 1));
-    }
 
+// Sprites composed by the driver: the old and new rectangles of changed sprites are updated. Static sprites are
+// composed again when allowDraw is set, allowDraw of dynamic sprites is ignored (sprites are always over primitives).
+void IRAM_ATTR DisplayController::showComposedSprites(Rect & updateRect)
+{
+  for (int i = 0; i <= spritesCount(); ++i) {
+    Sprite * sprite = spriteAt(i);
+    Bitmap const * bitmap = sprite->visible ? sprite->getFrame() : nullptr;
+    bool composed = sprite->savedBackgroundWidth > 0;
+    if (composed && (!bitmap || sprite->dirty || (sprite->isStatic && sprite->allowDraw) ||
+                     sprite->x != sprite->savedX || sprite->y != sprite->savedY ||
+                     bitmap->width != sprite->savedBackgroundWidth || bitmap->height != sprite->savedBackgroundHeight)) {
+      addSpriteRect(spriteSavedRect(sprite), updateRect);
+      sprite->savedBackgroundWidth = sprite->savedBackgroundHeight = 0;
+      composed = false;
+    }
+    if (bitmap && !composed) {
+      sprite->savedX = sprite->x;
+      sprite->savedY = sprite->y;
+      sprite->savedBackgroundWidth  = bitmap->width;
+      sprite->savedBackgroundHeight = bitmap->height;
+      sprite->dirty = false;
+      if (sprite->isStatic)
+        sprite->allowDraw = false;
+      addSpriteRect(spriteSavedRect(sprite), updateRect);
+    }
   }
 }
 
 
+// like showSprites(Rect) but each sprite is added to the dirty region as separated rectangle
+void IRAM_ATTR DisplayController::showSprites(DirtyRegion & dirtyRegion)
+{
+  Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  m_dirtyRegion = &dirtyRegion;
+  showSprites(updateRect);
+  m_dirtyRegion = nullptr;
+}
+
+
 // cursor = nullptr -> disable mouse
 void DisplayController::setMouseCursor(Cursor * cursor)
 {
@@ -619,8 +1103,8 @@ void DisplayController::setMouseCursor(Cursor * cursor)
       m_mouseCursor.addBitmap(&cursor->bitmap);
       m_mouseCursor.visible = true;
       m_mouseCursor.moveBy(-m_mouseHotspotX, -m_mouseHotspotY);
-      if (!isDoubleBuffered())
-        m_mouseCursor.savedBackground = (uint8_t*) realloc(m_mouseCursor.savedBackground, cursor->bitmap.width * getBitmapSavePixelSize() * cursor->bitmap.height);
+      if (!isDoubleBuffered() && !m_spritesComposed)
+        allocSpriteBackground(&m_mouseCursor);
     }
     refreshSprites();
   }
@@ -752,7 +1236,146 @@ void IRAM_ATTR DisplayController::execPrimitive(Primitive const & prim, Rect & u
     case PrimitiveCmd::SetLineEnds:
       paintState().lineEnds = prim.lineEnds;
       break;
+    case PrimitiveCmd::DrawTileMap:
+      drawTileMap(prim.tileMapDrawingInfo, updateRect);
+      break;
+  }
+}
+
+
+// executes a primitive adding its updated rectangle (and restored sprites rectangles) to the dirty region
+void IRAM_ATTR DisplayController::execPrimitive(Primitive const & prim, DirtyRegion & dirtyRegion, bool insideISR)
+{
+  Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  m_dirtyRegion = &dirtyRegion;
+  execPrimitive(prim, updateRect, insideISR);
+  m_dirtyRegion = nullptr;
+  dirtyRegion.add(updateRect);
+}
+
+
+// true when the primitive can be executed by each core inside its own band (see execPrimitiveInBand()), without
+// reading or writing pixels outside the band and without changing state shared by all cores
+bool DisplayController::isBandPrimitive(PrimitiveCmd cmd)
+{
+  switch (cmd) {
+    case PrimitiveCmd::Reset:           // writes the shared paint state
+    case PrimitiveCmd::VScroll:         // moves rows across bands
+    case PrimitiveCmd::CopyRect:
+    case PrimitiveCmd::RefreshSprites:  // sprites are hidden and shown once per batch
+    case PrimitiveCmd::SwapBuffers:
+    case PrimitiveCmd::DrawTileMap:     // moves pixels across bands and updates the tile map
+      return false;
+    default:
+      return true;
+  }
+}
+
+
+// Starts band parallel execution: each core gets a copy of current paint state, and its clipping rectangle
+// is restricted to its band. Every core must execute the same primitives, so paint states remain equal.
+// Sprites must be hidden before.
+void DisplayController::beginBands(Rect const * bands)
+{
+  for (int i = 0; i < portNUM_PROCESSORS; ++i) {
+    m_bandRect[i] = bands[i];
+    m_bandPaintState[i] = m_paintState;
+    m_bandPaintState[i].absClippingRect = m_paintState.absClippingRect.intersection(bands[i]);
   }
+  m_bandsActive = true;
+}
+
+
+// Ends band parallel execution, paint state continues from the one of the bands
+void DisplayController::endBands()
+{
+  m_bandsActive = false;
+  m_paintState = m_bandPaintState[0];
+  updateAbsoluteClippingRect();
+}
+
+
+// executes a primitive restricted to the band of the current core (see beginBands())
+// buffers of paths are not released here because all cores use them, call releasePrimitiveBuffers() when all have completed
+void IRAM_ATTR DisplayController::execPrimitiveInBand(Primitive const & prim, DirtyRegion & dirtyRegion)
+{
+  Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  Rect const & band = m_bandRect[xPortGetCoreID()];
+  Rect const & clip = paintState().absClippingRect;
+  const bool clipEmpty = clip.X1 > clip.X2 || clip.Y1 > clip.Y2;
+
+  switch (prim.cmd) {
+
+    case PrimitiveCmd::Clear:
+    {
+      // clear() fills the whole viewport, just fill rows of this band
+      RGB888 color = getActualBrushColor();
+      for (int y = band.Y1; y <= band.Y2; ++y)
+        rawFillRow(y, band.X1, band.X2, color);
+      updateRect = band;
+      break;
+    }
+
+    case PrimitiveCmd::HScroll:
+    {
+      // rows are independent, scroll only rows of this band
+      Rect region = paintState().scrollingRegion;
+      paintState().scrollingRegion = region.intersection(band);
+      if (paintState().scrollingRegion.Y1 <= paintState().scrollingRegion.Y2) {
+        updateRect = paintState().scrollingRegion;
+        HScroll(prim.ivalue, updateRect);
+      }
+      paintState().scrollingRegion = region;
+      break;
+    }
+
+    case PrimitiveCmd::DrawPath:
+    case PrimitiveCmd::FillPath:
+      if (!clipEmpty) {
+        Primitive p(prim.cmd);
+        p.path = prim.path;
+        p.path.freePoints = false;
+        execPrimitive(p, updateRect, false);
+      }
+      break;
+
+    case PrimitiveCmd::LineTo:
+      if (clipEmpty) {
+        // nothing to draw in this band, just update current position
+        paintState().position = Point(prim.position.X + paintState().origin.X, prim.position.Y + paintState().origin.Y);
+        break;
+      }
+      execPrimitive(prim, updateRect, false);
+      break;
+
+    case PrimitiveCmd::SetPixel:
+    case PrimitiveCmd::SetPixelAt:
+    case PrimitiveCmd::FillRect:
+    case PrimitiveCmd::DrawRect:
+    case PrimitiveCmd::FillEllipse:
+    case PrimitiveCmd::DrawEllipse:
+    case PrimitiveCmd::DrawGlyph:
+    case PrimitiveCmd::InvertRect:
+    case PrimitiveCmd::SwapFGBG:
+    case PrimitiveCmd::RenderGlyphsBuffer:
+    case PrimitiveCmd::DrawBitmap:
+      if (!clipEmpty)
+        execPrimitive(prim, updateRect, false);
+      break;
+
+    default:
+      execPrimitive(prim, updateRect, false);
+      break;
+  }
+
+  dirtyRegion.add(updateRect);
+}
+
+
+void DisplayController::releasePrimitiveBuffers(Primitive const & prim)
+{
+  if ((prim.cmd == PrimitiveCmd::DrawPath || prim.cmd == PrimitiveCmd::FillPath) && prim.path.freePoints)
+    m_primDynMemPool.free((void*)prim.path.points);
 }
 
 
@@ -795,6 +1418,8 @@ void IRAM_ATTR DisplayController::updateAbsoluteClippingRect()
   int X2 = iclamp(paintState().origin.X + paintState().clippingRect.X2, 0, getViewPortWidth() - 1);
   int Y2 = iclamp(paintState().origin.Y + paintState().clippingRect.Y2, 0, getViewPortHeight() - 1);
   paintState().absClippingRect = Rect(X1, Y1, X2, Y2);
+  if (m_bandsActive)
+    paintState().absClippingRect = paintState().absClippingRect.intersection(m_bandRect[xPortGetCoreID()]);
 }
 
 
@@ -985,71 +1610,45 @@ void IRAM_ATTR DisplayController::drawPath(Path const & path, Rect & updateRect)
 
 void IRAM_ATTR DisplayController::fillPath(Path const & path, RGB888 const & color, Rect & updateRect)
 {
-  const int clipX1 = paintState().absClippingRect.X1;
-  const int clipY1 = paintState().absClippingRect.Y1;
-  const int clipX2 = paintState().absClippingRect.X2;
-  const int clipY2 = paintState().absClippingRect.Y2;
-
   const int origX = paintState().origin.X;
   const int origY = paintState().origin.Y;
 
-  int minX = clipX1;
-  int maxX = clipX2 + 1;
+  int minX = INT_MAX;
+  int maxX = INT_MIN;
   int minY = INT_MAX;
-  int maxY = 0;
+  int maxY = INT_MIN;
   for (int i = 0; i < path.pointsCount; ++i) {
+    int px = path.points[i].X + origX;
     int py = path.points[i].Y + origY;
-    if (py < minY)
-      minY = py;
-    if (py > maxY)
-      maxY = py;
+    minX = tmin(minX, px);
+    maxX = tmax(maxX, px);
+    minY = tmin(minY, py);
+    maxY = tmax(maxY, py);
   }
-  minY = tmax(clipY1, minY);
-  maxY = tmin(clipY2, maxY);
-
-  updateRect = updateRect.merge(Rect(minX, minY, maxX, maxY));
-  hideSprites(updateRect);
-
-  int16_t nodeX[path.pointsCount];
-
-  for (int pixelY = minY; pixelY <= maxY; ++pixelY) {
-
-    int nodes = 0;
-    int j = path.pointsCount - 1;
-    for (int i = 0; i < path.pointsCount; ++i) {
-      int piy = path.points[i].Y + origY;
-      int pjy = path.points[j].Y + origY;
-      if ((piy < pixelY && pjy >= pixelY) || (pjy < pixelY && piy >= pixelY)) {
-        int pjx = path.points[j].X + origX;
-        int pix = path.points[i].X + origX;
-        int a = (pixelY - piy) * (pjx - pix);
-        int b = (pjy - piy);
-        nodeX[nodes++] = pix + a / b + (((a < 0) ^ (b > 0)) && (a % b));
-      }
-      j = i;
+  Rect const & clip = paintState().absClippingRect;
+  Rect bounds = Rect(tmax<int>(clip.X1, minX), tmax<int>(clip.Y1, minY), tmin<int>(clip.X2, maxX), tmin<int>(clip.Y2, maxY));
+
+  if (bounds.X1 <= bounds.X2 && bounds.Y1 <= bounds.Y2) {
+    updateRect = updateRect.merge(bounds);
+    hideSprites(updateRect);
+
+    const int core = xPortGetCoreID();
+    PolygonEdge * edges    = m_polygonEdges[core];
+    PolygonEdge * * active = m_polygonActive[core];
+    void * mem = nullptr;
+    if (path.pointsCount > FABGLIB_POLYGON_EDGES) {
+      // heap cannot be used inside an ISR (VGA): such paths are not filled
+      if (!xPortInIsrContext())
+        mem = heap_caps_malloc(path.pointsCount * (sizeof(PolygonEdge) + sizeof(PolygonEdge*)), MALLOC_CAP_32BIT);
+      edges  = (PolygonEdge*) mem;
+      active = mem ? (PolygonEdge**) (edges + path.pointsCount) : nullptr;
     }
-
-    int i = 0;
-    while (i < nodes - 1) {
-      if (nodeX[i] > nodeX[i + 1]) {
-        tswap(nodeX[i], nodeX[i + 1]);
-        if (i)
-          --i;
-      } else
-        ++i;
-    }
-
-    for (int i = 0; i < nodes; i += 2) {
-      if (nodeX[i] >= maxX)
-        break;
-      if (nodeX[i + 1] > minX) {
-        if (nodeX[i] < minX)
-          nodeX[i] = minX;
-        if (nodeX[i + 1] > maxX)
-          nodeX[i + 1] = maxX;
-        rawFillRow(pixelY, nodeX[i], nodeX[i + 1] - 1, color);
-      }
+    if (edges) {
+      PolygonRasterizer rasterizer(edges, active);
+      rasterizer.setup(path.points, path.pointsCount, origX, origY, clip);
+      rasterizer.rasterize([&] (int y, int x1, int x2) { rawFillRow(y, x1, x2, color); });
     }
+    heap_caps_free(mem);
   }
 
   if (path.freePoints)
@@ -1067,22 +1666,30 @@ void IRAM_ATTR DisplayController::absDrawThickLine(int X1, int Y1, int X2, int Y
   X2 -= origX;
   Y2 -= origY;
 
+  // half pen width offsets perpendicular to the line, rounded half away from zero (like lround()).
+  // Line length is calculated with 4 fractional bits, when it fits.
   Point pts[4];
-
-  const double angle = atan2(Y2 - Y1, X2 - X1);
-  const double pw = (double)penWidth / 2.0;
-  const int ofs1 = lround(pw * cos(angle + M_PI_2));
-  const int ofs2 = lround(pw * sin(angle + M_PI_2));
-  const int ofs3 = lround(pw * cos(angle - M_PI_2));
-  const int ofs4 = lround(pw * sin(angle - M_PI_2));
-  pts[0].X = X1 + ofs1;
-  pts[0].Y = Y1 + ofs2;
-  pts[1].X = X1 + ofs3;
-  pts[1].Y = Y1 + ofs4;
-  pts[2].X = X2 + ofs3;
-  pts[2].Y = Y2 + ofs4;
-  pts[3].X = X2 + ofs1;
-  pts[3].Y = Y2 + ofs2;
+  const int dx    = X2 - X1;
+  const int dy    = Y2 - Y1;
+  const int scale = dx * dx + dy * dy < (1 << 23) ? 16 : 1;
+  const int sq    = (dx * dx + dy * dy) * scale * scale;
+  int len = isqrt(sq);
+  if (sq - len * len > len)
+    ++len;  // round to nearest
+  int ofsX = 0;
+  int ofsY = (penWidth + 1) / 2;
+  if (len > 0) {
+    ofsX = (-dy * penWidth * scale + (dy > 0 ? -len : len)) / (2 * len);
+    ofsY = ( dx * penWidth * scale + (dx < 0 ? -len : len)) / (2 * len);
+  }
+  pts[0].X = X1 + ofsX;
+  pts[0].Y = Y1 + ofsY;
+  pts[1].X = X1 - ofsX;
+  pts[1].Y = Y1 - ofsY;
+  pts[2].X = X2 - ofsX;
+  pts[2].Y = Y2 - ofsY;
+  pts[3].X = X2 + ofsX;
+  pts[3].Y = Y2 + ofsY;
 
   Rect updateRect;
   Path path = { pts, 4, false };
@@ -1154,6 +1761,13 @@ void IRAM_ATTR DisplayController::absDrawBitmap(int destX, int destY, Bitmap con
   if (Y1 + YCount > height)
     YCount = height - Y1;
 
+  rawDrawBitmap(destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+}
+
+
+// draws the part X1, Y1, XCount, YCount of the bitmap at destX, destY. Parameters not checked.
+void IRAM_ATTR DisplayController::rawDrawBitmap(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
   switch (bitmap->format) {
 
     case PixelFormat::Undefined:
@@ -1181,4 +1795,125 @@ void IRAM_ATTR DisplayController::absDrawBitmap(int destX, int destY, Bitmap con
 
 
 
+
+// Draws the tile map inside its rectangle (clipped). When only the scroll position has changed since the last drawing,
+// the pixels already drawn are scrolled (by the display, if it can) and only the uncovered strips are drawn.
+// Not possible when double buffered, because the back buffer doesn't contain the last drawing.
+void IRAM_ATTR DisplayController::drawTileMap(TileMapDrawingInfo const & tileMapDrawingInfo, Rect & updateRect)
+{
+  TileMap * tileMap = tileMapDrawingInfo.tileMap;
+  Bitmap const * tileset = tileMap->tileset;
+  if (!tileset || tileMap->tileWidth <= 0 || tileMap->tileHeight <= 0 || tileMap->columns <= 0 || tileMap->rows <= 0 || tileset->width < tileMap->tileWidth)
+    return;
+
+  const Rect rect = tileMap->rect.translate(paintState().origin);
+  const Rect view = rect.intersection(paintState().absClippingRect);
+  if (view.X1 > view.X2 || view.Y1 > view.Y2)
+    return;
+
+  // map pixel shown at the top-left corner of the visible rectangle
+  const int mapWidth  = tileMap->columns * tileMap->tileWidth;
+  const int mapHeight = tileMap->rows * tileMap->tileHeight;
+  const int mapX = ((tileMapDrawingInfo.scrollX + view.X1 - rect.X1) % mapWidth + mapWidth) % mapWidth;
+  const int mapY = ((tileMapDrawingInfo.scrollY + view.Y1 - rect.Y1) % mapHeight + mapHeight) % mapHeight;
+
+  // shortest movement since the last drawing, the map wraps around
+  int dx = (mapX - tileMap->drawnX + mapWidth) % mapWidth;
+  int dy = (mapY - tileMap->drawnY + mapHeight) % mapHeight;
+  if (dx > mapWidth / 2)
+    dx -= mapWidth;
+  if (dy > mapHeight / 2)
+    dy -= mapHeight;
+
+  if (tileMap->drawn && tileMap->drawnRect == view && !isDoubleBuffered() && abs(dx) < view.width() && abs(dy) < view.height()) {
+    if (dx == 0 && dy == 0)
+      return;
+
+    // sprites over the tile map are restored before moving pixels
+    Rect moved = view;
+    hideSprites(moved);
+
+    Rect region = paintState().scrollingRegion;
+    paintState().scrollingRegion = view;
+    if (dx != 0 || dy == 0 || !m_dirtyRegion || !tryHardwareVScroll(-dy, *m_dirtyRegion)) {
+      updateRect = updateRect.merge(moved);
+      if (dy)
+        VScroll(-dy, updateRect);
+      if (dx)
+        HScroll(-dx, updateRect);
+    }
+    paintState().scrollingRegion = region;
+
+    // uncovered rows (whole width), then uncovered columns of the other rows
+    Rect rows = Rect(view.X1, view.Y1, view.X2, view.Y1 - 1);
+    Rect cols = Rect(view.X1, view.Y1, view.X1 - 1, view.Y2);
+    if (dy > 0) {
+      rows.Y1 = view.Y2 - dy + 1;
+      rows.Y2 = view.Y2;
+      cols.Y2 = rows.Y1 - 1;
+    } else if (dy < 0) {
+      rows.Y2 = view.Y1 - dy - 1;
+      cols.Y1 = rows.Y2 + 1;
+    }
+    if (dx > 0) {
+      cols.X1 = view.X2 - dx + 1;
+      cols.X2 = view.X2;
+    } else if (dx < 0)
+      cols.X2 = view.X1 - dx - 1;
+    drawTileMapArea(tileMap, rows, view, mapX, mapY, updateRect);
+    drawTileMapArea(tileMap, cols, view, mapX, mapY, updateRect);
+  } else
+    drawTileMapArea(tileMap, view, view, mapX, mapY, updateRect);
+
+  tileMap->drawnRect = view;
+  tileMap->drawnX    = mapX;
+  tileMap->drawnY    = mapY;
+  tileMap->drawn     = true;
+}
+
+
+// draws the tiles inside "area", "view" is the visible rectangle showing the map pixel mapX, mapY at its top-left corner
+void IRAM_ATTR DisplayController::drawTileMapArea(TileMap const * tileMap, Rect const & area, Rect const & view, int mapX, int mapY, Rect & updateRect)
+{
+  if (area.X1 > area.X2 || area.Y1 > area.Y2)
+    return;
+
+  updateRect = updateRect.merge(area);
+  hideSprites(updateRect);
+
+  Bitmap const * tileset = tileMap->tileset;
+  const int tileWidth  = tileMap->tileWidth;
+  const int tileHeight = tileMap->tileHeight;
+  const int columns    = tileMap->columns;
+  const int mapWidth   = columns * tileWidth;
+  const int mapHeight  = tileMap->rows * tileHeight;
+  const int tiles      = tileset->height / tileHeight;
+
+  int my = (mapY + area.Y1 - view.Y1) % mapHeight;
+  for (int y = area.Y1; y <= area.Y2; ) {
+    const int row = my / tileHeight;
+    const int ty  = my % tileHeight;
+    const int h   = tmin(tileHeight - ty, area.Y2 - y + 1);
+    int mx = (mapX + area.X1 - view.X1) % mapWidth;
+    for (int x = area.X1; x <= area.X2; ) {
+      const int col = mx / tileWidth;
+      const int tx  = mx % tileWidth;
+      const int w   = tmin(tileWidth - tx, area.X2 - x + 1);
+      for (int layer = 0; layer < FABGLIB_TILEMAP_LAYERS; ++layer) {
+        if (!tileMap->layers[layer])
+          continue;
+        const int tile = tileMap->layers[layer][row * columns + col];
+        if ((layer > 0 && tile == 0) || tile >= tiles)
+          continue;
+        rawDrawBitmap(x, y, tileset, nullptr, tx, tile * tileHeight + ty, w, h);
+      }
+      x += w;
+      mx = (mx + w) % mapWidth;
+    }
+    y += h;
+    my = (my + h) % mapHeight;
+  }
+}
+
+
 } // end of namespace
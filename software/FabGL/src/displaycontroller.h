@@ -37,6 +37,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "fabglconf.h"
@@ -186,6 +187,10 @@ enum PrimitiveCmd : uint8_t {
   // Set line ends
   // params: lineEnds
   SetLineEnds,
+
+  // Draw a tile map, just the uncovered tiles when only the scroll position has changed
+  // params: tileMapDrawingInfo
+  DrawTileMap,
 };
 
 
@@ -469,6 +474,51 @@ struct BitmapDrawingInfo {
 } __attribute__ ((packed));
 
 
+/**
+ * @brief Represents a tile map: a grid of tiles, taken from a tileset, shown inside a rectangle
+ *
+ * Tiles are stacked vertically inside the tileset: tile N occupies rows N * tileHeight ... (N + 1) * tileHeight - 1.
+ * The tileset can have any pixel format, PixelFormat::Native is the fastest one (TFT displays also keep other formats
+ * converted in the bitmap cache, see TFTController.setBitmapCacheSize()).<br>
+ * Each layer is an array of columns x rows tile indexes, row by row. The first layer is drawn as is, on next layers
+ * tile 0 is empty and transparent pixels show the layers below. Null layers are skipped. The map wraps around.<br>
+ * Draw it with Canvas.drawTileMap(). When only the scroll position has changed since the last drawing, the pixels
+ * already drawn are moved and only the uncovered tiles are drawn. Call invalidate() after changing tiles or after
+ * painting over the tile map rectangle.
+ */
+struct TileMap {
+  Bitmap const *  tileset;                         /**< Tiles, stacked vertically */
+  int16_t         tileWidth;                       /**< Tile horizontal size */
+  int16_t         tileHeight;                      /**< Tile vertical size */
+  int16_t         columns;                         /**< Map horizontal size, in tiles */
+  int16_t         rows;                            /**< Map vertical size, in tiles */
+  uint8_t const * layers[FABGLIB_TILEMAP_LAYERS];  /**< Tile indexes of each layer (columns x rows items) */
+  Rect            rect;                            /**< Where the map is shown, relative to the origin */
+
+  // internal: visible rectangle and map position of the last drawing
+  Rect            drawnRect;
+  int16_t         drawnX;
+  int16_t         drawnY;
+  bool            drawn;
+
+  TileMap() : tileset(nullptr), tileWidth(0), tileHeight(0), columns(0), rows(0), layers(), rect(), drawnRect(), drawnX(0), drawnY(0), drawn(false) { }
+
+  /**
+   * @brief Forces the next Canvas.drawTileMap() to draw all tiles
+   */
+  void invalidate() { drawn = false; }
+};
+
+
+struct TileMapDrawingInfo {
+  int16_t   scrollX;
+  int16_t   scrollY;
+  TileMap * tileMap;
+
+  TileMapDrawingInfo(int scrollX_, int scrollY_, TileMap * tileMap_) : scrollX(scrollX_), scrollY(scrollY_), tileMap(tileMap_) { }
+} __attribute__ ((packed));
+
+
 /** \ingroup Enumerations
  * @brief This enum defines a set of predefined mouse cursors.
  */
@@ -528,6 +578,12 @@ struct Sprite {
   int16_t            savedBackgroundHeight;
   uint8_t *          savedBackground;
   QuadTreeObject *   collisionDetectorObject;
+  // Opacity of the whole sprite, from 0 (invisible) to 255 (opaque, default). Combined with the alpha channel of
+  // RGBA2222 and RGBA8888 frames. Implemented only by drivers with RGB565 native format (TFT), ignored by others.
+  uint8_t            opacity;
+  // Layer of the sprite when sprites are composed by the driver (see TFTController.enableSpriteCompositing()): sprites with
+  // higher values are over lower ones, sprites with the same value follow array order. The mouse cursor is over all sprites.
+  int8_t             z;
   struct {
     uint8_t visible:  1;
     // A static sprite should be positioned before dynamic sprites.
@@ -536,13 +592,19 @@ struct Sprite {
     // This is always '1' for dynamic sprites and always '0' for static sprites.
     uint8_t allowDraw: 1;
   };
+  // dirty and redraw are not bit fields: they are written by the drawing task while the application changes the others.
+  // Set by moveTo(), moveBy(), setFrame(), nextFrame() and when bitmaps change: the sprite is redrawn at next refresh.
+  // Position, size and visibility changes are detected anyway, set it after changing frame, pixels, opacity or z directly.
+  volatile bool      dirty;
+  // internal: background restored (or never drawn), the sprite will be drawn at next showSprites()
+  bool               redraw;
 
   Sprite();
   ~Sprite();
   Bitmap * getFrame() { return frames ? frames[currentFrame] : nullptr; }
   int getFrameIndex() { return currentFrame; }
-  void nextFrame() { ++currentFrame; if (currentFrame >= framesCount) currentFrame = 0; }
-  Sprite * setFrame(int frame) { currentFrame = frame; return this; }
+  void nextFrame() { ++currentFrame; if (currentFrame >= framesCount) currentFrame = 0; dirty = true; }
+  Sprite * setFrame(int frame) { currentFrame = frame; dirty = true; return this; }
   Sprite * addBitmap(Bitmap * bitmap);
   Sprite * addBitmap(Bitmap * bitmap[], int count);
   void clearBitmaps();
@@ -591,6 +653,7 @@ struct Primitive {
     PaintOptions           paintOptions;
     GlyphsBufferRenderInfo glyphsBufferRenderInfo;
     BitmapDrawingInfo      bitmapDrawingInfo;
+    TileMapDrawingInfo     tileMapDrawingInfo;
     Path                   path;
     PixelDesc              pixelDesc;
     LineEnds               lineEnds;
@@ -603,6 +666,13 @@ struct Primitive {
 } __attribute__ ((packed));
 
 
+// primitives sent as a single queue message
+struct PrimitiveBatch {
+  Primitive prims[FABGLIB_PRIMITIVES_BATCH_SIZE];
+  uint8_t   count;
+};
+
+
 struct PaintState {
   RGB888       penColor;
   RGB888       brushColor;
@@ -618,6 +688,51 @@ struct PaintState {
 };
 
 
+/**
+ * @brief Set of rectangles updated by a batch of primitives.
+ *
+ * Holds up to FABGLIB_DIRTY_REGION_RECTS rectangles. A new rectangle is merged with an existing one when the bounding
+ * box adds no more than FABGLIB_DIRTY_REGION_MERGE_WASTE unchanged pixels, otherwise it is kept apart. When the set is
+ * full the pair that wastes fewer pixels is merged.
+ */
+class DirtyRegion {
+
+public:
+
+  DirtyRegion() : m_count(0) { }
+
+  void clear()                              { m_count = 0; }
+
+  bool isEmpty() const                      { return m_count == 0; }
+
+  int count() const                         { return m_count; }
+
+  Rect const & operator[](int index) const  { return m_rects[index]; }
+
+  /**
+   * @brief Adds an updated rectangle. Empty rectangles (X1 > X2 or Y1 > Y2) are ignored.
+   *
+   * @param rect Rectangle to add.
+   */
+  void add(Rect const & rect);
+
+  /**
+   * @brief Bounding box of all rectangles.
+   */
+  Rect bounds() const;
+
+private:
+
+  static int64_t mergeWaste(Rect const & a, Rect const & b);
+
+  void remove(int index)                    { m_rects[index] = m_rects[--m_count]; }
+
+  // one more than the limit, to hold the rectangle being added
+  Rect    m_rects[FABGLIB_DIRTY_REGION_RECTS + 1];
+  int16_t m_count;
+};
+
+
 
 
 /**
@@ -666,7 +781,7 @@ public:
    */
   virtual NativePixelFormat nativePixelFormat() = 0;
 
-  PaintState & paintState() { return m_paintState; }
+  PaintState & paintState() { return m_bandsActive ? m_bandPaintState[xPortGetCoreID()] : m_paintState; }
 
   void addPrimitive(Primitive & primitive);
 
@@ -762,6 +877,7 @@ public:
    * Screen is automatically updated whenever a primitive is painted (look at Canvas).<br>
    * When a sprite updates its image or its position (or any other property) it is required
    * to force a refresh using this method.<br>
+   * Only sprites that have changed, and the sprites overlapping them or the painted primitives, are restored and redrawn.<br>
    * DisplayController.refreshSprites() is required also when using the double buffered mode, to paint sprites.
    */
   void refreshSprites();
@@ -839,10 +955,41 @@ protected:
 
   virtual void rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount) = 0;
 
+  // Scrolls rows of the scrolling region moving the display scroll start address, adding the uncovered rows to the
+  // dirty region. Returns false when the display cannot do it.
+  virtual bool tryHardwareVScroll(int scroll, DirtyRegion & dirtyRegion) { return false; }
+
   //// implemented methods
 
   void execPrimitive(Primitive const & prim, Rect & updateRect, bool insideISR);
 
+  void execPrimitive(Primitive const & prim, DirtyRegion & dirtyRegion, bool insideISR);
+
+  static bool isBandPrimitive(PrimitiveCmd cmd);
+
+  void beginBands(Rect const * bands);
+
+  void endBands();
+
+  bool bandsActive() { return m_bandsActive; }
+
+  // opacity of the bitmap being drawn: the sprite opacity while drawing sprites, otherwise 255
+  uint8_t bitmapOpacity() { return m_bitmapOpacity; }
+
+  // When enabled sprites are not drawn into the viewport: the driver composes them while sending the screen.
+  // hideSprites() does nothing and showSprites() adds the rectangles of changed sprites to the update rectangle.
+  // Sprites saved fields (savedX, savedY, savedBackgroundWidth...) describe where each sprite has been composed.
+  void setSpritesComposed(bool value) { m_spritesComposed = value; }
+
+  bool spritesComposed() { return m_spritesComposed && !isDoubleBuffered(); }
+
+  // (re)allocates the buffer where the sprite saves the background of its largest frame
+  void allocSpriteBackground(Sprite * sprite);
+
+  void execPrimitiveInBand(Primitive const & prim, DirtyRegion & dirtyRegion);
+
+  void releasePrimitiveBuffers(Primitive const & prim);
+
   void updateAbsoluteClippingRect();
 
   RGB888 getActualPenColor();
@@ -873,12 +1020,18 @@ protected:
 
   void hideSprites(Rect & updateRect);
 
+  void hideAllSprites(Rect & updateRect);
+
   void showSprites(Rect & updateRect);
 
+  void showSprites(DirtyRegion & dirtyRegion);
+
   void drawBitmap(BitmapDrawingInfo const & bitmapDrawingInfo, Rect & updateRect);
 
   void absDrawBitmap(int destX, int destY, Bitmap const * bitmap, void * saveBackground, bool ignoreClippingRect);
 
+  void drawTileMap(TileMapDrawingInfo const & tileMapDrawingInfo, Rect & updateRect);
+
   void setDoubleBuffered(bool value);
 
   bool getPrimitive(Primitive * primitive, int timeOutMS = 0);
@@ -887,6 +1040,10 @@ protected:
 
   void waitForPrimitives();
 
+  bool receiveBatch(TickType_t ticksToWait);
+
+  bool receiveBatchISR();
+
   Sprite * mouseCursor() { return &m_mouseCursor; }
 
   void resetPaintState();
@@ -895,11 +1052,46 @@ private:
 
   void primitiveReplaceDynamicBuffers(Primitive & primitive);
 
+  bool coalescePrimitive(Primitive const & primitive);
+
+  void flushPendingBatch();
+
+  void waitExecProgress();
+
+  void addSpriteRect(Rect const & rect, Rect & updateRect);
+
+  Sprite * spriteAt(int index) { return index < m_spritesCount ? getSprite(index) : mouseCursor(); }
+
+  void restoreSpriteBackground(Sprite * sprite, Rect & updateRect);
+
+  void drawSprite(Sprite * sprite, Rect & updateRect);
+
+  void restoreChangedSprites(Rect const & rect, bool recheck, Rect & updateRect);
+
+  void showComposedSprites(Rect & updateRect);
+
+  void rawDrawBitmap(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  void drawTileMapArea(TileMap const * tileMap, Rect const & area, Rect const & view, int mapX, int mapY, Rect & updateRect);
+
 
   PaintState             m_paintState;
 
   volatile bool          m_doubleBuffered;
-  volatile QueueHandle_t m_execQueue;
+  // batches of primitives to execute. The executor task is waken up by a task notification.
+  SPSCRing<PrimitiveBatch> m_execRing;
+
+  // primitives added but not sent to m_execRing yet, and primitives received but not executed yet
+  PrimitiveBatch         m_pendingBatch;
+  PrimitiveBatch         m_execBatch;
+  volatile int           m_execBatchPos;
+  portMUX_TYPE           m_pendingBatchMux;
+  volatile bool          m_consumerWaiting; // true when the executor is waiting for primitives, so m_pendingBatch must be sent
+  TaskHandle_t           m_consumerTask;    // task to notify when m_consumerWaiting is true
+
+  // given by the executor when it takes a batch or becomes idle, while m_producerWaiting is true
+  SemaphoreHandle_t      m_execProgress;
+  volatile bool          m_producerWaiting;
 
   bool                   m_backgroundPrimitiveExecutionEnabled; // when False primitives are execute immediately
   volatile bool          m_backgroundPrimitiveTimeoutEnabled;   // when False VSyncInterrupt() has not timeout
@@ -907,7 +1099,23 @@ private:
   void *                 m_sprites;       // pointer to array of sprite structures
   int                    m_spriteSize;    // size of sprite structure
   int                    m_spritesCount;  // number of sprites in m_sprites array
-  bool                   m_spritesHidden; // true between hideSprites() and showSprites()
+  bool                   m_spritesHidden; // true between hideAllSprites() (or hideSprites() when double buffered) and showSprites()
+
+  // when not null sprite rectangles are added here instead of being merged into updateRect
+  DirtyRegion *          m_dirtyRegion;
+
+  uint8_t                m_bitmapOpacity;
+
+  bool                   m_spritesComposed;
+
+  // between beginBands() and endBands() each core uses its own paint state, clipped to its band
+  volatile bool          m_bandsActive;
+  PaintState             m_bandPaintState[portNUM_PROCESSORS];
+  Rect                   m_bandRect[portNUM_PROCESSORS];
+
+  // fillPath() edge tables, one for each core because bands may fill paths at the same time
+  PolygonEdge            m_polygonEdges[portNUM_PROCESSORS][FABGLIB_POLYGON_EDGES];
+  PolygonEdge *          m_polygonActive[portNUM_PROCESSORS][FABGLIB_POLYGON_EDGES];
 
   // mouse cursor (mouse pointer) support
   Sprite                 m_mouseCursor;
@@ -47,10 +47,30 @@
 #define FABGLIB_EXEC_QUEUE_SIZE 1024
 
 
+/** Number of primitives sent to the display controller queue as a single message. */
+#define FABGLIB_PRIMITIVES_BATCH_SIZE 8
+
+
 /** Size (in bytes) of primitives dynamic buffers. Used by primitives like drawPath and fillPath to contain path points. */
 #define FABGLIB_PRIMITIVES_DYNBUFFERS_SIZE 512
 
 
+/** Number of points of the paths filled without allocating memory. Larger paths use the heap, so they cannot be filled inside the VGA interrupt. */
+#define FABGLIB_POLYGON_EDGES 32
+
+
+/** Maximum number of separated rectangles SPI and I2C displays send for each update. */
+#define FABGLIB_DIRTY_REGION_RECTS 8
+
+
+/** Maximum number of layers of a tile map (see fabgl::TileMap). */
+#define FABGLIB_TILEMAP_LAYERS 2
+
+
+/** Two updated rectangles are sent as one when their bounding box adds at most this number of unchanged pixels. */
+#define FABGLIB_DIRTY_REGION_MERGE_WASTE 512
+
+
 /** Number of characters the terminal can "write" without pause (increase if you have loss of characters in serial port). */
 #define FABGLIB_TERMINAL_INPUT_QUEUE_SIZE 1024
 
@@ -32,6 +32,9 @@
  */
 
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "freertos/FreeRTOS.h"
 
 
@@ -306,6 +309,302 @@ private:
 
 
 
+///////////////////////////////////////////////////////////////////////////////////
+// SPSCRing
+// Lock-free ring buffer for one producer and one consumer, which may run on different cores or inside an ISR.
+// Items are copied, so T must be trivially copyable. Capacity is rounded up to a power of two.
+// Producer and consumer indexes are free running and placed on separate 32 bytes lines.
+
+template <typename T>
+class SPSCRing {
+public:
+  SPSCRing() : m_items(nullptr), m_mask(0), m_head(0), m_tail(0) { }
+  ~SPSCRing() { heap_caps_free(m_items); }
+
+  SPSCRing(SPSCRing const&) = delete;
+  void operator=(SPSCRing const&) = delete;
+
+  // not thread safe, producer and consumer must be idle
+  bool init(int capacity) {
+    heap_caps_free(m_items);
+    uint32_t size = 1;
+    while (size < (uint32_t)capacity)
+      size <<= 1;
+    m_items = (T*) heap_caps_malloc(size * sizeof(T), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    m_mask  = size - 1;
+    m_head  = m_tail = 0;
+    return m_items != nullptr;
+  }
+
+  // producer side, returns false when full
+  bool push(T const & item) {
+    const uint32_t head = m_head;
+    if (head - __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) > m_mask)
+      return false;
+    m_items[head & m_mask] = item;
+    __atomic_store_n(&m_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // consumer side, returns false when empty
+  bool pop(T * item) {
+    const uint32_t tail = m_tail;
+    if (__atomic_load_n(&m_head, __ATOMIC_ACQUIRE) == tail)
+      return false;
+    *item = m_items[tail & m_mask];
+    __atomic_store_n(&m_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  int count()    { return __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE); }
+  bool isEmpty() { return count() == 0; }
+
+private:
+  T *                         m_items;
+  uint32_t                    m_mask;
+  alignas(32) uint32_t        m_head;   // written by producer only
+  alignas(32) uint32_t        m_tail;   // written by consumer only
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////////
+// PolygonRasterizer
+// Scanline polygon filler (even-odd rule) using an active edge table. Edges are sorted by first scanline, then their
+// X crossings are stepped incrementally as integer plus remainder, so no division is done per scanline.
+// Scanline Y crosses an edge when Y1 < Y <= Y2, and the span between crossings XA and XB covers pixels ceil(XA)..ceil(XB)-1.
+// Optionally reports the coverage (0..255) of partially covered pixels at span ends, to anti-alias edges.
+
+struct PolygonEdge {
+  int16_t yTop;      // first scanline
+  int16_t yBottom;   // last scanline
+  int32_t x;         // ceil of X crossing at current scanline
+  int32_t r;         // x * dy - exact crossing * dy (0 <= r < dy)
+  int32_t q;         // x step per scanline, integer part
+  int32_t m;         // x step per scanline, remainder (0 <= m < dy)
+  int32_t dy;
+  int32_t covScale;  // (255 << 16) / dy, converts r to coverage
+};
+
+
+class PolygonRasterizer {
+
+public:
+
+  // "edges" and "active" must contain at least "count" items
+  PolygonRasterizer(PolygonEdge * edges, PolygonEdge * * active) : m_edges(edges), m_active(active), m_edgesCount(0) { }
+
+  // "clip" is an absolute rectangle, points are translated by offsetX and offsetY
+  void setup(Point const * points, int count, int offsetX, int offsetY, Rect const & clip) {
+    m_clip = clip;
+    m_edgesCount = 0;
+    for (int i = 0, j = count - 1; i < count; j = i++) {
+      int x0 = points[j].X + offsetX, y0 = points[j].Y + offsetY;
+      int x1 = points[i].X + offsetX, y1 = points[i].Y + offsetY;
+      if (y0 == y1)
+        continue;
+      if (y0 > y1) {
+        tswap(x0, x1);
+        tswap(y0, y1);
+      }
+      const int yTop    = tmax<int>(y0 + 1, clip.Y1);
+      const int yBottom = tmin<int>(y1, clip.Y2);
+      if (yTop > yBottom)
+        continue;
+      PolygonEdge & e = m_edges[m_edgesCount++];
+      e.yTop     = yTop;
+      e.yBottom  = yBottom;
+      e.dy       = y1 - y0;
+      e.q        = floorDiv(x1 - x0, e.dy);
+      e.m        = (x1 - x0) - e.q * e.dy;
+      e.covScale = (255 << 16) / e.dy;
+      // crossing at yTop: x0 + (yTop - y0) * (x1 - x0) / dy
+      const int64_t v = (int64_t)x0 * e.dy + (int64_t)(yTop - y0) * (x1 - x0);
+      e.x = ceilDiv(v, e.dy);
+      e.r = (int64_t)e.x * e.dy - v;
+    }
+    // insertion sort by first scanline
+    for (int i = 1; i < m_edgesCount; ++i) {
+      PolygonEdge e = m_edges[i];
+      int j = i - 1;
+      for (; j >= 0 && m_edges[j].yTop > e.yTop; --j)
+        m_edges[j + 1] = m_edges[j];
+      m_edges[j + 1] = e;
+    }
+  }
+
+  // fillSpan(y, x1, x2) is called for each clipped span
+  template <typename TFillSpan>
+  void rasterize(TFillSpan fillSpan) {
+    rasterize(fillSpan, [] (int, int, int) { }, false);
+  }
+
+  // like rasterize(fillSpan), plus edgePixel(y, x, coverage) for the partially covered pixels at both span ends
+  template <typename TFillSpan, typename TEdgePixel>
+  void rasterize(TFillSpan fillSpan, TEdgePixel edgePixel, bool antialias = true) {
+    if (m_edgesCount == 0)
+      return;
+    const int clipX1 = m_clip.X1;
+    const int clipX2 = m_clip.X2;
+    int next = 0;         // next edge to activate
+    int activeCount = 0;
+    for (int y = m_edges[0].yTop; next < m_edgesCount || activeCount > 0; ++y) {
+
+      // remove finished edges
+      int n = 0;
+      for (int i = 0; i < activeCount; ++i)
+        if (m_active[i]->yBottom >= y)
+          m_active[n++] = m_active[i];
+      activeCount = n;
+
+      // add new edges
+      if (activeCount == 0 && next < m_edgesCount && m_edges[next].yTop > y)
+        y = m_edges[next].yTop;
+      for (; next < m_edgesCount && m_edges[next].yTop == y; ++next)
+        m_active[activeCount++] = &m_edges[next];
+
+      // keep active edges sorted by X (almost sorted from previous scanline)
+      for (int i = 1; i < activeCount; ++i) {
+        PolygonEdge * e = m_active[i];
+        int j = i - 1;
+        for (; j >= 0 && m_active[j]->x > e->x; --j)
+          m_active[j + 1] = m_active[j];
+        m_active[j + 1] = e;
+      }
+
+      for (int i = 0; i + 1 < activeCount; i += 2) {
+        PolygonEdge const * a = m_active[i];
+        PolygonEdge const * b = m_active[i + 1];
+        // pixel X covers [X, X + 1): the pixel before the span is partially covered by the left edge, the last
+        // pixel of the span is partially covered by the right edge
+        const bool rightPartial = antialias && b->r;
+        const int x1 = tmax<int>(a->x, clipX1);
+        const int x2 = tmin<int>(b->x - 1 - rightPartial, clipX2);
+        if (x1 <= x2)
+          fillSpan(y, x1, x2);
+        if (antialias) {
+          if (a->x == b->x) {
+            // both crossings inside the same pixel: it is covered by their distance
+            const int coverage = abs(a->r * a->covScale - b->r * b->covScale) >> 16;
+            if (coverage && a->x - 1 >= clipX1 && a->x - 1 <= clipX2)
+              edgePixel(y, a->x - 1, coverage);
+          } else {
+            if (a->r && a->x - 1 >= clipX1 && a->x - 1 <= clipX2)
+              edgePixel(y, a->x - 1, (a->r * a->covScale) >> 16);
+            if (rightPartial && b->x - 1 >= clipX1 && b->x - 1 <= clipX2)
+              edgePixel(y, b->x - 1, 255 - ((b->r * b->covScale) >> 16));
+          }
+        }
+      }
+
+      // step to next scanline
+      for (int i = 0; i < activeCount; ++i) {
+        PolygonEdge * e = m_active[i];
+        e->x += e->q;
+        e->r -= e->m;
+        if (e->r < 0) {
+          e->r += e->dy;
+          ++e->x;
+        }
+      }
+    }
+  }
+
+private:
+
+  static int32_t floorDiv(int32_t a, int32_t b) { int32_t q = a / b; return q - ((a % b) < 0); }               // b > 0
+  static int32_t ceilDiv(int64_t a, int32_t b)  { int64_t q = a / b; return q + ((a % b) > 0); }               // b > 0
+
+  PolygonEdge *   m_edges;
+  PolygonEdge * * m_active;
+  int             m_edgesCount;
+  Rect            m_clip;
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////////
+// RGB565BE alpha blending (native pixel format of TFT displays)
+// Alpha blending works on standard RGB565 (RGB565BE pixels are byte swapped) with 5 bit alpha (0..32), spreading the
+// channels over 32 bits so a single multiplication handles all of them:
+//   RGB565          RRRRRGGG GGGBBBBB
+//   c | c << 16     ----- GGGGGG ----- | RRRRR ------ BBBBB  (mask 0x07E0F81F)
+// Each channel has 5 free bits above it, so "dst * (32 - alpha) + src * alpha" does not overflow into the next one.
+
+// 0..255 -> 0..32
+inline int alphaTo5(int alpha)
+{
+  return (alpha + 4) >> 3;
+}
+
+
+// alpha * opacity / 255, both 0..255
+inline int combineAlpha(int alpha, int opacity)
+{
+  return (alpha * opacity * 257 + 32768) >> 16;
+}
+
+
+inline uint16_t blendRGB565BE(uint16_t dst, uint16_t src, int alpha5)
+{
+  uint32_t d = __builtin_bswap16(dst);
+  uint32_t s = __builtin_bswap16(src);
+  d = (d | (d << 16)) & 0x07E0F81F;
+  s = (s | (s << 16)) & 0x07E0F81F;
+  uint32_t r = ((d * (32 - alpha5) + s * alpha5 + 0x02008010) >> 5) & 0x07E0F81F;   // +0x02008010 rounds each channel
+  return __builtin_bswap16(r | (r >> 16));
+}
+
+
+// Blends two adjacent pixels (as loaded by a 32 bit read) with the same alpha. The same masks split the pair:
+//   0x07E0F81F  takes R and B of the first pixel and G of the second one
+//   0xF81F07E0  takes G of the first pixel and R and B of the second one (shifted right by 5 before multiplying)
+inline uint32_t blendRGB565BE2(uint32_t dst, uint32_t src, int alpha5)
+{
+  const int ialpha5 = 32 - alpha5;
+  dst = ((dst & 0x00FF00FF) << 8) | ((dst >> 8) & 0x00FF00FF);
+  src = ((src & 0x00FF00FF) << 8) | ((src >> 8) & 0x00FF00FF);
+  uint32_t r1 = (((dst & 0x07E0F81F) * ialpha5 + (src & 0x07E0F81F) * alpha5 + 0x02008010) >> 5) & 0x07E0F81F;
+  uint32_t r2 = (((dst >> 5) & 0x07C0F83F) * ialpha5 + ((src >> 5) & 0x07C0F83F) * alpha5 + 0x04008010) & 0xF81F07E0;
+  r1 |= r2;
+  return ((r1 & 0x00FF00FF) << 8) | ((r1 >> 8) & 0x00FF00FF);
+}
+
+
+// Blends count pixels of src over dst, with the same alpha (0..255)
+inline void blendRGB565BERun(uint16_t * dst, uint16_t const * src, int count, int alpha)
+{
+  if (alpha == 255) {
+    memcpy(dst, src, count * sizeof(uint16_t));
+    return;
+  }
+  const int alpha5 = alphaTo5(alpha);
+  if (alpha5 == 0 || count <= 0)
+    return;
+  if ((uintptr_t)dst & 2) {
+    *dst = blendRGB565BE(*dst, *src++, alpha5);
+    ++dst;
+    --count;
+  }
+  // dst is now 32 bit aligned, src may be not
+  for (; count >= 2; count -= 2, dst += 2, src += 2)
+    *(uint32_t*)dst = blendRGB565BE2(*(uint32_t*)dst, src[0] | (src[1] << 16), alpha5);
+  if (count)
+    *dst = blendRGB565BE(*dst, *src, alpha5);
+}
+
+
+// Blends a pixel using alpha 0..255, with fast paths for transparent and opaque pixels
+inline void blendRGB565BEPixel(uint16_t * dst, uint16_t src, int alpha)
+{
+  if (alpha == 255)
+    *dst = src;
+  else if (alpha)
+    *dst = blendRGB565BE(*dst, src, alphaTo5(alpha));
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////
 // Delegate
 